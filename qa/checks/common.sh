@@ -0,0 +1,75 @@
+#!/usr/bin/env bash
+# Copyright (c) 2019 The GravityCoin Core Developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#
+# Helpers shared by the checks in this directory. Each check runs
+# GravityCoind with the arguments it was given, e.g.
+# -datadir=/path/to/copy -testnet, plus its own.
+
+set -e
+
+SRCDIR=$(cd "$(dirname "${BASH_SOURCE[0]}")/../../src" && pwd)
+GRAVITYCOIND=${GRAVITYCOIND:-$SRCDIR/GravityCoind}
+GRAVITYCOINCLI=${GRAVITYCOINCLI:-$SRCDIR/GravityCoin-cli}
+# Seconds to wait for the node to answer RPC, or to catch up after a reindex
+TIMEOUT=${TIMEOUT:-86400}
+
+NODE_ARGS=("$@")
+NODE_PID=
+
+cli() {
+    "$GRAVITYCOINCLI" "${NODE_ARGS[@]}" "$@"
+}
+
+fail() {
+    echo "FAILED: $*" >&2
+    stop_node
+    exit 1
+}
+
+# Starts the node with NODE_ARGS and the given extra arguments, and waits
+# until it answers RPC
+start_node() {
+    "$GRAVITYCOIND" "${NODE_ARGS[@]}" -server "$@" >/dev/null 2>&1 &
+    NODE_PID=$!
+    local nWaited=0
+    until cli getblockcount >/dev/null 2>&1; do
+        if ! kill -0 "$NODE_PID" 2>/dev/null; then
+            NODE_PID=
+            fail "GravityCoind $* exited during startup, see debug.log"
+        fi
+        [ $((nWaited++)) -lt "$TIMEOUT" ] || fail "GravityCoind $* didn't answer RPC in time"
+        sleep 1
+    done
+}
+
+stop_node() {
+    [ -n "$NODE_PID" ] || return 0
+    cli stop >/dev/null 2>&1 || true
+    wait "$NODE_PID" || true
+    NODE_PID=
+}
+
+# Waits until the active chain reaches the given height
+wait_for_height() {
+    local nWaited=0
+    until [ "$(cli getblockcount)" -ge "$1" ]; do
+        kill -0 "$NODE_PID" 2>/dev/null || fail "GravityCoind exited before reaching height $1"
+        [ $((nWaited++)) -lt "$TIMEOUT" ] || fail "height $1 not reached in time"
+        sleep 1
+    done
+}
+
+# Prints the value of a string, number or boolean field of the JSON on stdin
+json_field() {
+    { tr -d '\n'; echo; } | sed -n "s/.*\"$1\": *\"\{0,1\}\([^\",}]*\).*/\1/p"
+}
+
+# Prints the hash of the UTXO set, with or without -utxostatsindex
+utxo_hash() {
+    local info
+    info=$(cli gettxoutsetinfo)
+    echo "$info" | json_field hash_serialized
+    echo "$info" | json_field multiset_hash
+}
@@ -0,0 +1,50 @@
+#!/usr/bin/env bash
+# Copyright (c) 2019 The GravityCoin Core Developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#
+# Checks that importing the block files through the pipelined loader gives
+# the same chain and UTXO set as importing them one block at a time, and as
+# the node had before. The data directory is reindexed twice:
+#
+# - with -loadblockthreads=1, a single worker, which is the sequential path,
+# - with the default number of workers.
+#
+# With -exodus in the arguments, the Exodus state hashes are compared too.
+#
+# Usage: import.sh [GravityCoind arguments, e.g. -datadir=<synced copy>]
+
+. "$(dirname "$0")/common.sh"
+
+NODE_ARGS+=(-connect=0 -listen=0)
+
+fExodus=
+for arg in "${NODE_ARGS[@]}"; do
+    case "$arg" in -exodus|-exodus=1) fExodus=1 ;; esac
+done
+
+# Prints the best block, the UTXO set hash and the Exodus state hash
+chain_state() {
+    cli getbestblockhash
+    utxo_hash
+    [ -z "$fExodus" ] || cli exodus_getcurrentstatehash | json_field statehash
+}
+
+start_node
+nTip=$(cli getblockcount)
+stateBefore=$(chain_state)
+stop_node
+
+for threads in 1 0; do
+    # Exodus parses the reindexed blocks again from scratch too
+    start_node -reindex -loadblockthreads=$threads ${fExodus:+-startclean}
+    wait_for_height "$nTip"
+    stateReindexed=$(chain_state)
+    stop_node
+    [ "$stateReindexed" = "$stateBefore" ] || fail "after -reindex -loadblockthreads=$threads:
+$stateReindexed
+before:
+$stateBefore"
+done
+
+echo "OK: both imports give the same state at height $nTip"
@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+# Copyright (c) 2019 The GravityCoin Core Developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#
+# Checks that the arith_uint256 difficulty retarget is bit-exact with the
+# legacy bignum one:
+#
+# - at startup, -checkretarget compares them on fixed pseudo-random chains,
+# - then verifyretarget recomputes the difficulty of every block of the
+#   active chain with both, and against the difficulty the block has.
+#
+# Usage: retarget.sh [GravityCoind arguments, e.g. -datadir=<synced copy>]
+
+. "$(dirname "$0")/common.sh"
+
+# Blocks per verifyretarget call, so no call runs for long
+SLICE=${SLICE:-10000}
+
+start_node -checkretarget=1 -connect=0 -listen=0
+
+nTip=$(cli getblockcount)
+for ((nStart = 1; nStart <= nTip; nStart += SLICE)); do
+    nEnd=$((nStart + SLICE - 1))
+    result=$(cli verifyretarget "$nStart" "$nEnd" | tr -d ' \n')
+    case "$result" in
+        *'"mismatches":[]'*) ;;
+        *) fail "verifyretarget $nStart $nEnd: $result" ;;
+    esac
+done
+
+stop_node
+echo "OK: retarget matches the legacy code and the chain at heights 1 to $nTip"
@@ -0,0 +1,49 @@
+#!/usr/bin/env bash
+# Copyright (c) 2019 The GravityCoin Core Developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#
+# Checks the incrementally maintained Exodus state hash:
+#
+# - Exodus parses the chain again from scratch. After every block, the
+#   balances part of the hash is rebuilt from scratch and compared with the
+#   maintained one (-exodusdebug=consensus_hash with state_hash_every_block).
+#   A mismatch shuts the node down.
+# - The hash at the tip is verified the same way through RPC.
+# - The node restarts from the persisted state, and has to come up with the
+#   same hash.
+#
+# Usage: statehash.sh [GravityCoind arguments, e.g. -datadir=<synced copy>]
+
+. "$(dirname "$0")/common.sh"
+
+NODE_ARGS+=(-exodus -connect=0 -listen=0)
+
+datadir=$HOME/.GravityCoin
+for arg in "${NODE_ARGS[@]}"; do
+    case "$arg" in -datadir=*) datadir=${arg#-datadir=} ;; esac
+done
+# VerifyBalancesStateHash logs mismatches to the exodus.log of the network's directory
+count_mismatches() {
+    find "$datadir" -maxdepth 2 -name exodus.log -exec cat {} + 2>/dev/null | grep -c "state hash mismatch" || true
+}
+nMismatches=$(count_mismatches)
+
+start_node -startclean -exodusdebug=consensus_hash -exodusdebug=state_hash_every_block
+
+nTip=$(cli getblockcount)
+result=$(cli exodus_getcurrentstatehash true)
+[ "$(echo "$result" | json_field verified)" = "true" ] || fail "state hash at the tip: $result"
+hashParsed=$(echo "$result" | json_field statehash)
+stop_node
+
+[ "$(count_mismatches)" = "$nMismatches" ] || fail "the maintained state hash went wrong during the parse, see exodus.log"
+
+start_node
+result=$(cli exodus_getcurrentstatehash true)
+[ "$(echo "$result" | json_field verified)" = "true" ] || fail "state hash after restart: $result"
+hashLoaded=$(echo "$result" | json_field statehash)
+stop_node
+
+[ "$hashParsed" = "$hashLoaded" ] || fail "state hash $hashParsed after the parse, $hashLoaded after loading the persisted state"
+echo "OK: state hash $hashParsed at height $nTip"
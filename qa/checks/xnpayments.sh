@@ -0,0 +1,35 @@
+#!/usr/bin/env bash
+# Copyright (c) 2019 The GravityCoin Core Developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#
+# Checks the expiry of xnode payment votes in their ring buffer on a node
+# that follows the network. With -checkxnpayments, every CheckAndRemove
+# asserts that:
+#
+# - each stored height sits in its own slot, and none is below the expired range,
+# - each vote is listed by the slot of its height exactly once,
+# - the count of heights with payees is right.
+#
+# A failure aborts the node. The node runs until it has synced the xnode
+# lists and seen BLOCKS more blocks after that, each of which expires votes.
+#
+# Usage: xnpayments.sh [GravityCoind arguments, e.g. -datadir=<copy> -testnet]
+
+. "$(dirname "$0")/common.sh"
+
+BLOCKS=${BLOCKS:-10}
+
+start_node -checkxnpayments=1 -debug=mnpayments
+
+nWaited=0
+until cli xnsync status | tr -d ' \n' | grep -q '"IsSynced":true'; do
+    kill -0 "$NODE_PID" 2>/dev/null || fail "GravityCoind exited before the xnode lists synced, see debug.log"
+    [ $((nWaited++)) -lt "$TIMEOUT" ] || fail "the xnode lists didn't sync in time"
+    sleep 1
+done
+
+nStart=$(cli getblockcount)
+wait_for_height $((nStart + BLOCKS))
+stop_node
+echo "OK: xnode payment votes consistent over heights $nStart to $((nStart + BLOCKS))"
@@ -170,6 +170,8 @@ public:
     base_uint& operator*=(uint32_t b32);
     base_uint& operator*=(const base_uint& b);
     base_uint& operator/=(const base_uint& b);
+    /** Divide by a 32 bit number in place, a word at a time. Returns the remainder. */
+    uint32_t DivMod(uint32_t b32);
 
     base_uint& operator++()
     {
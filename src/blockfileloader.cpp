@@ -0,0 +1,242 @@
+// Copyright (c) 2019 The GravityCoin Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfileloader.h"
+
+#include "chainparams.h"
+#include "checkpoints.h"
+#include "clientversion.h"
+#include "consensus/consensus.h"
+#include "streams.h"
+#include "util.h"
+
+#include <boost/bind.hpp>
+
+/** Number of block heights the reader remembers to tell the height of the blocks following them */
+static const size_t MAX_LOADER_HEIGHTS = 10000;
+
+CBlockFileLoader::CBlockFileLoader(FILE* fileIn, const CChainParams& chainparamsIn, const HeightLookup& lookupIn, const CheckpointLookup& checkpointedIn, const BlockCheck& checkIn, int nThreads, int nWindowIn)
+  : chainparams(chainparamsIn), lookup(lookupIn), checkpointed(checkpointedIn), check(checkIn),
+    nCheckpointHeight(Checkpoints::GetTotalBlocksEstimate(chainparamsIn.Checkpoints())), nWindow(std::max(nWindowIn, 1)), file(fileIn),
+    nNextRead(0), nNextConsume(0), fEnd(false), fRewind(false), nRewindPos(0), nGeneration(0), fQuit(false)
+{
+    threads.create_thread(boost::bind(&CBlockFileLoader::ReaderLoop, this));
+    for (int i = 0; i < std::max(nThreads, 1); ++i) {
+        threads.create_thread(boost::bind(&CBlockFileLoader::WorkerLoop, this));
+    }
+}
+
+CBlockFileLoader::~CBlockFileLoader()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fQuit = true;
+    }
+    condReader.notify_all();
+    condWorker.notify_all();
+    threads.join_all();
+}
+
+bool CBlockFileLoader::ReadNext(CBufferedFile& blkdat, uint64_t& nRewind, Item& item)
+{
+    while (!blkdat.eof()) {
+        blkdat.SetPos(nRewind);
+        nRewind++; // start one byte further next time, in case of failure
+        blkdat.SetLimit(); // remove former limit
+        unsigned int nSize = 0;
+        try {
+            // locate a header
+            unsigned char buf[MESSAGE_START_SIZE];
+            blkdat.FindByte(chainparams.MessageStart()[0]);
+            nRewind = blkdat.GetPos() + 1;
+            blkdat >> FLATDATA(buf);
+            if (memcmp(buf, chainparams.MessageStart(), MESSAGE_START_SIZE))
+                continue;
+            // read size
+            blkdat >> nSize;
+            if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                continue;
+        } catch (const std::exception&) {
+            // no valid block header found; don't complain
+            break;
+        }
+        try {
+            // cut out the block, the workers deserialize it
+            uint64_t nBlockPos = blkdat.GetPos();
+            blkdat.SetLimit(nBlockPos + nSize);
+            item.vchData.resize(nSize);
+            blkdat.read(&item.vchData[0], nSize);
+            item.entry.nPos = nBlockPos;
+            item.nRewind = nRewind;
+            item.nEnd = nRewind = blkdat.GetPos();
+            return true;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: I/O error - %s\n", __func__, e.what());
+        }
+    }
+    return false;
+}
+
+int CBlockFileLoader::GetHeight(const CBlockHeader& header)
+{
+    int nHeight = -1;
+    std::map<uint256, int>::const_iterator it = mapHeights.find(header.hashPrevBlock);
+    if (it != mapHeights.end()) {
+        nHeight = it->second + 1;
+    } else {
+        int nPrevHeight = lookup(header.hashPrevBlock);
+        if (nPrevHeight >= 0)
+            nHeight = nPrevHeight + 1;
+    }
+
+    if (nHeight >= 0) {
+        uint256 hash = header.GetHash();
+        if (mapHeights.insert(std::make_pair(hash, nHeight)).second) {
+            queueHeights.push_back(hash);
+            if (queueHeights.size() > MAX_LOADER_HEIGHTS) {
+                mapHeights.erase(queueHeights.front());
+                queueHeights.pop_front();
+            }
+        }
+    }
+    return nHeight;
+}
+
+void CBlockFileLoader::ReaderLoop()
+{
+    RenameThread("bitcoin-loadread");
+
+    // This takes over file and calls fclose() on it in the CBufferedFile destructor
+    CBufferedFile blkdat(file, 2 * MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE + 8, SER_DISK, CLIENT_VERSION);
+    uint64_t nRewind = blkdat.GetPos();
+    while (true) {
+        uint64_t nGenerationRead;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fQuit && !fRewind && (fEnd || nNextRead >= nNextConsume + nWindow)) {
+                condReader.wait(lock);
+            }
+            if (fQuit) return;
+            if (fRewind) {
+                // Positions this far back have left the buffer, so seek to them
+                nRewind = nRewindPos;
+                if (!blkdat.SetPos(nRewind))
+                    blkdat.Seek(nRewind);
+                fRewind = false;
+            }
+            nGenerationRead = nGeneration;
+        }
+
+        Item item;
+        bool fFound = false;
+        try {
+            fFound = ReadNext(blkdat, nRewind, item);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: I/O error - %s\n", __func__, e.what());
+        }
+        if (fFound) {
+            CBlockHeader header;
+            CDataStream ssHeader(&item.vchData[0], &item.vchData[0] + 80, SER_DISK, CLIENT_VERSION);
+            ssHeader >> header;
+            item.entry.nHeight = GetHeight(header);
+            if (item.entry.nHeight >= 0 && item.entry.nHeight <= nCheckpointHeight)
+                item.fCheckpointed = checkpointed(header.GetHash());
+        }
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (nGenerationRead != nGeneration) {
+            // The consumer rewound the file while this block was read
+            continue;
+        }
+        if (!fFound) {
+            fEnd = true;
+            condConsumer.notify_all();
+            continue;
+        }
+        item.nSequence = nNextRead++;
+        item.nGeneration = nGenerationRead;
+        queuePending.push_back(Item());
+        std::swap(queuePending.back(), item);
+        condWorker.notify_one();
+    }
+}
+
+void CBlockFileLoader::WorkerLoop()
+{
+    RenameThread("bitcoin-loadcheck");
+
+    while (true) {
+        Item item;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fQuit && queuePending.empty()) {
+                condWorker.wait(lock);
+            }
+            if (fQuit) return;
+            std::swap(item, queuePending.front());
+            queuePending.pop_front();
+        }
+
+        try {
+            CDataStream ss(&item.vchData[0], &item.vchData[0] + item.vchData.size(), SER_DISK, CLIENT_VERSION);
+            ss >> item.entry.block;
+            item.nNext = item.nEnd - ss.size();
+            item.fRead = true;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize error - %s\n", __func__, e.what());
+        }
+        std::vector<char>().swap(item.vchData);
+
+        if (item.fRead && item.entry.nHeight >= 0)
+            check(item.entry.block, item.entry.nHeight, item.fCheckpointed);
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (item.nGeneration != nGeneration)
+            continue;
+        std::swap(mapReady[item.nSequence], item);
+        condConsumer.notify_all();
+    }
+}
+
+void CBlockFileLoader::Rewind(uint64_t nPos)
+{
+    ++nGeneration;
+    queuePending.clear();
+    mapReady.clear();
+    nNextRead = nNextConsume;
+    fEnd = false;
+    fRewind = true;
+    nRewindPos = nPos;
+    condReader.notify_all();
+}
+
+bool CBlockFileLoader::Next(Entry& entry)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (true) {
+        std::map<uint64_t, Item>::iterator it;
+        while ((it = mapReady.find(nNextConsume)) == mapReady.end()) {
+            if (fEnd && nNextConsume == nNextRead)
+                return false;
+            condConsumer.wait(lock);
+        }
+        Item item;
+        std::swap(item, it->second);
+        mapReady.erase(it);
+        ++nNextConsume;
+        condReader.notify_all();
+
+        // Scan the file again from where the single threaded loader would have
+        // continued: right after the magic of a corrupt block, or right after a
+        // block that is shorter than the size in front of it said
+        if (!item.fRead) {
+            Rewind(item.nRewind);
+            continue;
+        }
+        if (item.nNext != item.nEnd)
+            Rewind(item.nNext);
+        std::swap(entry, item.entry);
+        return true;
+    }
+}
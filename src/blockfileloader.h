@@ -0,0 +1,140 @@
+// Copyright (c) 2019 The GravityCoin Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef GRAVITYCOIN_BLOCKFILELOADER_H
+#define GRAVITYCOIN_BLOCKFILELOADER_H
+
+#include "primitives/block.h"
+#include "uint256.h"
+
+#include <deque>
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+class CBufferedFile;
+class CChainParams;
+
+/**
+ * Reads the blocks of a block file for LoadExternalBlockFile in a pipeline:
+ *
+ * - a reader thread scans the file for the network magic and cuts out the
+ *   serialized blocks,
+ * - a pool of worker threads deserializes them and does the work on them that
+ *   doesn't depend on the chain state, like computing their proof of work hash,
+ * - the caller takes the blocks strictly in file order with Next(), and
+ *   connects them.
+ *
+ * The reader works out the height of a block from the blocks before it in the
+ * file, and asks the HeightLookup for parents it hasn't seen. It asks the
+ * CheckpointLookup about blocks up to the last checkpoint, as the workers run
+ * without cs_main. Blocks at an unknown height are deserialized only. At most
+ * nWindow blocks are in flight ahead of the caller.
+ */
+class CBlockFileLoader
+{
+public:
+    //! Height of the block with the given hash, or -1 if it isn't known
+    typedef boost::function<int (const uint256&)> HeightLookup;
+    //! Whether the block with the given hash is committed to by a checkpoint
+    typedef boost::function<bool (const uint256&)> CheckpointLookup;
+    //! Work on a block at the given height that doesn't depend on the chain state
+    typedef boost::function<void (const CBlock&, int, bool)> BlockCheck;
+
+    struct Entry
+    {
+        //! Position of the block in the file
+        uint64_t nPos;
+        CBlock block;
+        //! Height of the block, or -1 if it isn't known
+        int nHeight;
+
+        Entry() : nPos(0), nHeight(-1) {}
+    };
+
+private:
+    struct Item
+    {
+        uint64_t nSequence;
+        uint64_t nGeneration;
+        //! Position to continue scanning at if the block turns out to be corrupt
+        uint64_t nRewind;
+        //! End of the block according to the size in front of it
+        uint64_t nEnd;
+        //! End of the block as deserialized
+        uint64_t nNext;
+        //! Whether the block could be deserialized
+        bool fRead;
+        //! Whether the block is committed to by a checkpoint
+        bool fCheckpointed;
+        std::vector<char> vchData;
+        Entry entry;
+
+        Item() : nSequence(0), nGeneration(0), nRewind(0), nEnd(0), nNext(0), fRead(false), fCheckpointed(false) {}
+    };
+
+    const CChainParams& chainparams;
+    const HeightLookup lookup;
+    const CheckpointLookup checkpointed;
+    const BlockCheck check;
+    //! Height of the last checkpoint, blocks above it are never checkpointed
+    const int nCheckpointHeight;
+    const uint64_t nWindow;
+    FILE* file;
+
+    boost::mutex mutex;
+    boost::condition_variable condReader;
+    boost::condition_variable condWorker;
+    boost::condition_variable condConsumer;
+    boost::thread_group threads;
+
+    //! Blocks cut out by the reader, waiting for a worker
+    std::deque<Item> queuePending;
+    //! Blocks processed by a worker, but not yet consumed, by sequence number
+    std::map<uint64_t, Item> mapReady;
+    //! Sequence number of the next block the reader cuts out
+    uint64_t nNextRead;
+    //! Sequence number of the next block to consume
+    uint64_t nNextConsume;
+    //! Whether the reader reached the end of the file; nNextRead is the end then
+    bool fEnd;
+    //! Whether the reader has to continue at nRewindPos, set by Rewind()
+    bool fRewind;
+    uint64_t nRewindPos;
+    //! Bumped by Rewind(), so blocks cut out before it are dropped
+    uint64_t nGeneration;
+    bool fQuit;
+
+    //! Heights of recently read blocks, and their order of arrival for trimming
+    std::map<uint256, int> mapHeights;
+    std::deque<uint256> queueHeights;
+
+    bool ReadNext(CBufferedFile& blkdat, uint64_t& nRewind, Item& item);
+    int GetHeight(const CBlockHeader& header);
+    void ReaderLoop();
+    void WorkerLoop();
+
+    /**
+     * Drops the blocks read ahead of the last one returned by Next(), and
+     * continues scanning the file at nPos. Requires mutex.
+     */
+    void Rewind(uint64_t nPos);
+
+public:
+    /** Takes over fileIn, and closes it when done. */
+    CBlockFileLoader(FILE* fileIn, const CChainParams& chainparamsIn, const HeightLookup& lookupIn, const CheckpointLookup& checkpointedIn, const BlockCheck& checkIn, int nThreads, int nWindowIn);
+    ~CBlockFileLoader();
+
+    /**
+     * Waits for the next block in file order, and hands it over to the caller.
+     * Returns false at the end of the file.
+     */
+    bool Next(Entry& entry);
+};
+
+#endif // GRAVITYCOIN_BLOCKFILELOADER_H
@@ -0,0 +1,133 @@
+// Copyright (c) 2019 The GravityCoin Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+
+#include "chain.h"
+#include "compat.h"
+#include "compat/endian.h"
+#include "main.h"
+#include "protocol.h"
+#include "sync.h"
+#include "util.h"
+
+#include <map>
+#include <string>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+struct CMappedFileEntry
+{
+    std::shared_ptr<const CMappedBlockFile> file;
+    uint64_t nLastUsed;
+};
+
+CCriticalSection cs_mappedBlockFiles;
+//! Mapped files by prefix and number
+std::map<std::pair<std::string, int>, CMappedFileEntry> mapMappedBlockFiles;
+uint64_t nMappedBlockFilesUsed = 0;
+
+std::shared_ptr<const CMappedBlockFile> MapFile(const CDiskBlockPos& pos, const char* prefix)
+{
+#ifndef WIN32
+    // Keeping many files of up to MAX_BLOCKFILE_SIZE mapped needs a 64 bit address space
+    if (sizeof(void*) < 8)
+        return std::shared_ptr<const CMappedBlockFile>();
+
+    boost::filesystem::path path = GetBlockPosFilename(pos, prefix);
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd < 0)
+        return std::shared_ptr<const CMappedBlockFile>();
+    struct stat st;
+    void* p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file referenced by itself
+    close(fd);
+    if (p == MAP_FAILED) {
+        LogPrint("mmap", "%s: could not map %s\n", __func__, path.string());
+        return std::shared_ptr<const CMappedBlockFile>();
+    }
+    return std::make_shared<const CMappedBlockFile>((const char*)p, (uint64_t)st.st_size);
+#else
+    return std::shared_ptr<const CMappedBlockFile>();
+#endif
+}
+
+/** Returns a mapping of the file of pos that is at least nEnd bytes long, remapping it if it grew. */
+std::shared_ptr<const CMappedBlockFile> GetMappedFile(const CDiskBlockPos& pos, const char* prefix, uint64_t nEnd)
+{
+    LOCK(cs_mappedBlockFiles);
+    std::pair<std::string, int> key(prefix, pos.nFile);
+    std::map<std::pair<std::string, int>, CMappedFileEntry>::iterator it = mapMappedBlockFiles.find(key);
+    if (it != mapMappedBlockFiles.end() && it->second.file->nSize >= nEnd) {
+        it->second.nLastUsed = ++nMappedBlockFilesUsed;
+        return it->second.file;
+    }
+
+    std::shared_ptr<const CMappedBlockFile> file = MapFile(pos, prefix);
+    if (!file || file->nSize < nEnd)
+        return std::shared_ptr<const CMappedBlockFile>();
+
+    if (it == mapMappedBlockFiles.end() && mapMappedBlockFiles.size() >= MAX_MAPPED_BLOCK_FILES) {
+        std::map<std::pair<std::string, int>, CMappedFileEntry>::iterator itOldest = mapMappedBlockFiles.begin();
+        for (std::map<std::pair<std::string, int>, CMappedFileEntry>::iterator itEntry = mapMappedBlockFiles.begin(); itEntry != mapMappedBlockFiles.end(); ++itEntry) {
+            if (itEntry->second.nLastUsed < itOldest->second.nLastUsed)
+                itOldest = itEntry;
+        }
+        mapMappedBlockFiles.erase(itOldest);
+    }
+    CMappedFileEntry& entry = mapMappedBlockFiles[key];
+    entry.file = file;
+    entry.nLastUsed = ++nMappedBlockFilesUsed;
+    return file;
+}
+
+}
+
+CMappedBlockFile::~CMappedBlockFile()
+{
+#ifndef WIN32
+    munmap((void*)pbegin, nSize);
+#endif
+}
+
+bool MapBlockRecord(const CDiskBlockPos& pos, const char* prefix, size_t nTrailer, CMappedRecord& record)
+{
+    if (pos.IsNull() || pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return false;
+
+    std::shared_ptr<const CMappedBlockFile> file = GetMappedFile(pos, prefix, pos.nPos);
+    if (!file)
+        return false;
+    unsigned int nSize;
+    memcpy(&nSize, file->pbegin + pos.nPos - sizeof(nSize), sizeof(nSize));
+    nSize = le32toh(nSize);
+    if (nSize > MAX_SIZE)
+        return false;
+
+    uint64_t nEnd = (uint64_t)pos.nPos + nSize + nTrailer;
+    if (file->nSize < nEnd) {
+        // Written after the file was mapped
+        file = GetMappedFile(pos, prefix, nEnd);
+        if (!file)
+            return false;
+    }
+    record.file = file;
+    record.pbegin = file->pbegin + pos.nPos;
+    record.nSize = nSize + nTrailer;
+    return true;
+}
+
+void UnmapBlockFile(int nFile)
+{
+    LOCK(cs_mappedBlockFiles);
+    mapMappedBlockFiles.erase(std::make_pair(std::string("blk"), nFile));
+    mapMappedBlockFiles.erase(std::make_pair(std::string("rev"), nFile));
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2019 The GravityCoin Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef GRAVITYCOIN_BLOCKFILEMAP_H
+#define GRAVITYCOIN_BLOCKFILEMAP_H
+
+#include "serialize.h"
+
+#include <ios>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
+
+struct CDiskBlockPos;
+
+/** Maximum number of block and undo files kept mapped into memory */
+static const size_t MAX_MAPPED_BLOCK_FILES = 64;
+
+/** A read-only memory mapping of a whole blk?????.dat or rev?????.dat file */
+class CMappedBlockFile
+{
+private:
+    CMappedBlockFile(const CMappedBlockFile&);
+    CMappedBlockFile& operator=(const CMappedBlockFile&);
+
+public:
+    const char* const pbegin;
+    const uint64_t nSize;
+
+    CMappedBlockFile(const char* pbeginIn, uint64_t nSizeIn) : pbegin(pbeginIn), nSize(nSizeIn) {}
+    ~CMappedBlockFile();
+};
+
+/**
+ * A block or undo record inside a mapped file. The mapping stays valid for as
+ * long as the record is held, also when it was dropped from the cache or its
+ * file was deleted meanwhile.
+ */
+struct CMappedRecord
+{
+    std::shared_ptr<const CMappedBlockFile> file;
+    const char* pbegin;
+    size_t nSize;
+
+    CMappedRecord() : pbegin(NULL), nSize(0) {}
+};
+
+/**
+ * Looks up the record at pos in the block (prefix "blk") or undo (prefix
+ * "rev") files, which is preceded by the network magic and its size, the way
+ * WriteBlockToDisk and UndoWriteToDisk store them. nTrailer more bytes after
+ * the record are included, for the checksum of undo records.
+ *
+ * The files are mapped on first use, and the most recently used ones are kept
+ * mapped. Returns false if the file can't be mapped or doesn't hold the
+ * record, callers then read the file the usual way.
+ */
+bool MapBlockRecord(const CDiskBlockPos& pos, const char* prefix, size_t nTrailer, CMappedRecord& record);
+
+/** Drops the mappings of the block and undo file nFile, before it is truncated or deleted. */
+void UnmapBlockFile(int nFile);
+
+/** Stream subset that deserializes a mapped record in place. */
+class CMappedRecordReader
+{
+private:
+    CMappedRecord record;
+    const char* pcur;
+    const char* pend;
+    int nType;
+    int nVersion;
+
+public:
+    CMappedRecordReader(const CMappedRecord& recordIn, int nTypeIn, int nVersionIn) :
+        record(recordIn), pcur(recordIn.pbegin), pend(recordIn.pbegin + recordIn.nSize), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    int GetType() const          { return nType; }
+    int GetVersion() const       { return nVersion; }
+    //! Bytes left to read
+    size_t size() const          { return pend - pcur; }
+
+    CMappedRecordReader& read(char* pch, size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CMappedRecordReader::read: end of data");
+        memcpy(pch, pcur, nSize);
+        pcur += nSize;
+        return (*this);
+    }
+
+    CMappedRecordReader& ignore(size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CMappedRecordReader::ignore: end of data");
+        pcur += nSize;
+        return (*this);
+    }
+
+    template<typename T>
+    CMappedRecordReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+#endif // GRAVITYCOIN_BLOCKFILEMAP_H
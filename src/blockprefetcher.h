@@ -0,0 +1,127 @@
+// Copyright (c) 2019 The GravityCoin Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef GRAVITYCOIN_BLOCKPREFETCHER_H
+#define GRAVITYCOIN_BLOCKPREFETCHER_H
+
+#include "chain.h"
+#include "main.h"
+#include "primitives/block.h"
+
+#include <map>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+/**
+ * Reads blocks ahead of a sequential scan over the chain on worker threads.
+ *
+ * The workers deserialize the blocks and run a filter over their transactions,
+ * while the scanning thread consumes the blocks strictly in order. At most
+ * nWindow blocks are buffered ahead of the block being consumed.
+ *
+ * Blocks are read with ReadIndexedBlockFromDisk, so the filter and the blocks
+ * to read must not require cs_main.
+ */
+class CBlockPrefetcher
+{
+public:
+    //! Decides whether a transaction of a block is of interest to the scan
+    typedef boost::function<bool (const CTransaction&, const CBlockIndex*)> TxFilter;
+
+    struct Entry
+    {
+        bool fRead;
+        CBlock block;
+        //! Whether a transaction of the block passed the filter
+        std::vector<bool> vCandidates;
+
+        Entry() : fRead(false) {}
+    };
+
+private:
+    //! The blocks to read, in scan order
+    const std::vector<const CBlockIndex*>& vIndexes;
+    const TxFilter filter;
+    const int nWindow;
+
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+    boost::condition_variable condConsumer;
+    boost::thread_group threads;
+
+    //! Blocks read, but not yet consumed, by position in vIndexes
+    std::map<size_t, Entry> mapReady;
+    //! Position of the next block to read
+    size_t nNextRead;
+    //! Position of the next block to consume
+    size_t nNextConsume;
+    bool fQuit;
+
+    void Loop()
+    {
+        while (true) {
+            size_t nPos;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (!fQuit && nNextRead < vIndexes.size() && nNextRead >= nNextConsume + nWindow) {
+                    condWorker.wait(lock);
+                }
+                if (fQuit || nNextRead >= vIndexes.size()) return;
+                nPos = nNextRead++;
+            }
+
+            const CBlockIndex* pindex = vIndexes[nPos];
+            Entry entry;
+            entry.fRead = ReadIndexedBlockFromDisk(entry.block, pindex);
+            if (entry.fRead) {
+                entry.vCandidates.resize(entry.block.vtx.size());
+                for (size_t i = 0; i < entry.block.vtx.size(); ++i) {
+                    entry.vCandidates[i] = filter(entry.block.vtx[i], pindex);
+                }
+            }
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            std::swap(mapReady[nPos], entry);
+            condConsumer.notify_all();
+        }
+    }
+
+public:
+    CBlockPrefetcher(const std::vector<const CBlockIndex*>& vIndexesIn, const TxFilter& filterIn, int nThreads, int nWindowIn)
+      : vIndexes(vIndexesIn), filter(filterIn), nWindow(std::max(nWindowIn, 1)), nNextRead(0), nNextConsume(0), fQuit(false)
+    {
+        for (int i = 0; i < nThreads; ++i) {
+            threads.create_thread(boost::bind(&CBlockPrefetcher::Loop, this));
+        }
+    }
+
+    ~CBlockPrefetcher()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fQuit = true;
+        }
+        condWorker.notify_all();
+        threads.join_all();
+    }
+
+    /** Waits for the next block in scan order, and hands it over to the caller. */
+    void Next(Entry& entry)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        std::map<size_t, Entry>::iterator it;
+        while ((it = mapReady.find(nNextConsume)) == mapReady.end()) {
+            condConsumer.wait(lock);
+        }
+        std::swap(entry, it->second);
+        mapReady.erase(it);
+        ++nNextConsume;
+        condWorker.notify_all();
+    }
+};
+
+#endif // GRAVITYCOIN_BLOCKPREFETCHER_H
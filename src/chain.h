@@ -21,6 +21,7 @@
 #include "coin_containers.h"
 #include "streams.h"
 
+#include <atomic>
 #include <vector>
 #include <unordered_set>
 
@@ -159,6 +160,25 @@ enum BlockStatus: uint32_t {
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
 };
 
+/**
+ * A value memoized in a CBlockIndex, which may be filled in concurrently from
+ * threads with and without cs_main. Copies start out empty again.
+ */
+class CBlockIndexMemo
+{
+private:
+    std::atomic<unsigned int> nValue;
+
+public:
+    CBlockIndexMemo() : nValue(0) {}
+    CBlockIndexMemo(const CBlockIndexMemo&) : nValue(0) {}
+    CBlockIndexMemo& operator=(const CBlockIndexMemo&) { nValue = 0; return *this; }
+
+    //! The value, 0 if not computed yet
+    unsigned int Get() const { return nValue.load(std::memory_order_relaxed); }
+    void Set(unsigned int n) { nValue.store(n, std::memory_order_relaxed); }
+};
+
 /** The block chain is a tree shaped structure starting with the
  * genesis block at the root, with each block potentially having multiple
  * candidates to be the next block. A blockindex may have multiple pprev pointing
@@ -210,6 +230,9 @@ public:
     unsigned int nBits;
     unsigned int nNonce;
 
+    //! (memory only) Memoized difficulty retarget for the child of this block
+    mutable CBlockIndexMemo nNextWorkRequired;
+
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
     uint32_t nSequenceId;
 
@@ -256,6 +279,7 @@ public:
         nTime          = 0;
         nBits          = 0;
         nNonce         = 0;
+        nNextWorkRequired.Set(0);
 
         mintedPubCoins.clear();
         sigmaMintedPubCoins.clear();
@@ -25,7 +25,7 @@ CBlockIndex* GetLastCheckpoint(const CCheckpointData& data);
 //! Return conservative estimate of total number of blocks, 0 if unknown
 int GetTotalBlocksEstimate(const CCheckpointData& data);
 
-double GuessVerificationProgress(const CCheckpointData& data, CBlockIndex* pindex, bool fSigchecks = true);
+double GuessVerificationProgress(const CCheckpointData& data, const CBlockIndex* pindex, bool fSigchecks = true);
 
 } //namespace Checkpoints
 
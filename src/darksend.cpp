@@ -17,7 +17,12 @@
 #include "util.h"
 #include "utilmoneystr.h"
 
+#include "crypto/sha256.h"
+#include "cuckoocache.h"
+#include "random.h"
+
 #include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
 
 int nPrivateSendRounds = DEFAULT_PRIVATESEND_ROUNDS;
 int nPrivateSendAmount = DEFAULT_PRIVATESEND_AMOUNT;
@@ -30,6 +35,68 @@ CDarkSendSigner darkSendSigner;
 std::map <uint256, CDarksendBroadcastTx> mapDarksendBroadcastTxes;
 std::vector <CAmount> vecPrivateSendDenominations;
 
+namespace {
+
+/** Memory for the verified message signature cache, in bytes */
+const size_t MESSAGE_SIG_CACHE_BYTES = 4 << 20;
+
+/** Entries already are salted hashes, so the cuckoo cache hashes are taken straight out of them */
+class CMessageSignatureCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select < 8, "CMessageSignatureCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+
+/**
+ * Message signatures that verified before, so the ones CXnodeSigCheckPool
+ * verified ahead, and the ones checked more than once while a message is
+ * processed, aren't recovered again
+ */
+class CMessageSignatureCache
+{
+private:
+    //! Entries are SHA256(nonce || message hash || public key || signature)
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, CMessageSignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_cache;
+
+public:
+    CMessageSignatureCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+        setValid.setup_bytes(MESSAGE_SIG_CACHE_BYTES);
+    }
+
+    void ComputeEntry(uint256& entry, const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(pubkey.begin(), pubkey.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_cache);
+        return setValid.contains(entry, false);
+    }
+
+    void Set(const uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_cache);
+        setValid.insert(entry);
+    }
+};
+
+CMessageSignatureCache messageSignatureCache;
+
+}
+
 void CDarksendPool::ProcessMessage(CNode *pfrom, std::string &strCommand, CDataStream &vRecv) {
     if (fLiteMode) return; // ignore all GravityCoin related functionality
     if (!xnodeSync.IsBlockchainSynced()) return;
@@ -2339,9 +2406,15 @@ bool CDarkSendSigner::VerifyMessage(CPubKey pubkey, const std::vector<unsigned c
     CHashWriter ss(SER_GETHASH, 0);
     ss << strMessageMagic;
     ss << strMessage;
+    uint256 hash = ss.GetHash();
+
+    uint256 entry;
+    messageSignatureCache.ComputeEntry(entry, hash, vchSig, pubkey);
+    if (messageSignatureCache.Get(entry))
+        return true;
 
     CPubKey pubkeyFromSig;
-    if (!pubkeyFromSig.RecoverCompact(ss.GetHash(), vchSig)) {
+    if (!pubkeyFromSig.RecoverCompact(hash, vchSig)) {
         strErrorRet = "Error recovering public key.";
         return false;
     }
@@ -2353,6 +2426,7 @@ bool CDarkSendSigner::VerifyMessage(CPubKey pubkey, const std::vector<unsigned c
         return false;
     }
 
+    messageSignatureCache.Set(entry);
     return true;
 }
 
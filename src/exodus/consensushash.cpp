@@ -15,6 +15,8 @@
 #include "arith_uint256.h"
 #include "uint256.h"
 
+#include "crypto/sha256.h"
+
 #include <stdint.h>
 #include <algorithm>
 #include <string>
@@ -24,6 +26,15 @@
 
 namespace exodus
 {
+/**
+ * Sum of the hashes of all non-empty balance records, modulo 2^256.
+ *
+ * The balance records are hashed in their consensus string representation, so the
+ * order in which balances are updated doesn't matter, and a record can be removed
+ * again by subtracting its hash.
+ */
+static arith_uint256 balancesStateHash;
+
 bool ShouldConsensusHashBlock(int block) {
     if (exodus_debug_consensus_hash_every_block) {
         return true;
@@ -45,6 +56,10 @@ bool ShouldConsensusHashBlock(int block) {
     return false;
 }
 
+bool ShouldStateHashBlock(int block) {
+    return exodus_debug_state_hash_every_block;
+}
+
 // Generates a consensus string for hashing based on a tally object
 std::string GenerateConsensusString(const CMPTally& tallyObj, const std::string& address, const uint32_t propertyId)
 {
@@ -98,6 +113,31 @@ std::string GenerateConsensusString(const uint32_t propertyId, const std::string
     return strprintf("%d|%s", propertyId, address);
 }
 
+typedef std::pair<const std::string, CMPTally> TallyMapEntry;
+
+static bool CompareTallyMapEntries(const TallyMapEntry* lhs, const TallyMapEntry* rhs)
+{
+    return lhs->first < rhs->first;
+}
+
+// Orders the entries of the tally map by address, without copying the tallies
+static void SortTallyMap(std::vector<TallyMapEntry*>& vSorted)
+{
+    vSorted.reserve(mp_tally_map.size());
+    for (std::unordered_map<string, CMPTally>::iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
+        vSorted.push_back(&(*uoit));
+    }
+    std::sort(vSorted.begin(), vSorted.end(), CompareTallyMapEntries);
+}
+
+// Hashes a single consensus string as element of a multiset
+static arith_uint256 HashStateElement(const std::string& dataStr)
+{
+    uint256 hash;
+    CSHA256().Write((const unsigned char*)dataStr.data(), dataStr.size()).Finalize((unsigned char*)&hash);
+    return UintToArith256(hash);
+}
+
 /**
  * Obtains a hash of the active state to use for consensus verification and checkpointing.
  *
@@ -160,13 +200,11 @@ uint256 GetConsensusHash()
     // Balances - loop through the tally map, updating the sha context with the data from each balance and tally type
     // Placeholders:  "address|propertyid|balance|selloffer_reserve|accept_reserve|metadex_reserve"
     // Sort alphabetically first
-    std::map<std::string, CMPTally> tallyMapSorted;
-    for (std::unordered_map<string, CMPTally>::iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
-        tallyMapSorted.insert(std::make_pair(uoit->first,uoit->second));
-    }
-    for (std::map<string, CMPTally>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
-        const std::string& address = my_it->first;
-        CMPTally& tally = my_it->second;
+    std::vector<TallyMapEntry*> tallyMapSorted;
+    SortTallyMap(tallyMapSorted);
+    for (std::vector<TallyMapEntry*>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
+        const std::string& address = (*my_it)->first;
+        CMPTally& tally = (*my_it)->second;
         tally.init();
         uint32_t propertyId = 0;
         while (0 != (propertyId = (tally.next()))) {
@@ -318,13 +356,11 @@ uint256 GetBalancesHash(const uint32_t hashPropertyId)
 
     LOCK(cs_tally);
 
-    std::map<std::string, CMPTally> tallyMapSorted;
-    for (std::unordered_map<string, CMPTally>::iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
-        tallyMapSorted.insert(std::make_pair(uoit->first,uoit->second));
-    }
-    for (std::map<string, CMPTally>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
-        const std::string& address = my_it->first;
-        CMPTally& tally = my_it->second;
+    std::vector<TallyMapEntry*> tallyMapSorted;
+    SortTallyMap(tallyMapSorted);
+    for (std::vector<TallyMapEntry*>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
+        const std::string& address = (*my_it)->first;
+        CMPTally& tally = (*my_it)->second;
         tally.init();
         uint32_t propertyId = 0;
         while (0 != (propertyId = (tally.next()))) {
@@ -342,4 +378,115 @@ uint256 GetBalancesHash(const uint32_t hashPropertyId)
     return balancesHash;
 }
 
+/**
+ * Obtains an order independent hash of the active state.
+ *
+ * Unlike the consensus hash, which is used for checkpoints and hashes all entries
+ * sequentially, every entry is hashed individually, using the same consensus string
+ * representation, and the hashes of each stage are summed up modulo 2^256.
+ *
+ * The balances part, which is by far the largest, is maintained incrementally for
+ * every tally update, while the DEx offers, accepts, MetaDEx trades and crowdsales
+ * are summed up on demand, which requires no sorting. The property issuers are not
+ * covered, because they would need to be loaded from the database.
+ *
+ * The final hash is the SHA256 hash of the stage sums.
+ */
+uint256 GetStateHash()
+{
+    LOCK(cs_tally);
+
+    arith_uint256 offersHash;
+    for (OfferMap::const_iterator it = my_offers.begin(); it != my_offers.end(); ++it) {
+        const std::string& sellCombo = it->first;
+        std::string seller = sellCombo.substr(0, sellCombo.size() - 2);
+        offersHash += HashStateElement(GenerateConsensusString(it->second, seller));
+    }
+
+    arith_uint256 acceptsHash;
+    for (AcceptMap::const_iterator it = my_accepts.begin(); it != my_accepts.end(); ++it) {
+        const std::string& acceptCombo = it->first;
+        std::string buyer = acceptCombo.substr((acceptCombo.find("+") + 1), (acceptCombo.size()-(acceptCombo.find("+") + 1)));
+        acceptsHash += HashStateElement(GenerateConsensusString(it->second, buyer));
+    }
+
+    arith_uint256 tradesHash;
+    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        const md_PricesMap& prices = my_it->second;
+        for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
+            const md_Set& indexes = it->second;
+            for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
+                tradesHash += HashStateElement(GenerateConsensusString(*it));
+            }
+        }
+    }
+
+    arith_uint256 crowdsHash;
+    for (CrowdMap::const_iterator it = my_crowds.begin(); it != my_crowds.end(); ++it) {
+        crowdsHash += HashStateElement(GenerateConsensusString(it->second));
+    }
+
+    uint256 stages[5] = {
+        ArithToUint256(balancesStateHash),
+        ArithToUint256(offersHash),
+        ArithToUint256(acceptsHash),
+        ArithToUint256(tradesHash),
+        ArithToUint256(crowdsHash)
+    };
+
+    uint256 stateHash;
+    CSHA256().Write((const unsigned char*)stages, sizeof(stages)).Finalize((unsigned char*)&stateHash);
+
+    return stateHash;
+}
+
+void AddBalanceToStateHash(const CMPTally& tally, const std::string& address, uint32_t propertyId)
+{
+    AssertLockHeld(cs_tally);
+
+    std::string dataStr = GenerateConsensusString(tally, address, propertyId);
+    if (!dataStr.empty()) balancesStateHash += HashStateElement(dataStr);
+}
+
+void RemoveBalanceFromStateHash(const CMPTally& tally, const std::string& address, uint32_t propertyId)
+{
+    AssertLockHeld(cs_tally);
+
+    std::string dataStr = GenerateConsensusString(tally, address, propertyId);
+    if (!dataStr.empty()) balancesStateHash -= HashStateElement(dataStr);
+}
+
+void ResetBalancesStateHash()
+{
+    AssertLockHeld(cs_tally);
+
+    balancesStateHash = 0;
+}
+
+bool VerifyBalancesStateHash()
+{
+    LOCK(cs_tally);
+
+    arith_uint256 rebuiltHash;
+    for (std::unordered_map<string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
+        CMPTally& tally = my_it->second;
+        tally.init();
+        uint32_t propertyId = 0;
+        while (0 != (propertyId = (tally.next()))) {
+            std::string dataStr = GenerateConsensusString(tally, my_it->first, propertyId);
+            if (!dataStr.empty()) rebuiltHash += HashStateElement(dataStr);
+        }
+    }
+
+    if (rebuiltHash != balancesStateHash) {
+        // the maintained hash is kept as it is, a mismatch is a bug to be found, not to be papered over
+        PrintToLog("%s(): ERROR: balances state hash mismatch - maintained %s, rebuilt %s\n", __func__,
+                balancesStateHash.GetHex(), rebuiltHash.GetHex());
+        LogPrintf("ERROR: Exodus balances state hash mismatch, see exodus.log for details\n");
+        return false;
+    }
+
+    return true;
+}
+
 } // namespace exodus
@@ -3,11 +3,19 @@
 
 #include "uint256.h"
 
+#include <stdint.h>
+#include <string>
+
+class CMPTally;
+
 namespace exodus
 {
 /** Checks if a given block should be consensus hashed. */
 bool ShouldConsensusHashBlock(int block);
 
+/** Checks if the state hash should be logged for a given block. */
+bool ShouldStateHashBlock(int block);
+
 /** Obtains a hash of all balances to use for consensus verification and checkpointing. */
 uint256 GetConsensusHash();
 
@@ -17,6 +25,27 @@ uint256 GetMetaDExHash(const uint32_t propertyId = 0);
 /** Obtains a hash of the balances for a specific property. */
 uint256 GetBalancesHash(const uint32_t hashPropertyId);
 
+/**
+ * Obtains an order independent hash of the current state, to log for every block.
+ *
+ * Only the balances are hashed incrementally. The DEx offers and accepts, the
+ * MetaDEx trades and the crowdsales are still summed up on every call, so the
+ * cost grows with the number of open orders and crowdsales.
+ */
+uint256 GetStateHash();
+
+/** Adds a balance record to the incrementally maintained state hash. */
+void AddBalanceToStateHash(const CMPTally& tally, const std::string& address, uint32_t propertyId);
+
+/** Removes a balance record from the incrementally maintained state hash. */
+void RemoveBalanceFromStateHash(const CMPTally& tally, const std::string& address, uint32_t propertyId);
+
+/** Resets the incrementally maintained state hash, after the tally map was cleared. */
+void ResetBalancesStateHash();
+
+/** Rebuilds the balances part of the state hash from scratch and checks it against the maintained one. Expensive, only run on request. */
+bool VerifyBalancesStateHash();
+
 }
 
 #endif // EXODUS_CONSENSUSHASH_H
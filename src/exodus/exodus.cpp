@@ -30,16 +30,20 @@
 #include "exodus/wallettxs.h"
 
 #include "base58.h"
+#include "blockprefetcher.h"
 #include "chainparams.h"
+#include "clientversion.h"
 #include "coincontrol.h"
 #include "coins.h"
 #include "core_io.h"
+#include "hash.h"
 #include "init.h"
 #include "main.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "script/script.h"
 #include "script/standard.h"
+#include "streams.h"
 #include "sync.h"
 #include "tinyformat.h"
 #include "uint256.h"
@@ -47,6 +51,7 @@
 #include "util.h"
 #include "utilstrencodings.h"
 #include "utiltime.h"
+#include "validationinterface.h"
 #ifdef ENABLE_WALLET
 #include "script/ismine.h"
 #include "wallet/wallet.h"
@@ -59,6 +64,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
 
 #include <openssl/sha.h>
 
@@ -126,6 +132,13 @@ static int64_t exodus_prev = 0;
 
 static boost::filesystem::path MPPersistencePath;
 
+//! Extension of the legacy, line based state files
+static const char* const STATE_FILE_TEXT = "dat";
+//! Extension of the binary state files
+static const char* const STATE_FILE_BINARY = "bin";
+//! Suffix of a state file while it is written
+static const char* const STATE_FILE_TMP_SUFFIX = ".new";
+
 static int exodusInitialized = 0;
 
 static int reorgRecoveryMode = 0;
@@ -494,7 +507,9 @@ bool exodus::update_tally_map(const std::string& who, uint32_t propertyId, int64
     }
 
     CMPTally& tally = my_it->second;
+    if (ttype != PENDING) RemoveBalanceFromStateHash(tally, who, propertyId);
     bRet = tally.updateMoney(propertyId, amount, ttype);
+    if (ttype != PENDING) AddBalanceToStateHash(tally, who, propertyId);
 
     after = getMPbalance(who, propertyId, ttype);
     if (!bRet) {
@@ -1303,6 +1318,12 @@ public:
     }
 };
 
+/** Marks the transactions, which may carry an Exodus payload. */
+static bool IsExodusScanCandidate(const CTransaction& tx, const CBlockIndex* pindex)
+{
+    return GetEncodingClass(tx, pindex->nHeight) != NO_MARKER;
+}
+
 /**
  * Scans the blockchain for meta transactions.
  *
@@ -1337,6 +1358,21 @@ static int exodus_initial_scan(int nFirstBlock)
     // used to print the progress to the console and notifies the UI
     ProgressReporter progressReporter(chainActive[nFirstBlock], chainActive[nLastBlock]);
 
+    // resolve the blocks upfront, so the prefetching threads don't need to access the chain
+    std::vector<const CBlockIndex*> vIndexes;
+    vIndexes.reserve(nLastBlock - nFirstBlock + 1);
+    for (nBlock = nFirstBlock; nBlock <= nLastBlock; ++nBlock) {
+        const CBlockIndex* pblockindex = chainActive[nBlock];
+        if (NULL == pblockindex) break;
+        vIndexes.push_back(pblockindex);
+    }
+
+    int nScanThreads = GetArg("-exodusscanthreads", DEFAULT_EXODUS_SCAN_THREADS);
+    if (nScanThreads <= 0) {
+        nScanThreads = std::max(boost::thread::hardware_concurrency(), 1U);
+    }
+    CBlockPrefetcher prefetcher(vIndexes, IsExodusScanCandidate, nScanThreads, 16 * nScanThreads);
+
     for (nBlock = nFirstBlock; nBlock <= nLastBlock; ++nBlock)
     {
         if (ShutdownRequested()) {
@@ -1344,8 +1380,8 @@ static int exodus_initial_scan(int nFirstBlock)
             break;
         }
 
-        CBlockIndex* pblockindex = chainActive[nBlock];
-        if (NULL == pblockindex) break;
+        if (nBlock - nFirstBlock >= (int)vIndexes.size()) break;
+        const CBlockIndex* pblockindex = vIndexes[nBlock - nFirstBlock];
         std::string strBlockHash = pblockindex->GetBlockHash().GetHex();
 
         if (exodus_debug_exo) PrintToLog("%s(%d; max=%d):%s, line %d, file: %s\n",
@@ -1357,18 +1393,22 @@ static int exodus_initial_scan(int nFirstBlock)
         }
 
         // Get block to parse.
-        CBlock block;
-
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus())) {
+        CBlockPrefetcher::Entry entry;
+        prefetcher.Next(entry);
+        if (!entry.fRead) {
             break;
         }
+        const CBlock& block = entry.block;
 
         // Parse block.
         unsigned parsed = 0;
 
         exodus_handler_block_begin(nBlock, pblockindex);
 
+        // Transactions without marker can't be Exodus transactions, and therefore also
+        // can't be pending, so they are skipped entirely.
         for (unsigned i = 0; i < block.vtx.size(); i++) {
+            if (!entry.vCandidates[i]) continue;
             if (exodus_handler_tx(block.vtx[i], nBlock, i, pblockindex)) {
                 parsed++;
             }
@@ -1610,6 +1650,7 @@ static int exodus_file_load(const string &filename, int what, bool verifyHash =
   {
     case FILETYPE_BALANCES:
       mp_tally_map.clear();
+      ResetBalancesStateHash();
       inputLineFunc = input_exodus_balances_string;
       break;
 
@@ -1722,6 +1763,164 @@ static char const * const statePrefix[NUM_FILETYPES] = {
     "mdexorders",
 };
 
+//! Hash and location of the last binary state file written or loaded, per file type
+static uint256 lastStateHash[NUM_FILETYPES];
+static boost::filesystem::path lastStateFile[NUM_FILETYPES];
+
+static boost::filesystem::path get_state_file_path(int what, const uint256& blockHash, const char* extension)
+{
+    return MPPersistencePath / strprintf("%s-%s.%s", statePrefix[what], blockHash.ToString(), extension);
+}
+
+static void reset_state_file_cache()
+{
+    for (int i = 0; i < NUM_FILETYPES; ++i) {
+        lastStateHash[i].SetNull();
+        lastStateFile[i].clear();
+    }
+}
+
+static void read_exodus_balances(CDataStream& ssState)
+{
+    uint64_t nAddresses = ReadCompactSize(ssState);
+    for (uint64_t n = 0; n < nAddresses; ++n) {
+        std::string strAddress;
+        ssState >> strAddress;
+
+        uint64_t nProperties = ReadCompactSize(ssState);
+        for (uint64_t k = 0; k < nProperties; ++k) {
+            uint32_t propertyId;
+            int64_t balance, sellReserved, acceptReserved, metadexReserved;
+            ssState >> propertyId >> balance >> sellReserved >> acceptReserved >> metadexReserved;
+
+            if (balance) update_tally_map(strAddress, propertyId, balance, BALANCE);
+            if (sellReserved) update_tally_map(strAddress, propertyId, sellReserved, SELLOFFER_RESERVE);
+            if (acceptReserved) update_tally_map(strAddress, propertyId, acceptReserved, ACCEPT_RESERVE);
+            if (metadexReserved) update_tally_map(strAddress, propertyId, metadexReserved, METADEX_RESERVE);
+        }
+    }
+}
+
+static int read_mp_metadex(CDataStream& ssState)
+{
+    uint64_t nOrders = ReadCompactSize(ssState);
+    for (uint64_t n = 0; n < nOrders; ++n) {
+        CMPMetaDEx mdexObj;
+        ssState >> mdexObj;
+        if (!MetaDEx_INSERT(mdexObj)) return -1;
+    }
+
+    return 0;
+}
+
+static void read_globals_state(CDataStream& ssState)
+{
+    int64_t exodusPrev;
+    uint32_t nextSPID, nextTestSPID;
+    ssState >> exodusPrev >> nextSPID >> nextTestSPID;
+
+    exodus_prev = exodusPrev;
+    _my_sps->init(nextSPID, nextTestSPID);
+}
+
+/**
+ * Loads a binary state file.
+ *
+ * The file consists of the serialized state, followed by the double SHA256 hash of it.
+ */
+static int exodus_file_load_binary(const boost::filesystem::path& path, int what)
+{
+    const std::string strFile = path.string();
+
+    if (exodus_debug_persistence) {
+        LogPrintf("Loading %s ... \n", strFile);
+    }
+
+    boost::system::error_code ec;
+    uintmax_t nFileSize = boost::filesystem::file_size(path, ec);
+    if (ec || nFileSize < sizeof(uint256)) {
+        if (exodus_debug_persistence) LogPrintf("%s(%s): file not found or truncated\n", __func__, strFile);
+        return -1;
+    }
+
+    CAutoFile filein(fopen(strFile.c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        if (exodus_debug_persistence) LogPrintf("%s(%s): failed to open file\n", __func__, strFile);
+        return -1;
+    }
+
+    // read the whole file at once, and verify it, before touching any state
+    std::vector<char> vchData(nFileSize - sizeof(uint256));
+    uint256 fileHash;
+    try {
+        if (!vchData.empty()) filein.read(&vchData[0], vchData.size());
+        filein >> fileHash;
+    } catch (const std::exception& e) {
+        PrintToLog("%s(%s): failed to read file: %s\n", __func__, strFile, e.what());
+        return -1;
+    }
+    filein.fclose();
+
+    uint256 hash = Hash(vchData.begin(), vchData.end());
+    if (hash != fileHash) {
+        PrintToLog("File %s loaded, but failed hash validation!\n", strFile);
+        return -1;
+    }
+
+    CDataStream ssState(vchData, SER_DISK, CLIENT_VERSION);
+    int res = 0;
+
+    try {
+        switch (what) {
+            case FILETYPE_BALANCES:
+                mp_tally_map.clear();
+                ResetBalancesStateHash();
+                read_exodus_balances(ssState);
+                break;
+
+            case FILETYPE_OFFERS:
+                my_offers.clear();
+                ssState >> my_offers;
+                break;
+
+            case FILETYPE_ACCEPTS:
+                my_accepts.clear();
+                ssState >> my_accepts;
+                break;
+
+            case FILETYPE_GLOBALS:
+                read_globals_state(ssState);
+                break;
+
+            case FILETYPE_CROWDSALES:
+                my_crowds.clear();
+                ssState >> my_crowds;
+                break;
+
+            case FILETYPE_MDEXORDERS:
+                metadex.clear();
+                res = read_mp_metadex(ssState);
+                break;
+
+            default:
+                return -1;
+        }
+    } catch (const std::exception& e) {
+        PrintToLog("%s(%s): failed to deserialize state: %s\n", __func__, strFile, e.what());
+        res = -1;
+    }
+
+    if (res == 0) {
+        lastStateHash[what] = hash;
+        lastStateFile[what] = path;
+    }
+
+    PrintToLog("%s(%s), loaded bytes= %d, res= %d\n", __func__, strFile, vchData.size(), res);
+    LogPrintf("%s(): file: %s , loaded bytes= %d, res= %d\n", __func__, strFile, vchData.size(), res);
+
+    return res;
+}
+
 // returns the height of the state loaded
 static int load_most_relevant_state()
 {
@@ -1769,7 +1968,7 @@ static int load_most_relevant_state()
     std::vector<std::string> vstr;
     boost::split(vstr, fName, boost::is_any_of("-."), token_compress_on);
     if (  vstr.size() == 3 &&
-          boost::equals(vstr[2], "dat")) {
+          (boost::equals(vstr[2], STATE_FILE_BINARY) || boost::equals(vstr[2], STATE_FILE_TEXT))) {
       uint256 blockHash;
       blockHash.SetHex(vstr[1]);
       CBlockIndex *pBlockIndex = GetBlockIndex(blockHash);
@@ -1792,10 +1991,16 @@ static int load_most_relevant_state()
   while (NULL != curTip && persistedBlocks.size() > 0 && curTip->nHeight > abortRollBackBlock) {
     if (persistedBlocks.find(spBlockIndex->GetBlockHash()) != persistedBlocks.end()) {
       int success = -1;
+      reset_state_file_cache();
       for (int i = 0; i < NUM_FILETYPES; ++i) {
-        boost::filesystem::path path = MPPersistencePath / strprintf("%s-%s.dat", statePrefix[i], curTip->GetBlockHash().ToString());
-        const std::string strFile = path.string();
-        success = exodus_file_load(strFile, i, true);
+        // prefer the binary state, and fall back to state files written by older versions
+        boost::filesystem::path path = get_state_file_path(i, curTip->GetBlockHash(), STATE_FILE_BINARY);
+        if (boost::filesystem::exists(path)) {
+          success = exodus_file_load_binary(path, i);
+        } else {
+          path = get_state_file_path(i, curTip->GetBlockHash(), STATE_FILE_TEXT);
+          success = exodus_file_load(path.string(), i, true);
+        }
         if (success < 0) {
           break;
         }
@@ -1830,177 +2035,168 @@ static int load_most_relevant_state()
   return res;
 }
 
-static int write_exodus_balances(std::ofstream& file, SHA256_CTX* shaCtx)
+static void write_exodus_balances(CDataStream& ssState)
 {
+    // count the non-empty entries first, so the records can be streamed right away
+    uint64_t nAddresses = 0;
+    CDataStream ssRecords(SER_DISK, CLIENT_VERSION);
+    std::vector<uint32_t> vProperties;
+
     std::unordered_map<std::string, CMPTally>::iterator iter;
     for (iter = mp_tally_map.begin(); iter != mp_tally_map.end(); ++iter) {
-        bool emptyWallet = true;
-
-        std::string lineOut = (*iter).first;
-        lineOut.append("=");
         CMPTally& curAddr = (*iter).second;
+
+        vProperties.clear();
         curAddr.init();
         uint32_t propertyId = 0;
         while (0 != (propertyId = curAddr.next())) {
-            int64_t balance = (*iter).second.getMoney(propertyId, BALANCE);
-            int64_t sellReserved = (*iter).second.getMoney(propertyId, SELLOFFER_RESERVE);
-            int64_t acceptReserved = (*iter).second.getMoney(propertyId, ACCEPT_RESERVE);
-            int64_t metadexReserved = (*iter).second.getMoney(propertyId, METADEX_RESERVE);
-
             // we don't allow 0 balances to read in, so if we don't write them
             // it makes things match up better between persisted state and processed state
-            if (0 == balance && 0 == sellReserved && 0 == acceptReserved && 0 == metadexReserved) {
+            if (0 == curAddr.getMoney(propertyId, BALANCE) &&
+                0 == curAddr.getMoney(propertyId, SELLOFFER_RESERVE) &&
+                0 == curAddr.getMoney(propertyId, ACCEPT_RESERVE) &&
+                0 == curAddr.getMoney(propertyId, METADEX_RESERVE)) {
                 continue;
             }
-
-            emptyWallet = false;
-
-            lineOut.append(strprintf("%d:%d,%d,%d,%d;",
-                    propertyId,
-                    balance,
-                    sellReserved,
-                    acceptReserved,
-                    metadexReserved));
+            vProperties.push_back(propertyId);
         }
 
-        if (false == emptyWallet) {
-            // add the line to the hash
-            SHA256_Update(shaCtx, lineOut.c_str(), lineOut.length());
+        if (vProperties.empty()) {
+            continue;
+        }
 
-            // write the line
-            file << lineOut << endl;
+        ssRecords << (*iter).first;
+        WriteCompactSize(ssRecords, vProperties.size());
+        for (std::vector<uint32_t>::const_iterator it = vProperties.begin(); it != vProperties.end(); ++it) {
+            ssRecords << *it;
+            ssRecords << curAddr.getMoney(*it, BALANCE);
+            ssRecords << curAddr.getMoney(*it, SELLOFFER_RESERVE);
+            ssRecords << curAddr.getMoney(*it, ACCEPT_RESERVE);
+            ssRecords << curAddr.getMoney(*it, METADEX_RESERVE);
         }
+        ++nAddresses;
     }
 
-    return 0;
-}
-
-static int write_mp_offers(ofstream &file, SHA256_CTX *shaCtx)
-{
-  OfferMap::const_iterator iter;
-  for (iter = my_offers.begin(); iter != my_offers.end(); ++iter) {
-    // decompose the key for address
-    std::vector<std::string> vstr;
-    boost::split(vstr, (*iter).first, boost::is_any_of("-"), token_compress_on);
-    CMPOffer const &offer = (*iter).second;
-    offer.saveOffer(file, shaCtx, vstr[0]);
-  }
-
-
-  return 0;
+    WriteCompactSize(ssState, nAddresses);
+    ssState += ssRecords;
 }
 
-static int write_mp_metadex(ofstream &file, SHA256_CTX *shaCtx)
+static void write_mp_metadex(CDataStream& ssState)
 {
-  for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it)
-  {
-    md_PricesMap & prices = my_it->second;
-    for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it)
-    {
-      md_Set & indexes = (it->second);
-      for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it)
-      {
-        CMPMetaDEx meta = *it;
-        meta.saveOffer(file, shaCtx);
-      }
+    uint64_t nOrders = 0;
+    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        const md_PricesMap& prices = my_it->second;
+        for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
+            nOrders += it->second.size();
+        }
     }
-  }
-
-  return 0;
-}
-
-static int write_mp_accepts(ofstream &file, SHA256_CTX *shaCtx)
-{
-  AcceptMap::const_iterator iter;
-  for (iter = my_accepts.begin(); iter != my_accepts.end(); ++iter) {
-    // decompose the key for address
-    std::vector<std::string> vstr;
-    boost::split(vstr, (*iter).first, boost::is_any_of("-+"), token_compress_on);
-    CMPAccept const &accept = (*iter).second;
-    accept.saveAccept(file, shaCtx, vstr[0], vstr[1]);
-  }
 
-  return 0;
+    WriteCompactSize(ssState, nOrders);
+    for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        const md_PricesMap& prices = my_it->second;
+        for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
+            const md_Set& indexes = it->second;
+            for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
+                ssState << *it;
+            }
+        }
+    }
 }
 
-static int write_globals_state(ofstream &file, SHA256_CTX *shaCtx)
+static void write_globals_state(CDataStream& ssState)
 {
-  unsigned int nextSPID = _my_sps->peekNextSPID(EXODUS_PROPERTY_EXODUS);
-  unsigned int nextTestSPID = _my_sps->peekNextSPID(EXODUS_PROPERTY_TEXODUS);
-  std::string lineOut = strprintf("%d,%d,%d",
-    exodus_prev,
-    nextSPID,
-    nextTestSPID);
-
-  // add the line to the hash
-  SHA256_Update(shaCtx, lineOut.c_str(), lineOut.length());
+    uint32_t nextSPID = _my_sps->peekNextSPID(EXODUS_PROPERTY_EXODUS);
+    uint32_t nextTestSPID = _my_sps->peekNextSPID(EXODUS_PROPERTY_TEXODUS);
 
-  // write the line
-  file << lineOut << endl;
-
-  return 0;
-}
-
-static int write_mp_crowdsales(std::ofstream& file, SHA256_CTX* shaCtx)
-{
-    for (CrowdMap::const_iterator it = my_crowds.begin(); it != my_crowds.end(); ++it) {
-        // decompose the key for address
-        const CMPCrowd& crowd = it->second;
-        crowd.saveCrowdSale(file, shaCtx, it->first);
-    }
-
-    return 0;
+    ssState << exodus_prev << nextSPID << nextTestSPID;
 }
 
+/**
+ * Writes one part of the state as of the given block into a binary state file.
+ *
+ * If the serialized state didn't change since the last checkpoint, the previous
+ * file is hard linked instead of being written again.
+ */
 static int write_state_file( CBlockIndex const *pBlockIndex, int what )
 {
-  boost::filesystem::path path = MPPersistencePath / strprintf("%s-%s.dat", statePrefix[what], pBlockIndex->GetBlockHash().ToString());
-  const std::string strFile = path.string();
-
-  std::ofstream file;
-  file.open(strFile.c_str());
-
-  SHA256_CTX shaCtx;
-  SHA256_Init(&shaCtx);
-
-  int result = 0;
+  CDataStream ssState(SER_DISK, CLIENT_VERSION);
 
   switch(what) {
   case FILETYPE_BALANCES:
-    result = write_exodus_balances(file, &shaCtx);
+    write_exodus_balances(ssState);
     break;
 
   case FILETYPE_OFFERS:
-    result = write_mp_offers(file, &shaCtx);
+    ssState << my_offers;
     break;
 
   case FILETYPE_ACCEPTS:
-    result = write_mp_accepts(file, &shaCtx);
+    ssState << my_accepts;
     break;
 
   case FILETYPE_GLOBALS:
-    result = write_globals_state(file, &shaCtx);
+    write_globals_state(ssState);
     break;
 
   case FILETYPE_CROWDSALES:
-      result = write_mp_crowdsales(file, &shaCtx);
-      break;
+    ssState << my_crowds;
+    break;
 
   case FILETYPE_MDEXORDERS:
-      result = write_mp_metadex(file, &shaCtx);
-      break;
+    write_mp_metadex(ssState);
+    break;
+
+  default:
+    return -1;
   }
 
-  // generate and wite the double hash of all the contents written
-  uint256 hash1;
-  SHA256_Final((unsigned char*)&hash1, &shaCtx);
-  uint256 hash2;
-  SHA256((unsigned char*)&hash1, sizeof(hash1), (unsigned char*)&hash2);
-  file << "!" << hash2.ToString() << endl;
+  const boost::filesystem::path path = get_state_file_path(what, pBlockIndex->GetBlockHash(), STATE_FILE_BINARY);
+  const uint256 hash = Hash(ssState.begin(), ssState.end());
 
-  file.flush();
-  file.close();
-  return result;
+  if (hash == lastStateHash[what] && !lastStateFile[what].empty() && lastStateFile[what] != path) {
+    boost::system::error_code ec;
+    boost::filesystem::create_hard_link(lastStateFile[what], path, ec);
+    if (!ec) {
+      lastStateFile[what] = path;
+      return 0;
+    }
+    if (exodus_debug_persistence) PrintToLog("%s(): failed to link %s: %s\n", __func__, path.string(), ec.message());
+  }
+
+  // never write in place: the file may be a hard link shared with older
+  // blocks, and a crash must not leave a torn file behind
+  const boost::filesystem::path pathTmp = path.string() + STATE_FILE_TMP_SUFFIX;
+  CAutoFile fileout(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+  if (fileout.IsNull()) {
+    PrintToLog("%s(): failed to open %s for writing\n", __func__, pathTmp.string());
+    return -1;
+  }
+
+  try {
+    fileout.write(&ssState.begin()[0], ssState.size());
+    fileout << hash;
+  } catch (const std::exception& e) {
+    PrintToLog("%s(): failed to write %s: %s\n", __func__, pathTmp.string(), e.what());
+    fileout.fclose();
+    boost::filesystem::remove(pathTmp);
+    lastStateFile[what].clear();
+    return -1;
+  }
+
+  FileCommit(fileout.Get());
+  fileout.fclose();
+
+  if (!RenameOver(pathTmp, path)) {
+    PrintToLog("%s(): failed to rename %s to %s\n", __func__, pathTmp.string(), path.string());
+    boost::filesystem::remove(pathTmp);
+    lastStateFile[what].clear();
+    return -1;
+  }
+
+  lastStateHash[what] = hash;
+  lastStateFile[what] = path;
+
+  return 0;
 }
 
 static bool is_state_prefix( std::string const &str )
@@ -2029,11 +2225,17 @@ static void prune_state_files( CBlockIndex const *topIndex )
       continue;
     }
 
+    // left over from a write that didn't complete
+    if (boost::ends_with(fName, STATE_FILE_TMP_SUFFIX)) {
+      boost::filesystem::remove(dIter->path());
+      continue;
+    }
+
     std::vector<std::string> vstr;
     boost::split(vstr, fName, boost::is_any_of("-."), token_compress_on);
     if (  vstr.size() == 3 &&
           is_state_prefix(vstr[0]) &&
-          boost::equals(vstr[2], "dat")) {
+          (boost::equals(vstr[2], STATE_FILE_BINARY) || boost::equals(vstr[2], STATE_FILE_TEXT))) {
       uint256 blockHash;
       blockHash.SetHex(vstr[1]);
       statefulBlockHashes.insert(blockHash);
@@ -2060,10 +2262,9 @@ static void prune_state_files( CBlockIndex const *topIndex )
      }
 
       // destroy the associated files!
-      std::string strBlockHash = iter->ToString();
       for (int i = 0; i < NUM_FILETYPES; ++i) {
-        boost::filesystem::path path = MPPersistencePath / strprintf("%s-%s.dat", statePrefix[i], strBlockHash);
-        boost::filesystem::remove(path);
+        boost::filesystem::remove(get_state_file_path(i, *iter, STATE_FILE_BINARY));
+        boost::filesystem::remove(get_state_file_path(i, *iter, STATE_FILE_TEXT));
       }
     }
   }
@@ -2096,6 +2297,7 @@ void clear_all_state()
 
     // Memory based storage
     mp_tally_map.clear();
+    ResetBalancesStateHash();
     my_offers.clear();
     my_accepts.clear();
     my_crowds.clear();
@@ -2116,6 +2318,7 @@ void clear_all_state()
     p_feehistory->Clear();
     assert(p_txlistdb->setDBVersion() == DB_VERSION); // new set of databases, set DB version
     exodus_prev = 0;
+    reset_state_file_cache();
 }
 
 /**
@@ -2350,6 +2553,7 @@ bool exodus_handler_tx(const CTransaction& tx, int nBlock, unsigned int idx, con
             p_txlistdb->recordTX(tx.GetHash(), bValid, nBlock, mp_obj.getType(), mp_obj.getNewAmount());
             p_ExodusTXDB->RecordTransaction(tx.GetHash(), idx, interp_ret);
         }
+        NotifyExodusTransaction(tx.GetHash(), pBlockIndex, idx, mp_obj.getType(), mp_obj.getVersion(), interp_ret);
         fFoundTx |= (interp_ret == 0);
     }
 
@@ -3912,6 +4116,21 @@ int exodus_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex,
         PrintToLog("Consensus hash for block %d: %s\n", nBlockNow, consensusHash.GetHex());
     }
 
+    // the state hash is maintained incrementally, and cheap enough for every block
+    if (ShouldStateHashBlock(nBlockNow)) {
+        uint256 stateHash = GetStateHash();
+        PrintToLog("State hash for block %d: %s\n", nBlockNow, stateHash.GetHex());
+
+        // checking it against a rebuild is not cheap, and only done on request
+        if (exodus_debug_consensus_hash && !VerifyBalancesStateHash()) {
+            const std::string& msg = strprintf("Shutting down due to a state hash mismatch at block %d, the maintained state hash is wrong\n", nBlockNow);
+            PrintToLog(msg);
+            if (!GetBoolArg("-overrideforcedshutdown", false)) {
+                AbortNode(msg, msg);
+            }
+        }
+    }
+
     // request checkpoint verification
     bool checkpointValid = VerifyCheckpoint(nBlockNow, pBlockIndex->GetBlockHash());
     if (!checkpointValid) {
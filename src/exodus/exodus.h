@@ -33,6 +33,9 @@ using std::string;
 
 int const MAX_STATE_HISTORY = 50;
 
+//! Default number of threads reading blocks ahead of the initial scan (0 = number of cores)
+int const DEFAULT_EXODUS_SCAN_THREADS = 0;
+
 #define TEST_ECO_PROPERTY_1 (0x80000003UL)
 
 // increment this value to force a refresh of the state (similar to --startclean)
@@ -66,6 +66,8 @@ bool exodus_debug_alerts             = 1;
 bool exodus_debug_consensus_hash_every_transaction = 0;
 //! Debug fees
 bool exodus_debug_fees               = 1;
+//! Print the incrementally maintained state hash for each block when parsing
+bool exodus_debug_state_hash_every_block = 0;
 
 /**
  * LogPrintf() has been broken a couple of times now
@@ -267,6 +269,7 @@ void InitDebugLogLevels()
         if (*it == "alerts") exodus_debug_alerts = true;
         if (*it == "consensus_hash_every_transaction") exodus_debug_consensus_hash_every_transaction = true;
         if (*it == "fees") exodus_debug_fees = true;
+        if (*it == "state_hash_every_block") exodus_debug_state_hash_every_block = true;
         if (*it == "none" || *it == "all") {
             bool allDebugState = false;
             if (*it == "all") allDebugState = true;
@@ -303,6 +306,7 @@ void InitDebugLogLevels()
             exodus_debug_alerts = allDebugState;
             exodus_debug_consensus_hash_every_transaction = allDebugState;
             exodus_debug_fees = allDebugState;
+            exodus_debug_state_hash_every_block = allDebugState;
         }
     }
 }
@@ -49,6 +49,7 @@ extern bool exodus_debug_consensus_hash_every_block;
 extern bool exodus_debug_alerts;
 extern bool exodus_debug_consensus_hash_every_transaction;
 extern bool exodus_debug_fees;
+extern bool exodus_debug_state_hash_every_block;
 
 /* When we switch to C++11, this can be switched to variadic templates instead
  * of this macro-based construction (see tinyformat.h).
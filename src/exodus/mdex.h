@@ -3,6 +3,7 @@
 
 #include "exodus/tx.h"
 
+#include "serialize.h"
 #include "uint256.h"
 
 #include <boost/lexical_cast.hpp>
@@ -89,6 +90,22 @@ public:
         desired_property(tx.desired_property), amount_desired(tx.desired_value), amount_remaining(tx.nValue),
         subaction(tx.subaction), addr(tx.sender) {}
 
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(block);
+        READWRITE(txid);
+        READWRITE(idx);
+        READWRITE(property);
+        READWRITE(amount_forsale);
+        READWRITE(desired_property);
+        READWRITE(amount_desired);
+        READWRITE(amount_remaining);
+        READWRITE(subaction);
+        READWRITE(addr);
+    }
+
     std::string ToString() const;
 
     rational_t unitPrice() const;
@@ -98,8 +115,6 @@ public:
     std::string displayUnitPrice() const;
     /** Used for display of unit prices with 50 decimal places at RPC layer. */
     std::string displayFullUnitPrice() const;
-
-    void saveOffer(std::ofstream& file, SHA256_CTX* shaCtx) const;
 };
 
 namespace exodus
@@ -2123,6 +2123,52 @@ UniValue exodus_getcurrentconsensushash(const UniValue& params, bool fHelp)
     return response;
 }
 
+UniValue exodus_getcurrentstatehash(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "exodus_getcurrentstatehash ( verify )\n"
+            "\nReturns the incrementally maintained, order independent hash of the state for the current block.\n"
+            "\nUnlike the consensus hash, it doesn't cover property issuers and is cheap to compute.\n"
+            "\nArguments:\n"
+            "1. verify                      (boolean, optional) rebuild the balances part from scratch first, and check it (default: false)\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"block\" : nnnnnn,          (number) the index of the block this state hash applies to\n"
+            "  \"blockhash\" : \"hash\",      (string) the hash of the corresponding block\n"
+            "  \"statehash\" : \"hash\",      (string) the state hash for the block\n"
+            "  \"verified\" : true|false    (boolean) whether the maintained hash matched the rebuilt one, only with verify\n"
+            "}\n"
+
+            "\nExamples:\n"
+            + HelpExampleCli("exodus_getcurrentstatehash", "")
+            + HelpExampleCli("exodus_getcurrentstatehash", "true")
+            + HelpExampleRpc("exodus_getcurrentstatehash", "true")
+        );
+
+    bool fVerify = params.size() > 0 && params[0].get_bool();
+
+    LOCK(cs_main);
+
+    int block = GetHeight();
+
+    CBlockIndex* pblockindex = chainActive[block];
+    uint256 blockHash = pblockindex->GetBlockHash();
+
+    // a mismatch is logged, the maintained hash is returned unchanged
+    bool fVerified = !fVerify || VerifyBalancesStateHash();
+    uint256 stateHash = GetStateHash();
+
+    UniValue response(UniValue::VOBJ);
+    response.push_back(Pair("block", block));
+    response.push_back(Pair("blockhash", blockHash.GetHex()));
+    response.push_back(Pair("statehash", stateHash.GetHex()));
+    if (fVerify)
+        response.push_back(Pair("verified", fVerified));
+
+    return response;
+}
+
 UniValue exodus_getmetadexhash(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -2231,6 +2277,7 @@ static const CRPCCommand commands[] =
     { "exodus (data retrieval)", "exodus_gettradehistoryforaddress", &exodus_gettradehistoryforaddress,  false },
     { "exodus (data retrieval)", "exodus_gettradehistoryforpair",    &exodus_gettradehistoryforpair,     false },
     { "exodus (data retrieval)", "exodus_getcurrentconsensushash",   &exodus_getcurrentconsensushash,    false },
+    { "exodus (data retrieval)", "exodus_getcurrentstatehash",       &exodus_getcurrentstatehash,        false },
     { "exodus (data retrieval)", "exodus_getpayload",                &exodus_getpayload,                 false },
     { "exodus (data retrieval)", "exodus_getseedblocks",             &exodus_getseedblocks,              false },
     { "exodus (data retrieval)", "exodus_getmetadexhash",            &exodus_getmetadexhash,             false },
@@ -51,11 +51,18 @@ private:
         uint256 hash = Hash(ssObj.begin(), ssObj.end());
         ssObj << hash;
 
-        // open output file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "wb");
+        // nothing changed since the last time, leave the file alone
+        if (ReadHash() == hash) {
+            LogPrintf("Unchanged info in %s  %dms\n", strFilename, GetTimeMillis() - nStart);
+            return true;
+        }
+
+        // open temp output file, and associate with CAutoFile
+        boost::filesystem::path pathTmp = GetDataDir() / (strFilename + ".new");
+        FILE *file = fopen(pathTmp.string().c_str(), "wb");
         CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
         if (fileout.IsNull())
-            return error("%s: Failed to open file %s", __func__, pathDB.string());
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
         // Write and commit header, data
         try {
@@ -64,14 +71,63 @@ private:
         catch (std::exception &e) {
             return error("%s: Serialize or I/O error - %s", __func__, e.what());
         }
+        FileCommit(fileout.Get());
         fileout.fclose();
 
+        // replace the old file only once the new one is complete, so a crash leaves one of them intact
+        if (!RenameOver(pathTmp, pathDB))
+            return error("%s: Rename-into-place failed", __func__);
+
         LogPrintf("Written info to %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToSave.ToString());
 
         return true;
     }
 
+    /** Returns the checksum at the end of the file, or null if there is none */
+    uint256 ReadHash()
+    {
+        uint256 hash;
+        FILE *file = fopen(pathDB.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return hash;
+
+        try {
+            if (fseek(filein.Get(), -(long)sizeof(uint256), SEEK_END) == 0)
+                filein >> hash;
+        }
+        catch (std::exception &e) {
+            hash.SetNull();
+        }
+        return hash;
+    }
+
+    /** Checks the magic message and network magic number at the start of the file only */
+    ReadResult ReadHeader()
+    {
+        FILE *file = fopen(pathDB.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return FileError;
+
+        unsigned char pchMsgTmp[4];
+        std::string strMagicMessageTmp;
+        try {
+            filein >> strMagicMessageTmp;
+            if (strMagicMessage != strMagicMessageTmp)
+                return IncorrectMagicMessage;
+
+            filein >> FLATDATA(pchMsgTmp);
+            if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+                return IncorrectMagicNumber;
+        }
+        catch (std::exception &e) {
+            return HashReadError;
+        }
+        return Ok;
+    }
+
     ReadResult Read(T& objToLoad, bool fDryRun = false)
     {
         //LOCK(objToLoad.cs);
@@ -198,8 +254,9 @@ public:
         int64_t nStart = GetTimeMillis();
 
         LogPrintf("Verifying %s format...\n", strFilename);
-        T tmpObjToLoad;
-        ReadResult readResult = Read(tmpObjToLoad, true);
+        // Only the header: Write() replaces the file in one go, so it can't be
+        // left half written, and reading all of it back took longer than the write
+        ReadResult readResult = ReadHeader();
 
         // there was an error and it was not an error on file opening => do not proceed
         if (readResult == FileError)
@@ -207,13 +264,8 @@ public:
         else if (readResult != Ok)
         {
             LogPrintf("Error reading %s: ", strFilename);
-            if(readResult == IncorrectFormat)
-                LogPrintf("%s: Magic is ok but data has invalid format, will try to recreate\n", __func__);
-            else
-            {
-                LogPrintf("%s: File format is unknown or invalid, please fix it manually\n", __func__);
-                return false;
-            }
+            LogPrintf("%s: File format is unknown or invalid, please fix it manually\n", __func__);
+            return false;
         }
 
         LogPrintf("Writting info to %s...\n", strFilename);
@@ -19,7 +19,7 @@
 using namespace std;
 using namespace sigma;
 
-CHDMintTracker::CHDMintTracker(std::string strWalletFile)
+CHDMintTracker::CHDMintTracker(std::string strWalletFile) : nChainHeight(-1)
 {
     this->strWalletFile = strWalletFile;
     mapSerialHashes.clear();
@@ -134,7 +134,7 @@ CAmount CHDMintTracker::GetBalance(bool fConfirmedOnly, bool fUnconfirmedOnly) c
             CMintMeta meta = it.second;
             if (meta.isUsed || meta.isArchived)
                 continue;
-            bool fConfirmed = ((meta.nHeight < chainActive.Height() - ZC_MINT_CONFIRMATIONS) && !(meta.nHeight == 0));
+            bool fConfirmed = ((meta.nHeight < nChainHeight - ZC_MINT_CONFIRMATIONS) && !(meta.nHeight == 0));
             if (fConfirmedOnly && !fConfirmed)
                 continue;
             if (fUnconfirmedOnly && fConfirmed)
@@ -163,7 +163,7 @@ std::list<CMintMeta> CHDMintTracker::GetMints(bool fConfirmedOnly, bool fInactiv
         CMintMeta mint = it.second;
         if ((mint.isArchived || mint.isUsed) && fInactive)
             continue;
-        bool fConfirmed = (mint.nHeight < chainActive.Height() - ZC_MINT_CONFIRMATIONS);
+        bool fConfirmed = (mint.nHeight < nChainHeight - ZC_MINT_CONFIRMATIONS);
         if (fConfirmedOnly && !fConfirmed)
             continue;
         vMints.push_back(mint);
@@ -343,19 +343,21 @@ void CHDMintTracker::RemovePending(const uint256& txid)
         mapPendingSpends.erase(hashSerial);
 }
 
-bool CHDMintTracker::IsMempoolSpendOurs(const std::set<uint256>& setMempool, const uint256& hashSerial){
-    // get transaction back from mempool
-    // if spend, get hash of serial
-    // if matches mint.hashSerial, mark pending spend.
-    for(auto& mempoolTxid : setMempool){
-        auto it = mempool.mapTx.find(mempoolTxid);
-        if (it == mempool.mapTx.end()){
-            it = stempool.mapTx.find(mempoolTxid);
-            if (it == stempool.mapTx.end())
-                continue;
-        }
+bool CHDMintTracker::IsMempoolSpendOurs(const uint256& hashSerial){
+    // Spends accepted to the mempool have their serials registered with the
+    // sigma state, so there is no need to parse every pending spend proof
+    CSigmaState *sigmaState = sigma::CSigmaState::GetState();
+    for (const auto& serial : sigmaState->GetMempoolCoinSerials()) {
+        if (primitives::GetSerialHash(serial.first) == hashSerial)
+            return true;
+    }
 
+    // Spends still in the Dandelion stem phase are only in the stempool
+    LOCK(stempool.cs);
+    for (auto it = stempool.mapTx.begin(); it != stempool.mapTx.end(); ++it) {
         const CTransaction &tx = it->GetTx();
+        if (!tx.IsSigmaSpend())
+            continue;
         for (const CTxIn& txin : tx.vin) {
             if (txin.IsSigmaSpend()) {
                 std::unique_ptr<sigma::CoinSpend> spend;
@@ -379,7 +381,7 @@ bool CHDMintTracker::IsMempoolSpendOurs(const std::set<uint256>& setMempool, con
     return false;
 }
 
-bool CHDMintTracker::UpdateMetaStatus(const std::set<uint256>& setMempool, CMintMeta& mint, bool fSpend)
+bool CHDMintTracker::UpdateMetaStatus(CMintMeta& mint, bool fSpend)
 {
     uint256 hashPubcoin = mint.GetPubCoinValueHash();
     //! Check whether this mint has been spent and is considered 'pending' or 'confirmed'
@@ -395,7 +397,7 @@ bool CHDMintTracker::UpdateMetaStatus(const std::set<uint256>& setMempool, CMint
 
     // Mempool might hold pending spend
     if(!isPendingSpend && fSpend)
-        isPendingSpend = IsMempoolSpendOurs(setMempool, mint.hashSerial);
+        isPendingSpend = IsMempoolSpendOurs(mint.hashSerial);
 
     LogPrintf("UpdateMetaStatus : isPendingSpend: %d\n", isPendingSpend);
 
@@ -427,7 +429,7 @@ bool CHDMintTracker::UpdateMetaStatus(const std::set<uint256>& setMempool, CMint
 
         LogPrintf("UpdateMetaStatus : mint.txid = %d\n", mint.txid.GetHex());
 
-        if (setMempool.count(mint.txid)) {
+        if (IsInMempool(mint.txid)) {
             if(mint.nHeight>-1) mint.nHeight = -1;
             if(mint.nId>-1) mint.nId = -1;
             return true;
@@ -492,7 +494,6 @@ void CHDMintTracker::UpdateMintStateFromBlock(const std::vector<sigma::PublicCoi
     uint160 hashSeedMasterEntry;
     CKeyID seedId;
     int32_t nCount;
-    std::set<uint256> setMempool = GetMempoolTxids();
     for (auto& mint : mints) {
         uint256 hashPubcoin = primitives::GetPubCoinValueHash(mint.getValue());
         CMintMeta meta;
@@ -504,7 +505,7 @@ void CHDMintTracker::UpdateMintStateFromBlock(const std::vector<sigma::PublicCoi
                 mintPoolEntries.push_back(std::make_pair(hashPubcoin, mintPoolEntry));
                 continue;
             }
-            if(UpdateMetaStatus(setMempool, meta)){
+            if(UpdateMetaStatus(meta)){
                 updatedMeta.emplace_back(meta);
             }
         }
@@ -520,7 +521,6 @@ void CHDMintTracker::UpdateSpendStateFromBlock(const sigma::spend_info_container
     uint160 hashSeedMasterEntry;
     CKeyID seedId;
     int32_t nCount;
-    std::set<uint256> setMempool = GetMempoolTxids();
     for(auto& spentSerial : spentSerials){
         uint256 spentSerialHash = primitives::GetSerialHash(spentSerial.first);
         CMintMeta meta;
@@ -537,7 +537,7 @@ void CHDMintTracker::UpdateSpendStateFromBlock(const sigma::spend_info_container
                 mintPoolEntries.push_back(std::make_pair(hashPubcoin, mintPoolEntry));
                 continue;
             }
-            if(UpdateMetaStatus(setMempool, meta, true)){
+            if(UpdateMetaStatus(meta, true)){
                 updatedMeta.emplace_back(meta);
             }
         }
@@ -553,7 +553,6 @@ void CHDMintTracker::UpdateMintStateFromMempool(const std::vector<GroupElement>&
     uint160 hashSeedMasterEntry;
     CKeyID seedId;
     int32_t nCount;
-    std::set<uint256> setMempool = GetMempoolTxids();
     for (auto& pubcoin : pubCoins) {
         uint256 hashPubcoin = primitives::GetPubCoinValueHash(pubcoin);
 
@@ -568,7 +567,7 @@ void CHDMintTracker::UpdateMintStateFromMempool(const std::vector<GroupElement>&
             }
             CMintMeta meta;
             GetMetaFromPubcoin(hashPubcoin, meta);
-            if(UpdateMetaStatus(setMempool, meta)){
+            if(UpdateMetaStatus(meta)){
                 updatedMeta.emplace_back(meta);
             }
         }
@@ -584,7 +583,6 @@ void CHDMintTracker::UpdateSpendStateFromMempool(const vector<Scalar>& spentSeri
     uint160 hashSeedMasterEntry;
     CKeyID seedId;
     int32_t nCount;
-    std::set<uint256> setMempool = GetMempoolTxids();
     for(auto& spentSerial : spentSerials){
         uint256 spentSerialHash = primitives::GetSerialHash(spentSerial);
         CMintMeta meta;
@@ -601,7 +599,7 @@ void CHDMintTracker::UpdateSpendStateFromMempool(const vector<Scalar>& spentSeri
                 mintPoolEntries.push_back(std::make_pair(hashPubcoin, mintPoolEntry));
                 continue;
             }
-            if(UpdateMetaStatus(setMempool, meta, true)){
+            if(UpdateMetaStatus(meta, true)){
                 updatedMeta.emplace_back(meta);
             }
         }
@@ -624,9 +622,21 @@ list<CSigmaEntry> CHDMintTracker::MintsAsZerocoinEntries(bool fUnusedOnly, bool
 }
 
 std::vector<CMintMeta> CHDMintTracker::ListMints(bool fUnusedOnly, bool fMatureOnly, bool fUpdateStatus, bool fLoad, bool fWrongSeed)
+{
+    // Listing the cached metadata only needs the wallet lock, cs_main is
+    // only required to refresh it against the chain and the mempool
+    if (fUpdateStatus || fLoad) {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        UpdateChainHeight();
+        return ListMintsLocked(fUnusedOnly, fMatureOnly, fUpdateStatus, fLoad, fWrongSeed);
+    }
+    LOCK(pwalletMain->cs_wallet);
+    return ListMintsLocked(fUnusedOnly, fMatureOnly, fUpdateStatus, fLoad, fWrongSeed);
+}
+
+std::vector<CMintMeta> CHDMintTracker::ListMintsLocked(bool fUnusedOnly, bool fMatureOnly, bool fUpdateStatus, bool fLoad, bool fWrongSeed)
 {
     std::vector<CMintMeta> setMints;
-    LOCK2(cs_main, pwalletMain->cs_wallet);
     CWalletDB walletdb(strWalletFile);
     if (fLoad) {
         std::list<CSigmaEntry> listMintsDB;
@@ -643,8 +653,8 @@ std::vector<CMintMeta> CHDMintTracker::ListMints(bool fUnusedOnly, bool fMatureO
         LogPrint("zero", "%s: added %d hdmint from DB\n", __func__, listDeterministicDB.size());
     }
 
+    const int nHeight = nChainHeight;
     std::vector<CMintMeta> vOverWrite;
-    std::set<uint256> setMempool = GetMempoolTxids();
     for (auto& it : mapSerialHashes) {
         CMintMeta mint = it.second;
 
@@ -654,7 +664,7 @@ std::vector<CMintMeta> CHDMintTracker::ListMints(bool fUnusedOnly, bool fMatureO
 
         // Update the metadata of the mints if requested
         if (fUpdateStatus){
-            if(UpdateMetaStatus(setMempool, mint)) {
+            if(UpdateMetaStatus(mint)) {
                 if (mint.isArchived)
                     continue;
 
@@ -668,7 +678,7 @@ std::vector<CMintMeta> CHDMintTracker::ListMints(bool fUnusedOnly, bool fMatureO
 
         if (fMatureOnly) {
             // Not confirmed
-            if (!mint.nHeight || !(mint.nHeight + (ZC_MINT_CONFIRMATIONS-1) <= chainActive.Height()))
+            if (!mint.nHeight || !(mint.nHeight + (ZC_MINT_CONFIRMATIONS-1) <= nHeight))
                 continue;
         }
 
@@ -685,15 +695,14 @@ std::vector<CMintMeta> CHDMintTracker::ListMints(bool fUnusedOnly, bool fMatureO
     return setMints;
 }
 
-std::set<uint256> CHDMintTracker::GetMempoolTxids(){
-    std::set<uint256> setMempool;
-    setMempool.clear();
-    {
-        LOCK(mempool.cs);
-        mempool.getTransactions(setMempool);
-        stempool.getTransactions(setMempool);
-    }
-    return setMempool;
+void CHDMintTracker::UpdateChainHeight()
+{
+    AssertLockHeld(cs_main);
+    nChainHeight = chainActive.Height();
+}
+
+bool CHDMintTracker::IsInMempool(const uint256& txid){
+    return mempool.exists(txid) || stempool.exists(txid);
 }
 
 void CHDMintTracker::Clear()
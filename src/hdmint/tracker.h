@@ -7,6 +7,7 @@
 
 #include "primitives/zerocoin.h"
 #include "hdmint/mintpool.h"
+#include <atomic>
 #include <list>
 
 class CHDMint;
@@ -19,9 +20,12 @@ private:
     std::string strWalletFile;
     std::map<uint256, CMintMeta> mapSerialHashes;
     std::map<uint256, uint256> mapPendingSpends; //serialhash, txid of spend
-    bool IsMempoolSpendOurs(const std::set<uint256>& setMempool, const uint256& hashSerial);
-    bool UpdateMetaStatus(const std::set<uint256>& setMempool, CMintMeta& mint, bool fSpend=false);
-    std::set<uint256> GetMempoolTxids();
+    //! Height of the active chain as of the last wallet event, so mint maturity can be judged without cs_main
+    std::atomic<int> nChainHeight;
+    bool IsMempoolSpendOurs(const uint256& hashSerial);
+    bool UpdateMetaStatus(CMintMeta& mint, bool fSpend=false);
+    bool IsInMempool(const uint256& txid);
+    std::vector<CMintMeta> ListMintsLocked(bool fUnusedOnly, bool fMatureOnly, bool fUpdateStatus, bool fLoad, bool fWrongSeed);
 public:
     CHDMintTracker(std::string strWalletFile);
     ~CHDMintTracker();
@@ -52,6 +56,8 @@ public:
     bool UnArchive(const uint256& hashPubcoin, bool isDeterministic);
     bool UpdateState(const CMintMeta& meta);
     void Clear();
+    //! Take a snapshot of the active chain height. Requires cs_main.
+    void UpdateChainHeight();
 };
 
 #endif //GRAVITYCOIN_HDMINTTRACKER_H
@@ -14,6 +14,7 @@
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
 #include "keystore.h"
+#include "libzerocoin/ParallelTasks.h"
 #include <boost/optional.hpp>
 
 CHDMintWallet::CHDMintWallet(const std::string& strWalletFile) : tracker(strWalletFile)
@@ -89,8 +90,8 @@ std::pair<uint256,uint256> CHDMintWallet::RegenerateMintPoolEntry(const uint160&
 
     MintPoolEntry mintPoolEntry(mintHashSeedMaster, seedId, nCount);
     mintPool.Add(make_pair(hashPubcoin, mintPoolEntry));
-    CWalletDB(strWalletFile).WritePubcoin(hashSerial, commitmentValue);
-    CWalletDB(strWalletFile).WriteMintPoolPair(hashPubcoin, mintPoolEntry);
+    walletdb.WritePubcoin(hashSerial, commitmentValue);
+    walletdb.WriteMintPoolPair(hashPubcoin, mintPoolEntry);
     LogPrintf("%s : hashSeedMaster=%s hashPubcoin=%s seedId=%s\n count=%d\n", __func__, hashSeedMaster.GetHex(), hashPubcoin.GetHex(), seedId.GetHex(), nCount);
 
     nIndexes.first = hashPubcoin;
@@ -100,10 +101,23 @@ std::pair<uint256,uint256> CHDMintWallet::RegenerateMintPoolEntry(const uint160&
 
 }
 
-// Add up to nIndex + 20 new mints to the mint pool (defaults to adding 20 mints if no param passed)
+namespace {
+
+// Mint pool entry being generated, filled in by GenerateMintPool
+struct MintPoolSeed {
+    int32_t nCount;
+    CKeyID seedId;
+    uint512 seedZerocoin;
+    GroupElement commitmentValue;
+    uint256 hashSerial;
+    bool fValid;
+};
+
+}
+
+// Add up to nIndex + -mintpoolsize new mints to the mint pool (defaults to adding -mintpoolsize mints if no param passed)
 void CHDMintWallet::GenerateMintPool(int32_t nIndex)
 {
-    CWalletDB walletdb(strWalletFile);
     //Is locked
     if (pwalletMain->IsLocked())
         return;
@@ -113,38 +127,66 @@ void CHDMintWallet::GenerateMintPool(int32_t nIndex)
         return;
     }
 
+    int32_t nPoolSize = std::max(GetArg("-mintpoolsize", DEFAULT_MINTPOOL_SIZE), (int64_t) 1);
     int32_t nLastCount = nCountNextGenerate;
-    int32_t nStop = nLastCount + 20;
+    int32_t nStop = nLastCount + nPoolSize;
     if(nIndex > 0 && nIndex >= nLastCount)
-        nStop = nIndex + 20;
+        nStop = nIndex + nPoolSize;
     LogPrintf("%s : nLastCount=%d nStop=%d\n", __func__, nLastCount, nStop - 1);
+
+    // Seeds come from the HD chain and have to be derived in order, but that is cheap.
+    std::vector<MintPoolSeed> seeds;
+    seeds.reserve(nStop - nLastCount + 1);
     for (; nLastCount <= nStop; ++nLastCount) {
         if (ShutdownRequested())
             return;
 
-        CKeyID seedId;
-        uint512 seedZerocoin;
-        if(!CreateZerocoinSeed(seedZerocoin, nLastCount, seedId))
-            continue;
+        MintPoolSeed seed;
+        seed.nCount = nLastCount;
+        seed.fValid = CreateZerocoinSeed(seed.seedZerocoin, nLastCount, seed.seedId);
+        seeds.push_back(seed);
+    }
+
+    // Turning the seeds into coins is what takes the time, spread it across all the cores
+    const sigma::Params *params = sigma::Params::get_default();
+    int nThreads = std::max(std::min((int)boost::thread::hardware_concurrency(), (int)seeds.size()), 1);
+    libzerocoin::ParallelTasks tasks(nThreads);
+    for (int nThread = 0; nThread < nThreads; nThread++) {
+        tasks.Add([this, params, &seeds, nThread, nThreads]() {
+            for (size_t i = nThread; i < seeds.size(); i += nThreads) {
+                MintPoolSeed &seed = seeds[i];
+                if (!seed.fValid)
+                    continue;
+
+                sigma::PrivateCoin coin(params, sigma::CoinDenomination::SIGMA_DENOM_X1);
+                seed.fValid = SeedToZerocoin(seed.seedZerocoin, seed.commitmentValue, coin);
+                if (seed.fValid)
+                    seed.hashSerial = primitives::GetSerialHash(coin.getSerialNumber());
+            }
+        });
+    }
+    tasks.Wait();
 
-        GroupElement commitmentValue;
-        sigma::PrivateCoin coin(sigma::Params::get_default(), sigma::CoinDenomination::SIGMA_DENOM_X1);
-        if(!SeedToZerocoin(seedZerocoin, commitmentValue, coin))
+    // Write the whole batch in a single transaction
+    CWalletDB walletdb(strWalletFile);
+    walletdb.TxnBegin();
+    for (const MintPoolSeed &seed : seeds) {
+        if (!seed.fValid)
             continue;
 
-        uint256 hashPubcoin = primitives::GetPubCoinValueHash(commitmentValue);
+        uint256 hashPubcoin = primitives::GetPubCoinValueHash(seed.commitmentValue);
 
-        MintPoolEntry mintPoolEntry(hashSeedMaster, seedId, nLastCount);
+        MintPoolEntry mintPoolEntry(hashSeedMaster, seed.seedId, seed.nCount);
         mintPool.Add(make_pair(hashPubcoin, mintPoolEntry));
-        CWalletDB(strWalletFile).WritePubcoin(primitives::GetSerialHash(coin.getSerialNumber()), commitmentValue);
-        CWalletDB(strWalletFile).WriteMintPoolPair(hashPubcoin, mintPoolEntry);
-        LogPrintf("%s : hashSeedMaster=%s hashPubcoin=%s seedId=%d count=%d\n", __func__, hashSeedMaster.GetHex(), hashPubcoin.GetHex(), seedId.GetHex(), nLastCount);
+        walletdb.WritePubcoin(seed.hashSerial, seed.commitmentValue);
+        walletdb.WriteMintPoolPair(hashPubcoin, mintPoolEntry);
+        LogPrintf("%s : hashSeedMaster=%s hashPubcoin=%s seedId=%d count=%d\n", __func__, hashSeedMaster.GetHex(), hashPubcoin.GetHex(), seed.seedId.GetHex(), seed.nCount);
     }
 
     // Update local + DB entries for count last generated
     nCountNextGenerate = nLastCount;
     walletdb.WriteZerocoinSeedCount(nCountNextGenerate);
-
+    walletdb.TxnCommit();
 }
 
 bool CHDMintWallet::LoadMintPoolFromDB()
@@ -178,20 +220,36 @@ bool CHDMintWallet::GetSerialForPubcoin(const std::vector<std::pair<uint256, Gro
 void CHDMintWallet::SyncWithChain(bool fGenerateMintPool, boost::optional<std::list<std::pair<uint256, MintPoolEntry>>> listMints)
 {
     bool found = true;
+    bool fListMintPool = (listMints == boost::none);
     CWalletDB walletdb(strWalletFile);
 
     set<uint256> setAddedTx;
+    std::set<uint256> setChecked;
     while (found) {
         found = false;
         if (fGenerateMintPool)
             GenerateMintPool();
         LogPrintf("%s: Mintpool size=%d\n", __func__, mintPool.size());
 
-        std::set<uint256> setChecked;
-        if(listMints==boost::none){
+        // Pick up the entries generated while catching up in the previous round
+        if(fListMintPool){
             listMints = list<pair<uint256, MintPoolEntry>>();
             mintPool.List(listMints.get());
         }
+
+        // Look up all the unknown entries on chain at once rather than walking every minted coin for each of them
+        std::set<uint256> setHashPubcoin;
+        for (const pair<uint256, MintPoolEntry>& pMint : listMints.get()) {
+            if (!setChecked.count(pMint.first) && !tracker.HasPubcoinHash(pMint.first))
+                setHashPubcoin.insert(pMint.first);
+        }
+        std::map<uint256, std::pair<sigma::PublicCoin, sigma::CMintedCoinInfo>> mapMinted;
+        sigma::CSigmaState::GetState()->GetCoinsByHash(setHashPubcoin, mapMinted);
+
+        // Consecutive mints usually share a block, so keep the last one read around
+        CBlock block;
+        CBlockIndex* pindexBlock = nullptr;
+
         for (pair<uint256, MintPoolEntry>& pMint : listMints.get()) {
             if (setChecked.count(pMint.first))
                 continue;
@@ -207,77 +265,57 @@ void CHDMintWallet::SyncWithChain(bool fGenerateMintPool, boost::optional<std::l
             if (tracker.HasPubcoinHash(pMint.first))
                 continue;
 
-            COutPoint outPoint;
-            if (sigma::GetOutPoint(outPoint, pMint.first)) {
-                const uint256& txHash = outPoint.hash;
-                //this mint has already occurred on the chain, increment counter's state to reflect this
-                LogPrintf("%s : Found wallet coin mint=%s count=%d tx=%s\n", __func__, pMint.first.GetHex(), mintCount, txHash.GetHex());
-                found = true;
-
-                uint256 hashBlock;
-                CTransaction tx;
-                if (!GetTransaction(txHash, tx, Params().GetConsensus(), hashBlock, true)) {
-                    LogPrintf("%s : failed to get transaction for mint %s!\n", __func__, pMint.first.GetHex());
-                    found = false;
-                    continue;
-                }
+            auto itMinted = mapMinted.find(pMint.first);
+            if (itMinted == mapMinted.end())
+                continue;
 
-                //Find the denomination
-                boost::optional<sigma::CoinDenomination> denomination = boost::none;
-                bool fFoundMint = false;
-                GroupElement bnValue;
-                for (const CTxOut& out : tx.vout) {
-                    if (!out.scriptPubKey.IsSigmaMint())
-                        continue;
+            const sigma::PublicCoin& pubcoin = itMinted->second.first;
+            CBlockIndex* pindex = chainActive[itMinted->second.second.nHeight];
+            if (!pindex)
+                continue;
 
-                    sigma::PublicCoin pubcoin;
-                    CValidationState state;
-                    if (!TxOutToPublicCoin(out, pubcoin, state)) {
-                        LogPrintf("%s : failed to get mint from txout for %s!\n", __func__, pMint.first.GetHex());
-                        continue;
-                    }
-
-                    // See if this is the mint that we are looking for
-                    uint256 hashPubcoin = primitives::GetPubCoinValueHash(pubcoin.getValue());
-                    if (pMint.first == hashPubcoin) {
-                        denomination = pubcoin.getDenomination();
-                        bnValue = pubcoin.getValue();
-                        fFoundMint = true;
-                        break;
-                    }
+            if (pindex != pindexBlock) {
+                pindexBlock = nullptr;
+                if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+                    LogPrintf("%s : failed to read block %s for mint %s!\n", __func__, pindex->GetBlockHash().GetHex(), pMint.first.GetHex());
+                    continue;
                 }
+                pindexBlock = pindex;
+            }
 
-                if (!fFoundMint || denomination == boost::none) {
-                    LogPrintf("%s : failed to get mint %s from tx %s!\n", __func__, pMint.first.GetHex(), tx.GetHash().GetHex());
-                    found = false;
-                    break;
-                }
+            COutPoint outPoint;
+            if (!sigma::GetOutPointFromBlock(outPoint, pubcoin.getValue(), block))
+                continue;
+
+            const uint256& txHash = outPoint.hash;
+            //this mint has already occurred on the chain, increment counter's state to reflect this
+            LogPrintf("%s : Found wallet coin mint=%s count=%d tx=%s\n", __func__, pMint.first.GetHex(), mintCount, txHash.GetHex());
+            found = true;
 
-                CBlockIndex* pindex = nullptr;
-                if (mapBlockIndex.count(hashBlock))
-                    pindex = mapBlockIndex.at(hashBlock);
+            if (!setAddedTx.count(txHash)) {
+                for (const CTransaction& tx : block.vtx) {
+                    if (tx.GetHash() != txHash)
+                        continue;
 
-                if (!setAddedTx.count(txHash)) {
-                    CBlock block;
                     CWalletTx wtx(pwalletMain, tx);
-                    if (pindex && ReadBlockFromDisk(block, pindex, Params().GetConsensus()))
-                        wtx.SetMerkleBranch(block);
+                    wtx.SetMerkleBranch(block);
 
                     //Fill out wtx so that a transaction record can be created
                     wtx.nTimeReceived = pindex->GetBlockTime();
                     pwalletMain->AddToWallet(wtx, false, &walletdb);
                     setAddedTx.insert(txHash);
+                    break;
                 }
+            }
 
-                if(!SetMintSeedSeen(pMint, pindex->nHeight, txHash, denomination.get()))
-                    continue;
+            if(!SetMintSeedSeen(pMint, pindex->nHeight, txHash, pubcoin.getDenomination()))
+                continue;
 
-                // Only update if the current hashSeedMaster matches the mints'
-                if(hashSeedMaster == mintHashSeedMaster && mintCount >= GetCount()){
-                    SetCount(++mintCount);
-                    UpdateCountDB();
-                    LogPrint("zero", "%s: updated count to %d\n", __func__, nCountNextUse);
-                }
+            // Only update if the current hashSeedMaster matches the mints'
+            if(hashSeedMaster == mintHashSeedMaster && mintCount >= GetCount()){
+                SetCount(++mintCount);
+                UpdateCountDB();
+                LogPrint("zero", "%s: updated count to %d\n", __func__, nCountNextUse);
             }
         }
     }
@@ -26,6 +26,9 @@
 /** Sanitize UTF-8 encoded strings in RPC responses */
 static bool fSanitizeResponse = true;
 
+/** Largest request body that is looked into to pick a work queue */
+static const size_t MAX_QUEUE_SELECT_BODY_SIZE = 4096;
+
 /** WWW-Authenticate to present with 401 Unauthorized response */
 static const char* WWW_AUTH_HEADER_DATA = "Basic realm=\"jsonrpc\"";
 
@@ -149,6 +152,63 @@ static bool RPCAuthorized(const std::string& strAuth)
     return multiUserAuthorized(strUserPass);
 }
 
+/**
+ * Sends the result of an RPC call that streams it as a chunked reply. The
+ * JSON-RPC envelope is written around the chunks of the result, so the reply
+ * matches what JSONRPCReply would have produced.
+ */
+class HTTPRPCStreamedReply
+{
+private:
+    HTTPRequest* req;
+    const UniValue& id;
+    bool fStarted;
+
+public:
+    HTTPRPCStreamedReply(HTTPRequest* reqIn, const UniValue& idIn) : req(reqIn), id(idIn), fStarted(false) {}
+
+    bool IsStarted() const { return fStarted; }
+
+    void operator()(const std::string& strChunk)
+    {
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->StartChunkedReply(HTTP_OK);
+            req->WriteReplyChunk("{\"result\":");
+            fStarted = true;
+        }
+        // Chunks end between two values, so they can be sanitized separately
+        req->WriteReplyChunk(fSanitizeResponse ? exodus::SanitizeInvalidUTF8(strChunk) : strChunk);
+    }
+
+    void End()
+    {
+        req->WriteReplyChunk(",\"error\":null,\"id\":" + id.write() + "}\n");
+        req->EndChunkedReply();
+    }
+};
+
+/**
+ * Sends single read-only chain queries to their own work queue, and the ones
+ * scanning an index to another one. Batches, large bodies and anything
+ * unparsable stay on the general queue; the handler deals with them as before.
+ */
+static HTTPWorkQueueKind HTTPReq_JSONRPC_Queue(HTTPRequest* req, const std::string &)
+{
+    std::string strBody;
+    if (req->GetRequestMethod() != HTTPRequest::POST || !req->PeekBody(strBody, MAX_QUEUE_SELECT_BODY_SIZE))
+        return HTTP_QUEUE_GENERAL;
+    UniValue valRequest;
+    if (!valRequest.read(strBody) || !valRequest.isObject())
+        return HTTP_QUEUE_GENERAL;
+    const UniValue& valMethod = find_value(valRequest.get_obj(), "method");
+    if (!valMethod.isStr() || !tableRPC.IsChainQuery(valMethod.get_str()))
+        return HTTP_QUEUE_GENERAL;
+    if (tableRPC.IsIndexQuery(valMethod.get_str()))
+        return HTTP_QUEUE_INDEX;
+    return HTTP_QUEUE_CHAIN;
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -178,6 +238,7 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     }
 
     JSONRequest jreq;
+    HTTPRPCStreamedReply streamedReply(req, jreq.id);
     try {
         // Parse request
         UniValue valRequest;
@@ -189,7 +250,17 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
-            UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
+            // Handlers with large results may stream them instead of returning them
+            JSONWriter::Sink sink = boost::ref(streamedReply);
+            UniValue result;
+            {
+                RPCResultSinkScope sinkScope(sink);
+                result = tableRPC.execute(jreq.strMethod, jreq.params);
+            }
+            if (streamedReply.IsStarted()) {
+                streamedReply.End();
+                return true;
+            }
 
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
@@ -206,9 +277,20 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
+        if (streamedReply.IsStarted()) {
+            // Too late for an error reply, cut the result off so the client can't mistake it for a complete one
+            LogPrintf("%s: %s failed while streaming its result: %s\n", __func__, jreq.strMethod, objError.write());
+            req->AbortChunkedReply();
+            return false;
+        }
         JSONErrorReply(req, objError, jreq.id);
         return false;
     } catch (const std::exception& e) {
+        if (streamedReply.IsStarted()) {
+            LogPrintf("%s: %s failed while streaming its result: %s\n", __func__, jreq.strMethod, e.what());
+            req->AbortChunkedReply();
+            return false;
+        }
         JSONErrorReply(req, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
         return false;
     }
@@ -242,7 +324,7 @@ bool StartHTTPRPC()
     // Sanitize non-UTF8 compliant RPC responses
     fSanitizeResponse = GetBoolArg("-rpcforceutf8", true);
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, HTTPReq_JSONRPC_Queue);
 
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
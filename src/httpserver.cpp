@@ -16,6 +16,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <limits>
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <signal.h>
@@ -24,6 +26,7 @@
 #include <event2/http.h>
 #include <event2/thread.h>
 #include <event2/buffer.h>
+#include <event2/bufferevent.h>
 #include <event2/util.h>
 #include <event2/keyvalq_struct.h>
 
@@ -40,6 +43,9 @@
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
+/** Maximum size of chunked reply data waiting to be sent, before the writer waits for the client */
+static const size_t MAX_REPLY_CHUNK_BUFFER = 4 * 1024 * 1024;
+
 /** HTTP request work item */
 class HTTPWorkItem : public HTTPClosure
 {
@@ -70,11 +76,19 @@ private:
     /** Mutex protects entire object */
     CWaitableCriticalSection cs;
     CConditionVariable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    //! Work items with the time they were enqueued at
+    std::deque<std::pair<int64_t, std::unique_ptr<WorkItem>>> queue;
     bool running;
     size_t maxDepth;
     int numThreads;
 
+    //! Counters reported by GetStats
+    uint64_t nProcessed;
+    uint64_t nRejected;
+    int64_t nTotalWaitMicros;
+    int64_t nTotalExecMicros;
+    int64_t nMaxWaitMicros;
+
     /** RAII object to keep track of number of running worker threads */
     class ThreadCounter
     {
@@ -96,7 +110,12 @@ private:
 public:
     WorkQueue(size_t maxDepth) : running(true),
                                  maxDepth(maxDepth),
-                                 numThreads(0)
+                                 numThreads(0),
+                                 nProcessed(0),
+                                 nRejected(0),
+                                 nTotalWaitMicros(0),
+                                 nTotalExecMicros(0),
+                                 nMaxWaitMicros(0)
     {
     }
     /** Precondition: worker threads have all stopped
@@ -110,9 +129,10 @@ public:
     {
         boost::unique_lock<boost::mutex> lock(cs);
         if (queue.size() >= maxDepth) {
+            nRejected++;
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        queue.emplace_back(GetTimeMicros(), std::unique_ptr<WorkItem>(item));
         cond.notify_one();
         return true;
     }
@@ -122,16 +142,27 @@ public:
         ThreadCounter count(*this);
         while (running) {
             std::unique_ptr<WorkItem> i;
+            int64_t nWait;
             {
                 boost::unique_lock<boost::mutex> lock(cs);
                 while (running && queue.empty())
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
+                nWait = GetTimeMicros() - queue.front().first;
+                i = std::move(queue.front().second);
                 queue.pop_front();
             }
+            int64_t nStart = GetTimeMicros();
             (*i)();
+            int64_t nExec = GetTimeMicros() - nStart;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                nProcessed++;
+                nTotalWaitMicros += nWait;
+                nTotalExecMicros += nExec;
+                nMaxWaitMicros = std::max(nMaxWaitMicros, nWait);
+            }
         }
     }
     /** Interrupt and exit loops */
@@ -155,18 +186,33 @@ public:
         boost::unique_lock<boost::mutex> lock(cs);
         return queue.size();
     }
+
+    /** Fill in the depth and latency figures of stats */
+    void GetStats(HTTPWorkQueueStats& stats)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        stats.nDepth = queue.size();
+        stats.nMaxDepth = maxDepth;
+        stats.nThreads = numThreads;
+        stats.nProcessed = nProcessed;
+        stats.nRejected = nRejected;
+        stats.nTotalWaitMicros = nTotalWaitMicros;
+        stats.nTotalExecMicros = nTotalExecMicros;
+        stats.nMaxWaitMicros = nMaxWaitMicros;
+    }
 };
 
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string prefix, bool exactMatch, HTTPRequestHandler handler):
-        prefix(prefix), exactMatch(exactMatch), handler(handler)
+    HTTPPathHandler(std::string prefix, bool exactMatch, HTTPRequestHandler handler, HTTPQueueSelector selector):
+        prefix(prefix), exactMatch(exactMatch), handler(handler), selector(selector)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPQueueSelector selector;
 };
 
 /** HTTP module state */
@@ -177,8 +223,10 @@ static struct event_base* eventBase = 0;
 struct evhttp* eventHTTP = 0;
 //! List of subnets to allow RPC connections from
 static std::vector<CSubNet> rpc_allow_subnets;
-//! Work queue for handling longer requests off the event loop thread
-static WorkQueue<HTTPClosure>* workQueue = 0;
+//! Work queues for handling longer requests off the event loop thread, by HTTPWorkQueueKind
+static WorkQueue<HTTPClosure>* workQueues[HTTP_QUEUE_COUNT] = {};
+//! Names of the work queues, for logging and metrics
+static const char* const workQueueNames[HTTP_QUEUE_COUNT] = {"general", "chain", "index"};
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
@@ -281,12 +329,14 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
+        HTTPWorkQueueKind kind = i->selector ? i->selector(hreq.get(), path) : HTTP_QUEUE_GENERAL;
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
+        WorkQueue<HTTPClosure>* workQueue = workQueues[kind];
         assert(workQueue);
         if (workQueue->Enqueue(item.get()))
             item.release(); /* if true, queue took ownership */
         else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: request rejected because http %s work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n", workQueueNames[kind]);
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -351,9 +401,9 @@ static bool HTTPBindAddresses(struct evhttp* http)
 }
 
 /** Simple wrapper to set thread name and run work queue */
-static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue)
+static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue, const std::string& name)
 {
-    RenameThread("bitcoin-httpworker");
+    RenameThread(name.c_str());
     queue->Run();
 }
 
@@ -429,9 +479,10 @@ bool InitHTTPServer()
 
     LogPrint("http", "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
-    LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
+    LogPrintf("HTTP: creating work queues of depth %d\n", workQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    for (int kind = 0; kind < HTTP_QUEUE_COUNT; kind++)
+        workQueues[kind] = new WorkQueue<HTTPClosure>(workQueueDepth);
     eventBase = base;
     eventHTTP = http;
     return true;
@@ -443,11 +494,17 @@ bool StartHTTPServer()
 {
     LogPrint("http", "Starting HTTP server\n");
     int rpcThreads = std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
-    LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
+    int rpcChainThreads = std::max((long)GetArg("-rpcchainthreads", DEFAULT_HTTP_CHAIN_THREADS), 1L);
+    int rpcIndexThreads = std::max((long)GetArg("-rpcindexthreads", DEFAULT_HTTP_INDEX_THREADS), 1L);
+    LogPrintf("HTTP: starting %d worker threads, %d chain query threads and %d index query threads\n", rpcThreads, rpcChainThreads, rpcIndexThreads);
     threadHTTP = boost::thread(boost::bind(&ThreadHTTP, eventBase, eventHTTP));
 
     for (int i = 0; i < rpcThreads; i++)
-        boost::thread(boost::bind(&HTTPWorkQueueRun, workQueue));
+        boost::thread(boost::bind(&HTTPWorkQueueRun, workQueues[HTTP_QUEUE_GENERAL], std::string("bitcoin-httpworker")));
+    for (int i = 0; i < rpcChainThreads; i++)
+        boost::thread(boost::bind(&HTTPWorkQueueRun, workQueues[HTTP_QUEUE_CHAIN], std::string("bitcoin-httpchain")));
+    for (int i = 0; i < rpcIndexThreads; i++)
+        boost::thread(boost::bind(&HTTPWorkQueueRun, workQueues[HTTP_QUEUE_INDEX], std::string("bitcoin-httpindex")));
     return true;
 }
 
@@ -462,17 +519,21 @@ void InterruptHTTPServer()
         // Reject requests on current connections
         evhttp_set_gencb(eventHTTP, http_reject_request_cb, NULL);
     }
-    if (workQueue)
-        workQueue->Interrupt();
+    for (int kind = 0; kind < HTTP_QUEUE_COUNT; kind++)
+        if (workQueues[kind])
+            workQueues[kind]->Interrupt();
 }
 
 void StopHTTPServer()
 {
     LogPrint("http", "Stopping HTTP server\n");
-    if (workQueue) {
-        LogPrint("http", "Waiting for HTTP worker threads to exit\n");
-        workQueue->WaitExit();
-        delete workQueue;
+    for (int kind = 0; kind < HTTP_QUEUE_COUNT; kind++) {
+        if (workQueues[kind]) {
+            LogPrint("http", "Waiting for HTTP %s worker threads to exit\n", workQueueNames[kind]);
+            workQueues[kind]->WaitExit();
+            delete workQueues[kind];
+            workQueues[kind] = 0;
+        }
     }
     if (eventBase) {
         LogPrint("http", "Waiting for HTTP event thread to exit\n");
@@ -508,6 +569,20 @@ struct event_base* EventBase()
     return eventBase;
 }
 
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats()
+{
+    std::vector<HTTPWorkQueueStats> vStats;
+    for (int kind = 0; kind < HTTP_QUEUE_COUNT; kind++) {
+        if (!workQueues[kind])
+            continue;
+        HTTPWorkQueueStats stats;
+        stats.strName = workQueueNames[kind];
+        workQueues[kind]->GetStats(stats);
+        vStats.push_back(stats);
+    }
+    return vStats;
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void* data)
 {
     // Static handler: simply call inner handler
@@ -535,12 +610,18 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       chunkedReply(false),
+                                                       fClientGone(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (!replySent && chunkedReply) {
+        // The status line went out already, all that can be done is to drop the connection
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        AbortChunkedReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -579,6 +660,18 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+bool HTTPRequest::PeekBody(std::string& strBody, size_t nMaxSize)
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    size_t size = buf ? evbuffer_get_length(buf) : 0;
+    if (size > nMaxSize)
+        return false;
+    strBody.resize(size);
+    if (size > 0 && evbuffer_copyout(buf, &strBody[0], size) != (ev_ssize_t)size)
+        return false;
+    return true;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -593,7 +686,7 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
  */
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
-    assert(!replySent && req);
+    assert(!replySent && req && !chunkedReply);
     // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
@@ -605,6 +698,135 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+/** Run a function on the HTTP thread and wait for it to complete */
+static void RunInHTTPThread(const boost::function<void(void)>& func)
+{
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fDone = false;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [&]() {
+        func();
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fDone = true;
+        cond.notify_one();
+    });
+    ev->trigger(0);
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (!fDone)
+        cond.wait(lock);
+}
+
+/** Connection close callback of a chunked reply, run in the HTTP thread */
+static void ChunkedReplyConnectionClosed(struct evhttp_connection* evcon, void* arg)
+{
+    *(bool*)arg = true;
+}
+
+/** Stops reporting the connection closing, as the reply is handed back to libevent */
+static void ClearChunkedReplyCloseCallback(struct evhttp_request* req)
+{
+    evhttp_connection* con = evhttp_request_get_connection(req);
+    if (con)
+        evhttp_connection_set_closecb(con, NULL, NULL);
+}
+
+static void SendReplyChunk(struct evhttp_request* req, const bool* pfClientGone, const std::string& strChunk)
+{
+    // libevent frees the request with its connection
+    if (*pfClientGone)
+        return;
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    evhttp_send_reply_chunk(req, evb);
+    evbuffer_free(evb);
+}
+
+/** Size of the data waiting to be sent to the client, run in the HTTP thread */
+static void GetReplyBufferSize(struct evhttp_request* req, const bool* pfClientGone, size_t* pnSize)
+{
+    *pnSize = 0;
+    if (*pfClientGone)
+        return;
+    evhttp_connection* con = evhttp_request_get_connection(req);
+    if (!con)
+        return;
+    struct bufferevent* bev = evhttp_connection_get_bufferevent(con);
+    if (bev)
+        *pnSize = evbuffer_get_length(bufferevent_get_output(bev));
+}
+
+void HTTPRequest::StartChunkedReply(int nStatus)
+{
+    assert(!replySent && req && !chunkedReply);
+    RunInHTTPThread([this, nStatus]() {
+        evhttp_connection* con = evhttp_request_get_connection(req);
+        if (con)
+            evhttp_connection_set_closecb(con, ChunkedReplyConnectionClosed, &fClientGone);
+        evhttp_send_reply_start(req, nStatus, NULL);
+    });
+    chunkedReply = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(!replySent && req && chunkedReply);
+    if (strChunk.empty())
+        return;
+    RunInHTTPThread(boost::bind(SendReplyChunk, req, &fClientGone, boost::cref(strChunk)));
+
+    // Libevent buffers whatever the client doesn't read yet, wait for it to
+    // catch up instead, and give up if it makes no progress
+    const int64_t nTimeout = GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT) * 1000;
+    int64_t nLastProgress = GetTimeMillis();
+    size_t nLastSize = std::numeric_limits<size_t>::max();
+    while (true) {
+        size_t nSize;
+        RunInHTTPThread(boost::bind(GetReplyBufferSize, req, &fClientGone, &nSize));
+        // Only the HTTP thread writes the flag, and it is done with it once RunInHTTPThread returns
+        if (fClientGone)
+            throw std::runtime_error("HTTP client disconnected");
+        if (nSize <= MAX_REPLY_CHUNK_BUFFER)
+            break;
+        if (nSize < nLastSize)
+            nLastProgress = GetTimeMillis();
+        else if (GetTimeMillis() - nLastProgress > nTimeout)
+            throw std::runtime_error("HTTP client stopped reading the reply");
+        nLastSize = nSize;
+        MilliSleep(10);
+    }
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(!replySent && req && chunkedReply);
+    RunInHTTPThread([this]() {
+        if (fClientGone)
+            return;
+        ClearChunkedReplyCloseCallback(req);
+        evhttp_send_reply_end(req);
+    });
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+void HTTPRequest::AbortChunkedReply()
+{
+    assert(!replySent && req && chunkedReply);
+    RunInHTTPThread([this]() {
+        if (fClientGone)
+            return;
+        ClearChunkedReplyCloseCallback(req);
+        // Frees the request too
+        evhttp_connection* con = evhttp_request_get_connection(req);
+        if (con)
+            evhttp_connection_free(con);
+    });
+    replySent = true;
+    req = 0;
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -645,10 +867,10 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPQueueSelector &selector)
 {
     LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, selector));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
@@ -6,12 +6,15 @@
 #define BITCOIN_HTTPSERVER_H
 
 #include <string>
+#include <vector>
 #include <stdint.h>
 #include <boost/thread.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/function.hpp>
 
 static const int DEFAULT_HTTP_THREADS=4;
+static const int DEFAULT_HTTP_CHAIN_THREADS=4;
+static const int DEFAULT_HTTP_INDEX_THREADS=2;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
 
@@ -34,13 +37,30 @@ void InterruptHTTPServer();
 /** Stop HTTP server */
 void StopHTTPServer();
 
+/** Work queues requests are handled from, each with its own worker threads */
+enum HTTPWorkQueueKind {
+    //! Wallet calls, calls that change state, and anything else
+    HTTP_QUEUE_GENERAL,
+    //! Read-only chain queries, so that these don't wait behind slow wallet calls
+    HTTP_QUEUE_CHAIN,
+    //! Read-only queries that scan an index or the UTXO set, so that these don't hold up the cheap ones
+    HTTP_QUEUE_INDEX,
+    HTTP_QUEUE_COUNT
+};
+
 /** Handler for requests to a certain HTTP path */
 typedef boost::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Picks the work queue for a request to a certain HTTP path.
+ * Called from the HTTP event thread, so it must be quick and must not
+ * consume the request body.
+ */
+typedef boost::function<HTTPWorkQueueKind(HTTPRequest* req, const std::string &)> HTTPQueueSelector;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
- * be invoked.
+ * be invoked. Requests are handled from the general work queue unless
+ * a selector picks another one.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPQueueSelector &selector = HTTPQueueSelector());
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
@@ -49,6 +69,25 @@ void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
  */
 struct event_base* EventBase();
 
+/** Depth and latency figures of a work queue */
+struct HTTPWorkQueueStats
+{
+    std::string strName;
+    size_t nDepth;
+    size_t nMaxDepth;
+    int nThreads;
+    //! Requests handled, and rejected because the queue was full
+    uint64_t nProcessed;
+    uint64_t nRejected;
+    //! Time requests spent queued, and being handled, in total
+    int64_t nTotalWaitMicros;
+    int64_t nTotalExecMicros;
+    int64_t nMaxWaitMicros;
+};
+
+/** Return the figures of all work queues */
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats();
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */
@@ -57,6 +96,9 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool chunkedReply;
+    //! Set on the HTTP thread when the client goes away during a chunked reply, which frees req
+    bool fClientGone;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -96,6 +138,12 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Copy the request body into strBody without consuming it.
+     * Returns false if the body is larger than nMaxSize.
+     */
+    bool PeekBody(std::string& strBody, size_t nMaxSize);
+
     /**
      * Write output header.
      *
@@ -112,6 +160,39 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, for bodies that are produced incrementally.
+     * Follow with any number of WriteReplyChunk calls and one EndChunkedReply.
+     *
+     * @note Use instead of WriteReply. Headers must be written before.
+     */
+    void StartChunkedReply(int nStatus);
+
+    /**
+     * Send a part of a chunked reply. Returns once the HTTP thread has taken
+     * the data over, so the caller can reuse its buffer, and the data waiting
+     * to be sent is below a few MB again.
+     *
+     * @throws std::runtime_error if the client disconnected, or didn't read
+     *         any of the reply for -rpcservertimeout seconds
+     */
+    void WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * Finish a chunked reply.
+     *
+     * @note Like WriteReply, this gives the request back to the main thread.
+     */
+    void EndChunkedReply();
+
+    /**
+     * Give up on a chunked reply that can't be completed, by closing the
+     * connection, so the client can't mistake what it got for the whole reply.
+     *
+     * @note Like EndChunkedReply, this gives the request back to the main thread.
+     */
+    void AbortChunkedReply();
 };
 
 /** Event handler closure.
@@ -26,6 +26,7 @@
 #include "miner.h"
 #include "net.h"
 #include "policy/policy.h"
+#include "pow.h"
 #include "rpc/server.h"
 #include "rpc/register.h"
 #include "script/standard.h"
@@ -75,6 +76,7 @@
 #include "activexnode.h"
 #include "darksend.h"
 #include "xnode-payments.h"
+#include "xnode-sigcheck.h"
 #include "xnode-sync.h"
 #include "xnodeman.h"
 #include "xnodeconfig.h"
@@ -88,6 +90,7 @@
 #endif
 
 bool fFeeEstimatesInitialized = false;
+static bool fDumpMempoolLater = false;
 static const bool DEFAULT_PROXYRANDOMIZE = true;
 static const bool DEFAULT_REST_ENABLE = false;
 static const bool DEFAULT_DISABLE_SAFEMODE = false;
@@ -116,6 +119,8 @@ enum BindFlags {
 };
 
 static const char *FEE_ESTIMATES_FILENAME = "fee_estimates.dat";
+/** Seconds between writes of the xnode caches */
+static const int64_t DUMP_XNODE_CACHES_INTERVAL = 15 * 60;
 
 extern CTxMemPool stempool;
 
@@ -203,6 +208,19 @@ static CCoinsViewDB *pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher *pcoinscatcher = NULL;
 static boost::scoped_ptr<ECCVerifyHandle> globalVerifyHandle;
 
+/** Writes the xnode caches, periodically from the scheduler and at shutdown */
+static void DumpXnodeCaches() {
+    static CCriticalSection cs_dumpXnodeCaches;
+    LOCK(cs_dumpXnodeCaches);
+
+    CFlatDB<CXnodeMan> flatdb1("xncache.dat", "magicXnodeCache");
+    flatdb1.Dump(mnodeman);
+    CFlatDB<CXnodePayments> flatdb2("xnpayments.dat", "magicXnodePaymentsCache");
+    flatdb2.Dump(mnpayments);
+    CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
+    flatdb4.Dump(netfulfilledman);
+}
+
 void Interrupt(boost::thread_group &threadGroup) {
     InterruptHTTPServer();
     InterruptHTTPRPC();
@@ -232,6 +250,8 @@ void Shutdown() {
     StopREST();
     StopRPC();
     StopHTTPServer();
+    // Let the listeners catch up before they are flushed and torn down
+    StopValidationInterfaceQueue();
 #ifdef ENABLE_WALLET
     if (pwalletMain)
         pwalletMain->Flush(false);
@@ -240,13 +260,12 @@ void Shutdown() {
 #endif
     GenerateBitcoins(false, 0, Params());
     StopNode();
+    xnodeSigCheckPool.Stop();
 
-    CFlatDB<CXnodeMan> flatdb1("xncache.dat", "magicXnodeCache");
-    flatdb1.Dump(mnodeman);
-    CFlatDB<CXnodePayments> flatdb2("xnpayments.dat", "magicXnodePaymentsCache");
-    flatdb2.Dump(mnpayments);
-    CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
-    flatdb4.Dump(netfulfilledman);
+    if (fDumpMempoolLater && GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL))
+        DumpMempool();
+
+    DumpXnodeCaches();
 
     StopTorControl();
     UnregisterNodeSignals(GetNodeSignals());
@@ -287,6 +306,8 @@ void Shutdown() {
     zwalletMain = NULL;
 #endif
 
+    UnregisterValidationInterface(&xnodeCollateralWatcher);
+
 #if ENABLE_ZMQ
     if (pzmqNotificationInterface) {
         UnregisterValidationInterface(pzmqNotificationInterface);
@@ -385,6 +406,12 @@ std::string HelpMessage(HelpMessageMode mode) {
         strUsage += HelpMessageOpt("-feefilter", strprintf(
                 "Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
+    strUsage += HelpMessageOpt("-loadblockthreads=<n>", strprintf(
+            _("Set the number of threads deserializing and checking blocks during -reindex and -loadblock (0 = auto, <0 = leave that many cores free, default: %d)"),
+            DEFAULT_LOADBLOCK_THREADS));
+    strUsage += HelpMessageOpt("-xnodesigthreads=<n>", strprintf(
+            _("Set the number of threads verifying the signatures of xnode announcements, pings and payment votes (0 = auto, <0 = leave that many cores free, default: %d)"),
+            DEFAULT_XNODE_SIGCHECK_THREADS));
     strUsage += HelpMessageOpt("-maxorphantx=<n>",
                                strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"),
                                          DEFAULT_MAX_ORPHAN_TRANSACTIONS));
@@ -393,6 +420,8 @@ std::string HelpMessage(HelpMessageMode mode) {
                                          DEFAULT_MAX_MEMPOOL_SIZE));
     strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(
             _("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
+    strUsage += HelpMessageOpt("-persistmempool", strprintf(
+            _("Whether to save the mempool on shutdown and load on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(
             _("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
             -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
@@ -416,6 +445,7 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
     strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-utxostatsindex", strprintf(_("Maintain statistics about the unspent transaction output set for every block, used by the gettxoutsetinfo rpc call (default: %u)"), DEFAULT_UTXOSTATSINDEX));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
@@ -516,6 +546,9 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubsigmatx=<address>", _("Enable publish sigma mints and spends of transactions in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubxnode=<address>", _("Enable publish xnode list changes in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubexodustx=<address>", _("Enable publish Exodus transaction results in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -526,6 +559,12 @@ std::string HelpMessage(HelpMessageMode mode) {
                 Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)",
                                                                   Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkretarget", strprintf(
+                "Check the difficulty retarget against the legacy bignum arithmetic on fixed test chains at startup (default: %u)",
+                Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
+        strUsage += HelpMessageOpt("-checkxnpayments", strprintf(
+                "Check the stored xnode payment votes for consistency whenever old ones are removed (default: %u)",
+                Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints",
                                    strprintf("Disable expensive verification for known chain history (default: %u)",
                                              DEFAULT_CHECKPOINTS_ENABLED));
@@ -584,7 +623,7 @@ std::string HelpMessage(HelpMessageMode mode) {
                 "Require high priority for relaying free or low-fee transactions (default: %u)",
                 DEFAULT_RELAYPRIORITY));
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>",
-                                   strprintf("Limit size of signature cache to <n> MiB (default: %u)",
+                                   strprintf("Limit size of signature cache to <n> MiB, allocated in full at startup (default: %u)",
                                              DEFAULT_MAX_SIG_CACHE_SIZE));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf(
                 "Maximum tip age in seconds to consider node in initial block download (default: %u)",
@@ -655,9 +694,15 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-rpcthreads=<n>",
                                strprintf(_("Set the number of threads to service RPC calls (default: %d)"),
                                          DEFAULT_HTTP_THREADS));
+    strUsage += HelpMessageOpt("-rpcchainthreads=<n>",
+                               strprintf(_("Set the number of threads to service read-only chain queries over RPC and REST (default: %d)"),
+                                         DEFAULT_HTTP_CHAIN_THREADS));
+    strUsage += HelpMessageOpt("-rpcindexthreads=<n>",
+                               strprintf(_("Set the number of threads to service RPC queries that scan an index or the UTXO set (default: %d)"),
+                                         DEFAULT_HTTP_INDEX_THREADS));
     if (showDebug) {
         strUsage += HelpMessageOpt("-rpcworkqueue=<n>",
-                                   strprintf("Set the depth of the work queue to service RPC calls (default: %d)",
+                                   strprintf("Set the depth of each of the work queues to service RPC calls (default: %d)",
                                              DEFAULT_HTTP_WORKQUEUE));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)",
                                                                       DEFAULT_HTTP_SERVER_TIMEOUT));
@@ -670,6 +715,7 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-startclean", "Clear all persistence files on startup; triggers reparsing of Exodus transactions");
     strUsage += HelpMessageOpt("-exodustxcache=<num>", "The maximum number of transactions in the input transaction cache (default: 500000)");
     strUsage += HelpMessageOpt("-exodusprogressfrequency=<seconds>", "Time in seconds after which the initial scanning progress is reported (default: 30)");
+    strUsage += HelpMessageOpt("-exodusscanthreads=<n>", strprintf("Number of threads reading blocks ahead of the initial scan (0 = number of cores, default: %d)", DEFAULT_EXODUS_SCAN_THREADS));
     strUsage += HelpMessageOpt("-exodusdebug=<category>", "Enable or disable log categories, can be \"all\" or \"none\"");
     strUsage += HelpMessageOpt("-autocommit=<flag>", "Enable or disable broadcasting of transactions, when creating transactions (default: 1)");
     strUsage += HelpMessageOpt("-overrideforcedshutdown=<flag>", "Disable force shutdown when error (default: 0)");
@@ -864,6 +910,11 @@ void ThreadImport(std::vector <boost::filesystem::path> vImportFiles) {
         zwalletMain->GetTracker().ListMints();
     }
 #endif
+
+    if (GetBoolArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL))
+        LoadMempool();
+    // Do not overwrite the dump with a partially loaded mempool
+    fDumpMempoolLater = !ShutdownRequested();
 }
 
 /** Sanity checks
@@ -1229,6 +1280,11 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
+    // Checkretarget defaults to true in regtest mode as well
+    if (GetBoolArg("-checkretarget", chainparams.DefaultConsistencyChecks()) && !RetargetSanityCheck())
+        return InitError("Difficulty retarget sanity check failure. Aborting.");
+    mnpayments.SetSanityCheck(GetBoolArg("-checkxnpayments", chainparams.DefaultConsistencyChecks()));
+
     // mempool AC_CONFIG_SUBDIRSlimits
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     int64_t nMempoolSizeMin = GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) * 1000 * 40;
@@ -1405,6 +1461,8 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     LogPrintf("Using at most %i connections (%i file descriptors available)\n", nMaxConnections, nFD);
     std::ostringstream strErrors;
 
+    InitSignatureCache();
+
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i = 0; i < nScriptCheckThreads - 1; i++)
@@ -1421,6 +1479,9 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
 
+    // Deliver validation notifications to the wallets and other listeners in the background
+    StartValidationInterfaceQueue();
+
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
      * that the server is there and will be ready later).  Warmup mode will
@@ -1708,6 +1769,12 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
                     break;
                 }
 
+                // Check for changed -utxostatsindex state
+                if (fUTXOStatsIndex != GetBoolArg("-utxostatsindex", DEFAULT_UTXOSTATSINDEX)) {
+                    strLoadError = _("You need to rebuild the database using -reindex-chainstate to change -utxostatsindex");
+                    break;
+                }
+
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
                 // in the past, but is now trying to run unpruned.
                 if (fHavePruned && !fPruneMode) {
@@ -1933,6 +2000,12 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     if (GetBoolArg("-listenonion", DEFAULT_LISTEN_ONION))
         StartTorControl(threadGroup, scheduler);
 
+    // -xnodesigthreads=0 means autodetect
+    int nXnodeSigCheckThreads = GetArg("-xnodesigthreads", DEFAULT_XNODE_SIGCHECK_THREADS);
+    if (nXnodeSigCheckThreads <= 0)
+        nXnodeSigCheckThreads += GetNumCores();
+    xnodeSigCheckPool.Start(std::min(std::max(nXnodeSigCheckThreads, 1), MAX_XNODE_SIGCHECK_THREADS));
+
     StartNode(threadGroup, scheduler);
     // Generate coins in the background
     GenerateBitcoins(GetBoolArg("-gen", DEFAULT_GENERATE), GetArg("-genproclimit", DEFAULT_GENERATE_THREADS),
@@ -2024,6 +2097,10 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
 
     // ********************************************************* Step 11b: Load cache data
 
+    // follow spends of the collaterals from here on, the first check of every
+    // loaded xnode looks its collateral up
+    RegisterValidationInterface(&xnodeCollateralWatcher);
+
     // LOAD SERIALIZED DAT FILES INTO DATA CACHES FOR INTERNAL USE
     if (GetBoolArg("-persistentxnodestate", true)) {
         uiInterface.InitMessage(_("Loading xnode cache..."));
@@ -2051,6 +2128,9 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     //     LogPrint"Failed to load fulfilled requests cache from netfulfilled.dat");
     // }
 
+    // keep the caches on disk recent, shutdown then mostly finds them unchanged
+    scheduler.scheduleEvery(&DumpXnodeCaches, DUMP_XNODE_CACHES_INTERVAL);
+
     // ********************************************************* Step 11c: update block tip in GravityCoin modules
 
     // force UpdatedBlockTip to initialize pCurrentBlockIndex for DS, MN payments and budgets
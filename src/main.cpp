@@ -9,6 +9,8 @@
 #include "addrman.h"
 #include "arith_uint256.h"
 #include "blockencodings.h"
+#include "blockfileloader.h"
+#include "blockfilemap.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -49,6 +51,7 @@
 #include "darksend.h"
 #include "instantx.h"
 #include "xnode-payments.h"
+#include "xnode-sigcheck.h"
 #include "xnode-sync.h"
 #include "xnodeman.h"
 #include "coins.h"
@@ -64,6 +67,7 @@
 #include <boost/algorithm/string/join.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/math/distributions/poisson.hpp>
 #include <boost/thread.hpp>
 
@@ -83,6 +87,7 @@ CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
 CChain chainActive;
+static std::atomic<const CBlockIndex*> pindexTipSnapshot(NULL);
 CBlockIndex *pindexBestHeader = NULL;
 int64_t nTimeBestReceived = 0;
 CWaitableCriticalSection csBestBlock;
@@ -96,6 +101,7 @@ bool fPruneMode = false;
 bool fAddressIndex = false;
 bool fSpentIndex = false;
 bool fTimestampIndex = false;
+bool fUTXOStatsIndex = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
@@ -726,6 +732,11 @@ void UnregisterNodeSignals(CNodeSignals &nodeSignals) {
     nodeSignals.FinalizeNode.disconnect(&FinalizeNode);
 }
 
+const CBlockIndex* GetChainTipSnapshot()
+{
+    return pindexTipSnapshot;
+}
+
 CBlockIndex *FindForkInGlobalIndex(const CChain &chain, const CBlockLocator &locator) {
     // Find the first block the caller has in the main chain
     BOOST_FOREACH(
@@ -1122,7 +1133,8 @@ bool CheckTransaction(
         bool isCheckWallet,
         bool fStatefulZerocoinCheck,
         CZerocoinTxInfo *zerocoinTxInfo,
-        sigma::CSigmaTxInfo *sigmaTxInfo)
+        sigma::CSigmaTxInfo *sigmaTxInfo,
+        bool fCheckSpendProofs)
 {
     LogPrintf("CheckTransaction nHeight=%s, isVerifyDB=%s, isCheckWallet=%s, txHash=%s\n", nHeight, isVerifyDB, isCheckWallet, tx.GetHash().ToString());
 //    LogPrintf("transaction = %s\n", tx.ToString());
@@ -1191,7 +1203,8 @@ bool CheckTransaction(
                     nHeight,
                     isCheckWallet,
                     fStatefulZerocoinCheck,
-                    sigmaTxInfo))
+                    sigmaTxInfo,
+                    fCheckSpendProofs))
             return false;
         }
 
@@ -1204,7 +1217,8 @@ bool CheckTransaction(
             nHeight,
             isCheckWallet,
             fStatefulZerocoinCheck,
-            zerocoinTxInfo)) {
+            zerocoinTxInfo,
+            fCheckSpendProofs)) {
             return false;
         }
     }
@@ -1243,7 +1257,8 @@ bool AcceptToMemoryPoolWorker(
         const CAmount &nAbsurdFee,
         std::vector <uint256> &vHashTxnToUncache,
         bool isCheckWalletTransaction,
-        bool markGravityCoinSpendTransactionSerial) {
+        bool markGravityCoinSpendTransactionSerial,
+        int64_t nAcceptTime) {
     bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
     LogPrintf("AcceptToMemoryPoolWorker(),fCheckInputs=%s, tx.IsZerocoinSpend()=%s, fTestNet=%s\n",
               fCheckInputs, tx.IsZerocoinSpend() || tx.IsSigmaSpend(), fTestNet);
@@ -1494,7 +1509,7 @@ bool AcceptToMemoryPoolWorker(
                 }
             }
 
-            CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height(), pool.HasNoInputsOf(tx),
+            CTxMemPoolEntry entry(tx, nFees, nAcceptTime, dPriority, chainActive.Height(), pool.HasNoInputsOf(tx),
                                   inChainInputValue, fSpendsCoinbase, nSigOpsCost, lp);
 
             // TODO: Temporarily disable this condition (by setting txMinFee = 0) to accept zero-fee TX (from old 0.8 client)
@@ -1794,7 +1809,7 @@ bool AcceptToMemoryPoolWorker(
             CAmount nFees = 0;
             int64_t nSigOpsCost = GetLegacySigOpCount(tx);
             CTxMemPool::setEntries setAncestors;
-            CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height(), pool.HasNoInputsOf(tx),
+            CTxMemPoolEntry entry(tx, nFees, nAcceptTime, dPriority, chainActive.Height(), pool.HasNoInputsOf(tx),
                                   inChainInputValue, fSpendsCoinbase, nSigOpsCost, lp);
             pool.addUnchecked(hash, entry, setAncestors, !IsInitialBlockDownload());
             if (tx.IsZerocoinSpend()) {
@@ -1839,15 +1854,16 @@ bool AcceptToMemoryPoolWorker(
     return true;
 }
 
-bool AcceptToMemoryPool(
-	    CTxMemPool &pool,
-	    CValidationState &state,
-	    const CTransaction &tx,
-	    bool fCheckInputs,
+bool AcceptToMemoryPoolWithTime(
+        CTxMemPool &pool,
+        CValidationState &state,
+        const CTransaction &tx,
+        bool fCheckInputs,
         bool fLimitFree,
         bool *pfMissingInputs,
-	    bool fOverrideMempoolLimit,
-	    const CAmount nAbsurdFee,
+        int64_t nAcceptTime,
+        bool fOverrideMempoolLimit,
+        const CAmount nAbsurdFee,
         bool isCheckWalletTransaction,
         bool markGravityCoinSpendTransactionSerial) {
     LogPrintf("AcceptToMemoryPool(), transaction: %s, fCheckInputs=%s\n",
@@ -1858,7 +1874,7 @@ bool AcceptToMemoryPool(
         pool, state, tx, fCheckInputs, fLimitFree, pfMissingInputs,
         fOverrideMempoolLimit, nAbsurdFee,
         vHashTxToUncache, isCheckWalletTransaction,
-        markGravityCoinSpendTransactionSerial);
+        markGravityCoinSpendTransactionSerial, nAcceptTime);
     if (res) {
         LogPrintf("AcceptToMemoryPool: Successfully added txn %s to %s.\n",
                   tx.ToString(),
@@ -1874,6 +1890,21 @@ bool AcceptToMemoryPool(
     return res;
 }
 
+bool AcceptToMemoryPool(
+	    CTxMemPool &pool,
+	    CValidationState &state,
+	    const CTransaction &tx,
+	    bool fCheckInputs,
+        bool fLimitFree,
+        bool *pfMissingInputs,
+	    bool fOverrideMempoolLimit,
+	    const CAmount nAbsurdFee,
+        bool isCheckWalletTransaction,
+        bool markGravityCoinSpendTransactionSerial) {
+    return AcceptToMemoryPoolWithTime(pool, state, tx, fCheckInputs, fLimitFree, pfMissingInputs, GetTime(),
+        fOverrideMempoolLimit, nAbsurdFee, isCheckWalletTransaction, markGravityCoinSpendTransactionSerial);
+}
+
 /** Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock */
 bool
 GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params &consensusParams, uint256 &hashBlock,
@@ -1891,16 +1922,28 @@ GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
             CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception &e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            CMappedRecord record;
+            if (MapBlockRecord(postx, "blk", 0, record)) {
+                try {
+                    CMappedRecordReader file(record, SER_DISK, CLIENT_VERSION);
+                    file >> header;
+                    file.ignore(postx.nTxOffset);
+                    file >> txOut;
+                } catch (const std::exception &e) {
+                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                }
+            } else {
+                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+                if (file.IsNull())
+                    return error("%s: OpenBlockFile failed", __func__);
+                try {
+                    file >> header;
+                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                    file >> txOut;
+                } catch (const std::exception &e) {
+                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                }
             }
             hashBlock = header.GetHash();
             if (txOut.GetHash() != hash)
@@ -2014,24 +2057,40 @@ bool WriteBlockToDisk(const CBlock &block, CDiskBlockPos &pos, const CMessageHea
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos, int nHeight, const Consensus::Params &consensusParams) {
-    block.SetNull();
-
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
-
-    // Read block
+/**
+ * Deserializes the block stored at pos. Blocks are read straight from the
+ * mapped block file, and from the file itself only if it can't be mapped.
+ */
+static bool ReadBlockData(CBlock &block, const CDiskBlockPos &pos, const char *func) {
     try {
+        CMappedRecord record;
+        if (MapBlockRecord(pos, "blk", 0, record)) {
+            CMappedRecordReader filein(record, SER_DISK, CLIENT_VERSION);
+            filein >> block;
+            return true;
+        }
+
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("%s: OpenBlockFile failed for %s", func, pos.ToString());
         filein >> block;
     }
     catch (const std::exception &e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        return error("%s: Deserialize or I/O error - %s at %s", func, e.what(), pos.ToString());
     }
+    return true;
+}
+
+bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos, int nHeight, const Consensus::Params &consensusParams, bool fCheckPOW) {
+    block.SetNull();
+
+    // Read block
+    if (!ReadBlockData(block, pos, __func__))
+        return false;
 
     // Check the header
-    if (!CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams)){
+    if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams)){
         //Maybe cache is not valid
         if (!CheckProofOfWork(block.GetPoWHash(nHeight, true), block.nBits, consensusParams)){
             return error("ReadBlockFromDisk: CheckProofOfWork: Errors in block header at %s", pos.ToString());
@@ -2040,8 +2099,8 @@ bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos, int nHeight, con
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex, const Consensus::Params &consensusParams) {
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), pindex->nHeight, consensusParams))
+bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex, const Consensus::Params &consensusParams, bool fCheckPOW) {
+    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), pindex->nHeight, consensusParams, fCheckPOW))
         return false;
 
     if (block.GetHash() != pindex->GetBlockHash()) {
@@ -2051,12 +2110,53 @@ bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex, const Consensus
     return true;
 }
 
-bool ReadBlockHeaderFromDisk(CBlock &block, const CDiskBlockPos &pos) {
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+bool ReadIndexedBlockFromDisk(CBlock &block, const CBlockIndex *pindex) {
+    block.SetNull();
 
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (!ReadBlockData(block, pos, __func__))
+        return false;
+
+    // The proof of work was checked when the header was accepted, so matching the hash is sufficient
+    if (block.GetHash() != pindex->GetBlockHash()) {
+        return error("ReadIndexedBlockFromDisk: GetHash() doesn't match index for %s at %s",
+                     pindex->ToString(), pos.ToString());
+    }
+    return true;
+}
+
+bool ReadRawBlockFromDisk(CMappedRecord &record, const CBlockIndex *pindex) {
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (!MapBlockRecord(pos, "blk", 0, record))
+        return false;
+
+    CBlockHeader header;
+    try {
+        CMappedRecordReader filein(record, SER_DISK, CLIENT_VERSION);
+        filein >> header;
+    }
+    catch (const std::exception &e) {
+        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+    if (header.GetHash() != pindex->GetBlockHash()) {
+        return error("ReadRawBlockFromDisk: GetHash() doesn't match index for %s at %s",
+                     pindex->ToString(), pos.ToString());
+    }
+    return true;
+}
+
+bool ReadBlockHeaderFromDisk(CBlock &block, const CDiskBlockPos &pos) {
     try {
+        CMappedRecord record;
+        if (MapBlockRecord(pos, "blk", 0, record)) {
+            CMappedRecordReader filein(record, SER_DISK, CLIENT_VERSION);
+            block.SerializationOp(filein, CBlockHeader::CReadBlockHeader(), SER_DISK, CLIENT_VERSION);
+            return true;
+        }
+
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
         block.SerializationOp(filein, CBlockHeader::CReadBlockHeader(), SER_DISK, CLIENT_VERSION);
     }
     catch (const std::exception &e) {
@@ -2492,16 +2592,22 @@ namespace {
     }
 
     bool UndoReadFromDisk(CBlockUndo &blockundo, const CDiskBlockPos &pos, const uint256 &hashBlock) {
-        // Open history file to read
-        CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-        if (filein.IsNull())
-            return error("%s: OpenUndoFile failed", __func__);
-
-        // Read block
+        // Read block, from the mapped undo file if possible
         uint256 hashChecksum;
         try {
-            filein >> blockundo;
-            filein >> hashChecksum;
+            CMappedRecord record;
+            if (MapBlockRecord(pos, "rev", sizeof(hashChecksum), record)) {
+                CMappedRecordReader filein(record, SER_DISK, CLIENT_VERSION);
+                filein >> blockundo;
+                filein >> hashChecksum;
+            } else {
+                // Open history file to read
+                CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+                if (filein.IsNull())
+                    return error("%s: OpenUndoFile failed", __func__);
+                filein >> blockundo;
+                filein >> hashChecksum;
+            }
         }
         catch (const std::exception &e) {
             return error("%s: Deserialize or I/O error - %s", __func__, e.what());
@@ -2675,6 +2781,10 @@ void static FlushBlockFile(bool fFinalize = false) {
 
     CDiskBlockPos posOld(nLastBlockFile, 0);
 
+    // Mappings of the preallocated space would reach past the end of the truncated files
+    if (fFinalize)
+        UnmapBlockFile(nLastBlockFile);
+
     FILE *fileOld = OpenBlockFile(posOld);
     if (fileOld) {
         if (fFinalize)
@@ -2775,8 +2885,11 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
     if (block.GetHash() == chainparams.GetConsensus().hashGenesisBlock) {
-        if (!fJustCheck)
+        if (!fJustCheck) {
+            if (fUTXOStatsIndex && !pblocktree->WriteUTXOStats(pindex->GetBlockHash(), CUTXOStats()))
+                return AbortNode(state, "Failed to write UTXO set statistics");
             view.SetBestBlock(pindex->GetBlockHash());
+        }
         return true;
     }
 
@@ -2784,7 +2897,7 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
     if (fCheckpointsEnabled) {
         CBlockIndex *pindexLastCheckpoint = Checkpoints::GetLastCheckpoint(chainparams.Checkpoints());
         if (pindexLastCheckpoint && pindexLastCheckpoint->GetAncestor(pindex->nHeight) == pindex) {
-            // This block is an ancestor of a checkpoint: disable script checks
+            // This block is an ancestor of a checkpoint: disable script checks and zerocoin/sigma proof checks
             fScriptChecks = false;
         }
     }
@@ -2898,6 +3011,23 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
     block.zerocoinTxInfo = std::make_shared<CZerocoinTxInfo>();
     block.sigmaTxInfo = std::make_shared<sigma::CSigmaTxInfo>();
 
+    // Unspent outputs of the transactions spent from, before this block, to
+    // update the UTXO set statistics from
+    std::map<uint256, CCoins> mapCoinsBefore;
+    if (fUTXOStatsIndex && !fJustCheck) {
+        BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+            if (tx.IsCoinBase() || tx.IsZerocoinSpend() || tx.IsSigmaSpend() || tx.IsZerocoinRemint())
+                continue;
+            BOOST_FOREACH(const CTxIn &txin, tx.vin) {
+                if (mapCoinsBefore.count(txin.prevout.hash))
+                    continue;
+                const CCoins *coins = view.AccessCoins(txin.prevout.hash);
+                if (coins && !coins->IsPruned())
+                    mapCoinsBefore.insert(std::make_pair(txin.prevout.hash, *coins));
+            }
+        }
+    }
+
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
         const CTransaction &tx = block.vtx[i];
 
@@ -2944,7 +3074,7 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
                 nFees += sigma::GetSigmaSpendInput(tx) - tx.GetValueOut();
 
             // Check transaction against zerocoin state
-            if (!CheckTransaction(tx, state, txHash, false, pindex->nHeight, false, true, block.zerocoinTxInfo.get(), block.sigmaTxInfo.get()))
+            if (!CheckTransaction(tx, state, txHash, false, pindex->nHeight, false, true, block.zerocoinTxInfo.get(), block.sigmaTxInfo.get(), fScriptChecks))
                 return state.DoS(100, error("stateful zerocoin check failed"),
                                  REJECT_INVALID, "bad-txns-zerocoin");
         }
@@ -3074,6 +3204,22 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
         if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
             return AbortNode(state, "Failed to write timestamp index");
 
+    if (fUTXOStatsIndex) {
+        CUTXOStats utxoStats;
+        if (pblocktree->ReadUTXOStats(pindex->pprev->GetBlockHash(), utxoStats)) {
+            for (std::map<uint256, CCoins>::const_iterator it = mapCoinsBefore.begin(); it != mapCoinsBefore.end(); ++it)
+                utxoStats.Update(it->first, &it->second, view.AccessCoins(it->first));
+            BOOST_FOREACH(const uint256 &txHash, txIds) {
+                if (!mapCoinsBefore.count(txHash))
+                    utxoStats.Update(txHash, NULL, view.AccessCoins(txHash));
+            }
+            if (!pblocktree->WriteUTXOStats(pindex->GetBlockHash(), utxoStats))
+                return AbortNode(state, "Failed to write UTXO set statistics");
+        } else {
+            LogPrintf("%s: no UTXO set statistics for block %s, not updating them\n", __func__, pindex->pprev->GetBlockHash().ToString());
+        }
+    }
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -3083,7 +3229,7 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
 
     // Watch for changes to the previous coinbase transaction.
     static uint256 hashPrevBestCoinBase;
-    GetMainSignals().UpdatedTransaction(hashPrevBestCoinBase);
+    NotifyUpdatedTransaction(hashPrevBestCoinBase);
     hashPrevBestCoinBase = block.vtx[0].GetHash();
 
     // Erase orphan transactions include or precluded by this block
@@ -3253,7 +3399,7 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
         if (fDoFullFlush || ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) &&
                              nNow > nLastSetChain + (int64_t) DATABASE_WRITE_INTERVAL * 1000000)) {
             // Update best block in wallet (so we can detect restored wallets).
-            GetMainSignals().SetBestChain(chainActive.GetLocator());
+            NotifySetBestChain(chainActive.GetLocator());
             nLastSetChain = nNow;
         }
     } catch (const std::runtime_error &e) {
@@ -3277,11 +3423,12 @@ void PruneAndFlush() {
 void static UpdateTip(CBlockIndex *pindexNew, const CChainParams &chainParams) {
     LogPrintf("UpdateTip() pindexNew.nHeight=%s\n", pindexNew->nHeight);
     chainActive.SetTip(pindexNew);
+    pindexTipSnapshot = pindexNew;
     mnodeman.UpdatedBlockTip(chainActive.Tip());
     darkSendPool.UpdatedBlockTip(chainActive.Tip());
     mnpayments.UpdatedBlockTip(chainActive.Tip());
     xnodeSync.UpdatedBlockTip(chainActive.Tip());
-    GetMainSignals().UpdatedBlockTip(chainActive.Tip());
+    NotifyUpdatedBlockTip(chainActive.Tip());
 
     // New best block
     nTimeBestReceived = GetTime();
@@ -3339,6 +3486,23 @@ void static UpdateTip(CBlockIndex *pindexNew, const CChainParams &chainParams) {
         LogPrintf(" warning='%s'", boost::algorithm::join(warningMessages, ", "));
 }
 
+#ifdef ENABLE_WALLET
+/** Update the HD mint tracker from the sigma transactions of a block, as a queued validation notification */
+static void UpdateMintTrackerFromBlock(const std::shared_ptr<sigma::CSigmaTxInfo> &sigmaTxInfo, int nHeight) {
+    if (!zwalletMain)
+        return;
+    if (sigmaTxInfo->spentSerials.size() > 0) {
+        LogPrintf("HDmint: UpdateSpendStateFromBlock. [height: %d]\n", nHeight);
+        zwalletMain->GetTracker().UpdateSpendStateFromBlock(sigmaTxInfo->spentSerials);
+    }
+
+    if (sigmaTxInfo->mints.size() > 0) {
+        LogPrintf("HDmint: UpdateMintStateFromBlock. [height: %d]\n", nHeight);
+        zwalletMain->GetTracker().UpdateMintStateFromBlock(sigmaTxInfo->mints);
+    }
+}
+#endif
+
 /** Disconnect chainActive's tip. You probably want to call mempool.removeForReorg and manually re-limit mempool size after this, with cs_main held. */
 bool static DisconnectTip(CValidationState &state, const CChainParams &chainparams, bool fBare = false) {
     LogPrintf("DisconnectTip()\n");
@@ -3346,7 +3510,7 @@ bool static DisconnectTip(CValidationState &state, const CChainParams &chainpara
     assert(pindexDelete);
     // Read block from disk.
     CBlock block;
-    if (!ReadBlockFromDisk(block, pindexDelete, chainparams.GetConsensus()))
+    if (!ReadBlockFromDisk(block, pindexDelete, chainparams.GetConsensus(), !IsBlockCheckpointed(pindexDelete->GetBlockHash())))
         return AbortNode(state, "Failed to read block");
 
     // retrieve all mints
@@ -3420,15 +3584,7 @@ bool static DisconnectTip(CValidationState &state, const CChainParams &chainpara
 
 #ifdef ENABLE_WALLET
     // update mint/spend wallet
-    if (zwalletMain) {
-        if (block.sigmaTxInfo->spentSerials.size() > 0) {
-            zwalletMain->GetTracker().UpdateSpendStateFromBlock(block.sigmaTxInfo->spentSerials);
-        }
-
-        if (block.sigmaTxInfo->mints.size() > 0) {
-            zwalletMain->GetTracker().UpdateMintStateFromBlock(block.sigmaTxInfo->mints);
-        }
-    }
+    CallFunctionInValidationInterfaceQueue(boost::bind(&UpdateMintTrackerFromBlock, block.sigmaTxInfo, pindexDelete->nHeight));
 #endif
 
     //! Exodus: begin block disconnect notification
@@ -3441,9 +3597,7 @@ bool static DisconnectTip(CValidationState &state, const CChainParams &chainpara
 
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
-    BOOST_FOREACH(const CTransaction &tx, block.vtx) {
-        SyncWithWallets(tx, pindexDelete->pprev, NULL);
-    }
+    SyncBlockWithWallets(boost::make_shared<const CBlock>(block), pindexDelete->pprev, false);
 
     //! Exodus: end of block disconnect notification
     if (fExodus) {
@@ -3472,7 +3626,7 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
     int64_t nTime1 = GetTimeMicros();
     CBlock block;
     if (!pblock) {
-        if (!ReadBlockFromDisk(block, pindexNew, chainparams.GetConsensus()))
+        if (!ReadBlockFromDisk(block, pindexNew, chainparams.GetConsensus(), !IsBlockCheckpointed(pindexNew->GetBlockHash())))
             return AbortNode(state, "Failed to read block");
         pblock = &block;
     }
@@ -3540,12 +3694,13 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
         SyncWithWallets(tx, pindexNew, NULL);
     }
     // ... and about transactions that got confirmed:
-    BOOST_FOREACH(
-    const CTransaction &tx, pblock->vtx) {
-        SyncWithWallets(tx, pindexNew, pblock);
+    SyncBlockWithWallets(boost::make_shared<const CBlock>(*pblock), pindexNew, true);
 
-        //! Exodus: new confirmed transaction notification
-        if (fExodus) {
+    //! Exodus: new confirmed transaction notification
+    //! Exodus recovers from reorganizations by rescanning up to the current
+    //! tip, so unlike the wallet it has to stay in step with validation
+    if (fExodus) {
+        BOOST_FOREACH(const CTransaction &tx, pblock->vtx) {
             LogPrint("handler", "Exodus handler: new confirmed transaction [height: %d, idx: %u]\n", GetHeight(), nTxIdx);
             if (exodus_handler_tx(tx, GetHeight(), nTxIdx++, pindexNew)) ++nNumMetaTxs;
         }
@@ -3553,18 +3708,7 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
 
 #ifdef ENABLE_WALLET
     // Sync with HDMint wallet
-    if (zwalletMain) {
-        LogPrintf("Checking if block contains wallet mints..\n");
-        if (pblock->sigmaTxInfo->spentSerials.size() > 0) {
-            LogPrintf("HDmint: UpdateSpendStateFromBlock. [height: %d]\n", GetHeight());
-            zwalletMain->GetTracker().UpdateSpendStateFromBlock(pblock->sigmaTxInfo->spentSerials);
-        }
-
-        if (pblock->sigmaTxInfo->mints.size() > 0) {
-            LogPrintf("HDmint: UpdateMintStateFromBlock. [height: %d]\n", GetHeight());
-            zwalletMain->GetTracker().UpdateMintStateFromBlock(pblock->sigmaTxInfo->mints);
-        }
-    }
+    CallFunctionInValidationInterfaceQueue(boost::bind(&UpdateMintTrackerFromBlock, pblock->sigmaTxInfo, pindexNew->nHeight));
 #endif
 
     //! Exodus: end of block connect notification
@@ -3932,7 +4076,7 @@ bool ActivateBestChain(CValidationState &state, const CChainParams &chainparams,
                 }
                 // Notify external listeners about the new tip.
                 if (!vHashes.empty()) {
-                    GetMainSignals().UpdatedBlockTip(pindexNewTip);
+                    NotifyUpdatedBlockTip(pindexNewTip);
                 }
             }
         }
@@ -4245,9 +4389,21 @@ bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigne
     return true;
 }
 
+bool IsBlockCheckpointed(const uint256 &hash) {
+    AssertLockHeld(cs_main);
+    if (!fCheckpointsEnabled)
+        return false;
+    BlockMap::const_iterator mi = mapBlockIndex.find(hash);
+    if (mi == mapBlockIndex.end())
+        return false;
+    CBlockIndex *pindexLastCheckpoint = Checkpoints::GetLastCheckpoint(Params().Checkpoints());
+    return pindexLastCheckpoint && pindexLastCheckpoint->GetAncestor(mi->second->nHeight) == mi->second;
+}
+
 //btzc: code from vertcoin, add
-bool CheckBlockHeader(const CBlockHeader &block, CValidationState &state, const Consensus::Params &consensusParams, bool fCheckPOW) {
-    int nHeight = ZerocoinGetNHeight(block);
+bool CheckBlockHeader(const CBlockHeader &block, CValidationState &state, const Consensus::Params &consensusParams, bool fCheckPOW, int nHeight) {
+    if (nHeight == INT_MAX)
+        nHeight = ZerocoinGetNHeight(block);
     if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams)) {
         //Maybe cache is not valid
         if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(nHeight, true), block.nBits, consensusParams)) {
@@ -4272,9 +4428,16 @@ bool CheckBlock(const CBlock &block, CValidationState &state,
         if (block.fChecked)
             return true;
 
+        if (nHeight == INT_MAX)
+            nHeight = ZerocoinGetNHeight(block.GetBlockHeader());
+
+        // The hash of a checkpointed block is committed to by the checkpoint,
+        // no need to compute Lyra2Z or verify spend proofs for it
+        bool fCheckpointed = IsBlockCheckpointed(block.GetHash());
+
         // Check that the header is valid (particularly PoW).  This is mostly
         // redundant with the call in AcceptBlockHeader.
-        if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW)) {
+        if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW && !fCheckpointed, nHeight)) {
             LogPrintf("CheckBlock - CheckBlockHeader -> failed!\n");
             return false;
         }
@@ -4352,16 +4515,14 @@ bool CheckBlock(const CBlock &block, CValidationState &state,
         }
 
         // Check transactions
-        if (nHeight == INT_MAX)
-            nHeight = ZerocoinGetNHeight(block.GetBlockHeader());
-
         if (!CheckZerocoinFoundersInputs(block.vtx[0], state, Params().GetConsensus(), nHeight)) {
             return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(), "Founders' reward check failed");
         }
 
+        bool fCheckSpendProofs = !fCheckpointed;
         BOOST_FOREACH(const CTransaction &tx, block.vtx) {
             // We don't check transactions against zerocoin state here, we'll check it again later in ConnectBlock
-            if (!CheckTransaction(tx, state, tx.GetHash(), isVerifyDB, nHeight, false, false, NULL, NULL)) {
+            if (!CheckTransaction(tx, state, tx.GetHash(), isVerifyDB, nHeight, false, false, NULL, NULL, fCheckSpendProofs)) {
                 LogPrintf("block=%s\n", block.ToString());
                 return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(),
                                  strprintf("Transaction check failed (tx hash %s) %s", tx.GetHash().ToString(),
@@ -4635,7 +4796,7 @@ static bool AcceptBlockHeader(const CBlockHeader &block, CValidationState &state
 //        int nHeight = ZerocoinGetNHeight(block);
 //        int64_t start = std::chrono::duration_cast<std::chrono::milliseconds>(
 //                std::chrono::system_clock::now().time_since_epoch()).count();
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), fCheckPOW))
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), fCheckPOW && !IsBlockCheckpointed(hash)))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(),
                          FormatStateMessage(state));
 //        int64_t end = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -4761,6 +4922,7 @@ bool ProcessNewBlock(CValidationState &state, const CChainParams &chainparams, C
     int nHeight = ZerocoinGetNHeight(pblock->GetBlockHeader());
     LogPrintf("ProcessNewBlock nHeight=%s, blockHash:%s\n", nHeight, pblock->GetHash().ToString());
     //    LogPrint("ProcessNewBlock", "block=%s", pblock->ToString());
+
     {
         LOCK(cs_main);
         bool fRequested = MarkBlockAsReceived(pblock->GetHash());
@@ -4869,6 +5031,7 @@ void PruneOneBlockFile(const int fileNumber) {
 void UnlinkPrunedFiles(std::set<int> &setFilesToPrune) {
     for (set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        UnmapBlockFile(*it);
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -5096,6 +5259,10 @@ bool static LoadBlockIndexDB() {
     pblocktree->ReadFlag("spentindex", fSpentIndex);
     LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
 
+    // Check whether we keep UTXO set statistics
+    pblocktree->ReadFlag("utxostatsindex", fUTXOStatsIndex);
+    LogPrintf("%s: UTXO set statistics %s\n", __func__, fUTXOStatsIndex ? "enabled" : "disabled");
+
 
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
@@ -5104,6 +5271,7 @@ bool static LoadBlockIndexDB() {
         return true;
     }
     chainActive.SetTip(it->second);
+    pindexTipSnapshot = it->second;
 
     PruneBlockIndexCandidates();
 
@@ -5171,7 +5339,7 @@ bool CVerifyDB::VerifyDB(const CChainParams &chainparams, CCoinsView *coinsview,
         }
         CBlock block;
         // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus(), !IsBlockCheckpointed(pindex->GetBlockHash())))
             return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight,
                          pindex->GetBlockHash().ToString());
         LogPrintf("VerifyDB->CheckBlock() nHeight=%s\n", pindex->nHeight);
@@ -5221,7 +5389,7 @@ bool CVerifyDB::VerifyDB(const CChainParams &chainparams, CCoinsView *coinsview,
                     chainActive.Height() - pindex->nHeight)) / (double) nCheckDepth * 50))));
             pindex = chainActive.Next(pindex);
             CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus(), !IsBlockCheckpointed(pindex->GetBlockHash())))
                 return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight,
                              pindex->GetBlockHash().ToString());
             if (!ConnectBlock(block, state, pindex, coins, chainparams))
@@ -5329,6 +5497,7 @@ void UnloadBlockIndex() {
     LOCK(cs_main);
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
+    pindexTipSnapshot = NULL;
     pindexBestInvalid = NULL;
     pindexBestHeader = NULL;
     mempool.clear();
@@ -5392,6 +5561,9 @@ bool InitBlockIndex(const CChainParams &chainparams) {
     fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
     pblocktree->WriteFlag("spentindex", fSpentIndex);
 
+    fUTXOStatsIndex = GetBoolArg("-utxostatsindex", DEFAULT_UTXOSTATSINDEX);
+    pblocktree->WriteFlag("utxostatsindex", fUTXOStatsIndex);
+
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -5419,51 +5591,58 @@ bool InitBlockIndex(const CChainParams &chainparams) {
     return true;
 }
 
+/** Height of an imported block's parent, for CBlockFileLoader */
+static int GetImportedBlockHeight(const uint256 &hash) {
+    LOCK(cs_main);
+    BlockMap::const_iterator mi = mapBlockIndex.find(hash);
+    return mi == mapBlockIndex.end() ? -1 : mi->second->nHeight;
+}
+
+/** Whether an imported block is checkpointed, for CBlockFileLoader */
+static bool IsImportedBlockCheckpointed(const uint256 &hash) {
+    LOCK(cs_main);
+    return IsBlockCheckpointed(hash);
+}
+
+/**
+ * Work on an imported block that doesn't depend on the chain state, run by the
+ * CBlockFileLoader workers: computing its Lyra2Z hash, which then is a lookup in
+ * the PoW hash cache when AcceptBlock checks the block under cs_main. Checks that
+ * read the chain state, the instantsend locks or the zerocoin and sigma state
+ * are all left to AcceptBlock.
+ */
+static void CheckImportedBlock(const CBlock &block, int nHeight, bool fCheckpointed) {
+    if (!fCheckpointed)
+        block.GetPoWHash(nHeight);
+}
+
 bool LoadExternalBlockFile(const CChainParams &chainparams, FILE *fileIn, CDiskBlockPos *dbp) {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
     LogPrintf("LoadExternalBlockFile...\n");
     static std::multimap <uint256, CDiskBlockPos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
+    // -loadblockthreads=0 means autodetect
+    int nThreads = GetArg("-loadblockthreads", DEFAULT_LOADBLOCK_THREADS);
+    if (nThreads <= 0)
+        nThreads += GetNumCores();
+    nThreads = std::max(nThreads, 1);
+
     int nLoaded = 0;
     try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE + 8, SER_DISK,
-                             CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        // This takes over fileIn and calls fclose() on it when done. Blocks are
+        // deserialized and hashed ahead on the loader's threads, and checked and
+        // connected here in file order.
+        CBlockFileLoader loader(fileIn, chainparams, GetImportedBlockHeight, IsImportedBlockCheckpointed,
+                                CheckImportedBlock, nThreads, nThreads * LOADBLOCK_WINDOW_PER_THREAD);
+        CBlockFileLoader::Entry entry;
+        while (loader.Next(entry)) {
             boost::this_thread::interruption_point();
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos() + 1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, chainparams.MessageStart(), MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
-                    continue;
-            } catch (const std::exception &) {
-                // no valid block header found; don't complain
-                break;
-            }
             try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
                 if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
+                    dbp->nPos = entry.nPos;
+                CBlock &block = entry.block;
 
                 // detect out of order blocks, and store them for later
                 uint256 hash = block.GetHash();
@@ -5477,6 +5656,7 @@ bool LoadExternalBlockFile(const CChainParams &chainparams, FILE *fileIn, CDiskB
                 }
                 // process in case the block isn't known yet
                 if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+                    LimitValidationInterfaceQueue();
                     LOCK(cs_main);
                     CValidationState state;
                     int nHeight = ZerocoinGetNHeight(block.GetBlockHeader());
@@ -5865,7 +6045,7 @@ bool static AlreadyHave(const CInv &inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
         case MSG_XNODE_PAYMENT_BLOCK:
         {
             BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
-            return mi != mapBlockIndex.end() && mnpayments.mapXnodeBlocks.find(mi->second->nHeight) != mnpayments.mapXnodeBlocks.end();
+            return mi != mapBlockIndex.end() && mnpayments.HasBlockPayees(mi->second->nHeight);
         }
 
         case MSG_XNODE_ANNOUNCE:
@@ -5942,11 +6122,18 @@ void static ProcessGetData(CNode *pfrom, const Consensus::Params &consensusParam
                 // Pruned nodes may have deleted the block, so check whether
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
+                    // Blocks are stored serialized with their witness data, and blocks from before segwit
+                    // activated have none, so these go out as the bytes on disk
+                    bool fRaw = inv.type == MSG_WITNESS_BLOCK ||
+                                (inv.type == MSG_BLOCK && !IsWitnessEnabled(mi->second->pprev, consensusParams));
                     // Send block from disk
                     CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
+                    CMappedRecord record;
+                    if (fRaw && ReadRawBlockFromDisk(record, mi->second))
+                        pfrom->PushMessageRaw(NetMsgType::BLOCK, record.pbegin, record.nSize);
+                    else if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
                         assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
+                    else if (inv.type == MSG_BLOCK)
                         pfrom->PushMessageWithFlag(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, block);
                     else if (inv.type == MSG_WITNESS_BLOCK)
                         pfrom->PushMessage(NetMsgType::BLOCK, block);
@@ -6132,8 +6319,9 @@ void static ProcessGetData(CNode *pfrom, const Consensus::Params &consensusParam
                 if (!pushed && inv.type == MSG_XNODE_PAYMENT_BLOCK) {
                     BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
                     LOCK(cs_mapXnodeBlocks);
-                    if (mi != mapBlockIndex.end() && mnpayments.mapXnodeBlocks.count(mi->second->nHeight)) {
-                        BOOST_FOREACH(CXnodePayee& payee, mnpayments.mapXnodeBlocks[mi->second->nHeight].vecPayees) {
+                    CXnodeBlockPayees* pblockPayees = mi != mapBlockIndex.end() ? mnpayments.GetBlockPayees(mi->second->nHeight) : NULL;
+                    if (pblockPayees) {
+                        BOOST_FOREACH(CXnodePayee& payee, pblockPayees->vecPayees) {
                             std::vector<uint256> vecVoteHashes = payee.GetVoteHashes();
                             BOOST_FOREACH(uint256& hash, vecVoteHashes) {
                                 if(mnpayments.HasVerifiedPaymentVote(hash)) {
@@ -6223,6 +6411,16 @@ uint32_t GetFetchFlags(CNode *pfrom, CBlockIndex *pprev, const Consensus::Params
     return nFetchFlags;
 }
 
+/** Hands a message of the GravityCoin modules to them */
+static void ProcessExtensionMessage(CNode *pfrom, std::string &strCommand, CDataStream &vRecv) {
+    darkSendPool.ProcessMessage(pfrom, strCommand, vRecv);
+    mnodeman.ProcessMessage(pfrom, strCommand, vRecv);
+    mnpayments.ProcessMessage(pfrom, strCommand, vRecv);
+    instantsend.ProcessMessage(pfrom, strCommand, vRecv);
+    sporkManager.ProcessSpork(pfrom, strCommand, vRecv);
+    xnodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+}
+
 bool static ProcessMessage(CNode *pfrom, string strCommand,
                            CDataStream &vRecv, int64_t nTimeReceived,
                            const CChainParams &chainparams) {
@@ -7297,6 +7495,9 @@ bool static ProcessMessage(CNode *pfrom, string strCommand,
                     return true;
                 }
             }
+            // Don't let validation run too far ahead of the wallets and other listeners
+            LimitValidationInterfaceQueue();
+
             CValidationState state;
             ProcessNewBlock(state, chainparams, pfrom, &block, true, NULL, false);
             // TODO: could send reject message if block is invalid?
@@ -7309,48 +7510,57 @@ bool static ProcessMessage(CNode *pfrom, string strCommand,
         BlockTransactions resp;
         vRecv >> resp;
 
-        LOCK(cs_main);
+        CBlock block;
+        bool fBlockRead = false;
+        {
+            LOCK(cs_main);
 
-        map < uint256, pair < NodeId, list<QueuedBlock>::iterator > > ::iterator
-        it = mapBlocksInFlight.find(resp.blockhash);
-        if (it == mapBlocksInFlight.end() || !it->second.second->partialBlock ||
-            it->second.first != pfrom->GetId()) {
+            map < uint256, pair < NodeId, list<QueuedBlock>::iterator > > ::iterator
+            it = mapBlocksInFlight.find(resp.blockhash);
+            if (it == mapBlocksInFlight.end() || !it->second.second->partialBlock ||
+                it->second.first != pfrom->GetId()) {
 //            LogPrint("net", "Peer %d sent us block transactions for block we weren't expecting\n", pfrom->id);
-            return true;
-        }
+                return true;
+            }
 
-        PartiallyDownloadedBlock &partialBlock = *it->second.second->partialBlock;
-        CBlock block;
-        ReadStatus status = partialBlock.FillBlock(block, resp.txn);
-        if (status == READ_STATUS_INVALID) {
-            MarkBlockAsReceived(resp.blockhash); // Reset in-flight state in case of whitelist
-            Misbehaving(pfrom->GetId(), 100);
+            PartiallyDownloadedBlock &partialBlock = *it->second.second->partialBlock;
+            ReadStatus status = partialBlock.FillBlock(block, resp.txn);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(resp.blockhash); // Reset in-flight state in case of whitelist
+                Misbehaving(pfrom->GetId(), 100);
 //            LogPrintf("Peer %d sent us invalid compact block/non-matching block transactions\n", pfrom->id);
-            return true;
-        } else if (status == READ_STATUS_FAILED) {
-            // Might have collided, fall back to getdata now :(
-            std::vector <CInv> invs;
-            invs.push_back(CInv(MSG_BLOCK | GetFetchFlags(pfrom, chainActive.Tip(), chainparams.GetConsensus()),
-                                resp.blockhash));
-            pfrom->PushMessage(NetMsgType::GETDATA, invs);
-        } else {
-            // Block is either okay, or possibly we received
-            // READ_STATUS_CHECKBLOCK_FAILED.
-            // Note that CheckBlock can only fail for one of a few reasons:
-            // 1. bad-proof-of-work (impossible here, because we've already
-            //    accepted the header)
-            // 2. merkleroot doesn't match the transactions given (already
-            //    caught in FillBlock with READ_STATUS_FAILED, so
-            //    impossible here)
-            // 3. the block is otherwise invalid (eg invalid coinbase,
-            //    block is too big, too many legacy sigops, etc).
-            // So if CheckBlock failed, #3 is the only possibility.
-            // Under BIP 152, we don't DoS-ban unless proof of work is
-            // invalid (we don't require all the stateless checks to have
-            // been run).  This is handled below, so just treat this as
-            // though the block was successfully read, and rely on the
-            // handling in ProcessNewBlock to ensure the block index is
-            // updated, reject messages go out, etc.
+                return true;
+            } else if (status == READ_STATUS_FAILED) {
+                // Might have collided, fall back to getdata now :(
+                std::vector <CInv> invs;
+                invs.push_back(CInv(MSG_BLOCK | GetFetchFlags(pfrom, chainActive.Tip(), chainparams.GetConsensus()),
+                                    resp.blockhash));
+                pfrom->PushMessage(NetMsgType::GETDATA, invs);
+            } else {
+                // Block is either okay, or possibly we received
+                // READ_STATUS_CHECKBLOCK_FAILED.
+                // Note that CheckBlock can only fail for one of a few reasons:
+                // 1. bad-proof-of-work (impossible here, because we've already
+                //    accepted the header)
+                // 2. merkleroot doesn't match the transactions given (already
+                //    caught in FillBlock with READ_STATUS_FAILED, so
+                //    impossible here)
+                // 3. the block is otherwise invalid (eg invalid coinbase,
+                //    block is too big, too many legacy sigops, etc).
+                // So if CheckBlock failed, #3 is the only possibility.
+                // Under BIP 152, we don't DoS-ban unless proof of work is
+                // invalid (we don't require all the stateless checks to have
+                // been run).  This is handled below, so just treat this as
+                // though the block was successfully read, and rely on the
+                // handling in ProcessNewBlock to ensure the block index is
+                // updated, reject messages go out, etc.
+                fBlockRead = true;
+            }
+        } // Don't hold cs_main when calling into ProcessNewBlock, which may wait for the listeners
+        if (fBlockRead) {
+            // Don't let validation run too far ahead of the wallets and other listeners
+            LimitValidationInterfaceQueue();
+
             CValidationState state;
             // BIP 152 permits peers to relay compact blocks after validating
             // the header only; we should not punish peers if the block turns
@@ -7538,6 +7748,8 @@ bool static ProcessMessage(CNode *pfrom, string strCommand,
         // conditions in AcceptBlock().
 //        int nHeight = ZerocoinGetNHeight(block.GetBlockHeader());
         bool forceProcessing = pfrom->fWhitelisted && !IsInitialBlockDownload();
+        // Don't let validation run too far ahead of the wallets and other listeners
+        LimitValidationInterfaceQueue();
         ProcessNewBlock(state, chainparams, pfrom, &block, forceProcessing, NULL, true);
         int nDoS;
         if (state.IsInvalid(nDoS)) {
@@ -7749,12 +7961,11 @@ bool static ProcessMessage(CNode *pfrom, string strCommand,
 
         if (found) {
             //probably one the extensions
-            darkSendPool.ProcessMessage(pfrom, strCommand, vRecv);
-            mnodeman.ProcessMessage(pfrom, strCommand, vRecv);
-            mnpayments.ProcessMessage(pfrom, strCommand, vRecv);
-            instantsend.ProcessMessage(pfrom, strCommand, vRecv);
-            sporkManager.ProcessSpork(pfrom, strCommand, vRecv);
-            xnodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+            // Signed xnode messages have their signatures verified on the
+            // pool first, ProcessMessages processes them later, together
+            // with the peer's messages that arrived after them
+            if (!xnodeSigCheckPool.Push(pfrom, strCommand, vRecv))
+                ProcessExtensionMessage(pfrom, strCommand, vRecv);
         } else {
             // Ignore unknown commands for extensibility
             LogPrint("net", "Unknown command \"%s\" from peer=%d\n", SanitizeString(strCommand), pfrom->id);
@@ -7766,6 +7977,9 @@ bool static ProcessMessage(CNode *pfrom, string strCommand,
 // requires LOCK(cs_vRecvMsg)
 bool ProcessMessages(CNode *pfrom) {
     const CChainParams &chainparams = Params();
+
+    // Xnode messages of any peer whose signatures were verified meanwhile
+    xnodeSigCheckPool.ProcessResults(ProcessExtensionMessage);
     //
     // Message format
     //  (4) message start
@@ -8437,6 +8651,189 @@ ThresholdState VersionBitsTipState(const Consensus::Params &params, Consensus::D
     return VersionBitsState(chainActive.Tip(), params, pos, versionbitscache);
 }
 
+static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+/** Number of transactions LoadMempool accepts under a single lock of cs_main */
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 100;
+
+static std::atomic<bool> fMempoolLoading(false);
+static std::atomic<int64_t> nMempoolLoadProcessed(0);
+static std::atomic<int64_t> nMempoolLoadTotal(0);
+
+namespace {
+
+struct MempoolDumpEntry {
+    CTransaction tx;
+    int64_t nTime;
+    // Transaction was in the stem phase of Dandelion and only known to the stempool
+    bool fStem;
+};
+
+}
+
+bool LoadMempool()
+{
+    int64_t nExpiryTimeout = GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+    FILE* filestr = fopen((GetDataDir() / "mempool.dat").string().c_str(), "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
+        return false;
+    }
+
+    std::vector<MempoolDumpEntry> vEntries;
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != MEMPOOL_DUMP_VERSION) {
+            return false;
+        }
+
+        // mempool transactions first, then the ones only known to the stempool, both in dependency order
+        for (bool fStem : {false, true}) {
+            uint64_t num;
+            file >> num;
+            while (num--) {
+                MempoolDumpEntry entry;
+                file >> entry.tx;
+                file >> entry.nTime;
+                entry.fStem = fStem;
+                vEntries.push_back(entry);
+            }
+        }
+        file >> mapDeltas;
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    // Fee deltas have to be in place before the transactions are accepted so they are taken into account
+    for (const auto& i : mapDeltas) {
+        mempool.PrioritiseTransaction(i.first, i.first.ToString(), i.second.first, i.second.second);
+        // Changes to mempool should also be made to Dandelion stempool
+        stempool.PrioritiseTransaction(i.first, i.first.ToString(), i.second.first, i.second.second);
+    }
+
+    nMempoolLoadProcessed = 0;
+    nMempoolLoadTotal = vEntries.size();
+    fMempoolLoading = true;
+
+    int64_t count = 0;
+    int64_t skipped = 0;
+    int64_t failed = 0;
+    int64_t nNow = GetTime();
+    const Consensus::Params& consensus = Params().GetConsensus();
+
+    for (size_t nBatch = 0; nBatch < vEntries.size(); nBatch += MEMPOOL_LOAD_BATCH_SIZE) {
+        if (ShutdownRequested()) {
+            fMempoolLoading = false;
+            return false;
+        }
+
+        LOCK(cs_main);
+        for (size_t i = nBatch; i < std::min(nBatch + MEMPOOL_LOAD_BATCH_SIZE, vEntries.size()); i++) {
+            const MempoolDumpEntry& entry = vEntries[i];
+            nMempoolLoadProcessed++;
+
+            if (entry.nTime + nExpiryTimeout <= nNow) {
+                ++skipped;
+                continue;
+            }
+
+            CValidationState state;
+            if (entry.fStem) {
+                if (AcceptToMemoryPoolWithTime(stempool, state, entry.tx, true, true, NULL, entry.nTime,
+                        false, 0, false, false)) {
+                    // Embargo could not survive the restart, start a new one so the transaction still gets fluffed
+                    int64_t nCurrTime = GetTimeMicros();
+                    int64_t nEmbargo = 1000000 * consensus.nDandelionEmbargoMinimum +
+                        PoissonNextSend(nCurrTime, consensus.nDandelionEmbargoAvgAdd);
+                    CNode::insertDandelionEmbargo(entry.tx.GetHash(), nEmbargo);
+                    ++count;
+                } else {
+                    ++failed;
+                }
+                continue;
+            }
+
+            if (AcceptToMemoryPoolWithTime(mempool, state, entry.tx, true, true, NULL, entry.nTime)) {
+                // Changes to mempool should also be made to Dandelion stempool. Sigma proofs verified for the
+                // mempool above are not verified again.
+                CValidationState dummyState;
+                AcceptToMemoryPoolWithTime(stempool, dummyState, entry.tx, true, true, NULL, entry.nTime,
+                    false, 0, false, false);
+                ++count;
+            } else {
+                ++failed;
+            }
+        }
+    }
+
+    fMempoolLoading = false;
+    LogPrintf("Imported mempool transactions from disk: %i successes, %i failed, %i expired\n", count, failed, skipped);
+    return true;
+}
+
+bool DumpMempool()
+{
+    int64_t start = GetTimeMicros();
+
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    std::vector<TxMempoolInfo> vinfo;
+    std::vector<TxMempoolInfo> vinfoStem;
+
+    {
+        LOCK(mempool.cs);
+        mapDeltas = mempool.mapDeltas;
+        vinfo = mempool.infoAll();
+    }
+    // Only the transactions still in the stem phase, everything else is in the mempool as well
+    for (const TxMempoolInfo& info : stempool.infoAll()) {
+        if (!mempool.exists(info.tx->GetHash()))
+            vinfoStem.push_back(info);
+    }
+
+    int64_t mid = GetTimeMicros();
+
+    try {
+        FILE* filestr = fopen((GetDataDir() / "mempool.dat.new").string().c_str(), "wb");
+        if (!filestr) {
+            return false;
+        }
+
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+
+        uint64_t version = MEMPOOL_DUMP_VERSION;
+        file << version;
+
+        for (const std::vector<TxMempoolInfo>* pvinfo : {&vinfo, &vinfoStem}) {
+            file << (uint64_t)pvinfo->size();
+            for (const auto& i : *pvinfo) {
+                file << *(i.tx);
+                file << (int64_t)i.nTime;
+            }
+        }
+
+        file << mapDeltas;
+        FileCommit(file.Get());
+        file.fclose();
+        RenameOver(GetDataDir() / "mempool.dat.new", GetDataDir() / "mempool.dat");
+        int64_t last = GetTimeMicros();
+        LogPrintf("Dumped mempool: %gs to copy, %gs to dump\n", (mid-start)*0.000001, (last-mid)*0.000001);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump mempool: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    return true;
+}
+
+bool GetMempoolLoadProgress(int64_t& nProcessed, int64_t& nTotal)
+{
+    nProcessed = nMempoolLoadProcessed;
+    nTotal = nMempoolLoadTotal;
+    return fMempoolLoading;
+}
+
 class CMainCleanup {
 public:
     CMainCleanup() {}
@@ -36,6 +36,7 @@
 #include <boost/unordered_map.hpp>
 
 class CBlockIndex;
+struct CMappedRecord;
 class CBlockTreeDB;
 class CBloomFilter;
 class CChainParams;
@@ -79,6 +80,8 @@ static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
 static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
+/** Default for -persistmempool */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
 /** The maximum size of a blk?????.dat, btzc:GravityCoin: 128 MiB */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB;
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8), btzc:GravityCoin: 16MiB */
@@ -93,6 +96,10 @@ static const unsigned int DEFAULT_BLOCK_PRIORITY_SIZE = 50000; // 50KB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -loadblockthreads default (number of threads checking blocks during -reindex and -loadblock, 0 = auto) */
+static const int DEFAULT_LOADBLOCK_THREADS = 0;
+/** Number of blocks read ahead of the one being connected during -reindex and -loadblock, per checking thread */
+static const int LOADBLOCK_WINDOW_PER_THREAD = 8;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 2000;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -146,6 +153,7 @@ static const bool DEFAULT_TXINDEX = true;
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_ADDRESSINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
+static const bool DEFAULT_UTXOSTATSINDEX = false;
 static const bool DEFAULT_TOR_SETUP = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
@@ -186,6 +194,7 @@ extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fUTXOStatsIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
@@ -344,6 +353,29 @@ bool AcceptToMemoryPool(
         bool isCheckWalletTransaction = false,
         bool markGravityCoinSpendTransactionSerial = true);
 
+/** (try to) add transaction to memory pool with a specified acceptance time **/
+bool AcceptToMemoryPoolWithTime(
+        CTxMemPool& pool,
+        CValidationState &state,
+        const CTransaction &tx,
+        bool fCheckInputs,
+        bool fLimitFree,
+        bool* pfMissingInputs,
+        int64_t nAcceptTime,
+        bool fOverrideMempoolLimit=false,
+        const CAmount nAbsurdFee=0,
+        bool isCheckWalletTransaction = false,
+        bool markGravityCoinSpendTransactionSerial = true);
+
+/** Dump the mempool and the Dandelion stempool to disk. */
+bool DumpMempool();
+
+/** Load the mempool and the Dandelion stempool from disk. */
+bool LoadMempool();
+
+/** Report how far LoadMempool got, returns true while it is still running */
+bool GetMempoolLoadProgress(int64_t& nProcessed, int64_t& nTotal);
+
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
 
@@ -397,7 +429,8 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight);
 
 /** Context-independent validity checks */
 //BTZC: ADD params for GravityCoin works
-bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 hashTx, bool isVerifyDB, int nHeight = INT_MAX, bool isCheckWallet = false, bool fStatefulZerocoinCheck = true, CZerocoinTxInfo *zerocoinTxInfo = NULL, sigma::CSigmaTxInfo *sigmaTxInfo = NULL);
+//fCheckSpendProofs=false skips verifying the zero-knowledge proofs of zerocoin and sigma spends, but still records their serials
+bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 hashTx, bool isVerifyDB, int nHeight = INT_MAX, bool isCheckWallet = false, bool fStatefulZerocoinCheck = true, CZerocoinTxInfo *zerocoinTxInfo = NULL, sigma::CSigmaTxInfo *sigmaTxInfo = NULL, bool fCheckSpendProofs = true);
 /**
  * Check if transaction is final and can be included in a block with the
  * specified height and time. Consensus critical.
@@ -496,13 +529,26 @@ bool GetAddressUnspent(uint160 addressHash, AddressType type,
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams);
-bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams, bool fCheckPOW = true);
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, bool fCheckPOW = true);
+/** Read a block whose header was already validated when it was added to the index, checking it
+ *  against the indexed hash instead of recomputing the proof of work. Safe to call from any thread. */
+bool ReadIndexedBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
+/** Look up the serialized block of pindex as it is stored, without deserializing it, checking its
+ *  header against the indexed hash. Fails if the block file can't be mapped. */
+bool ReadRawBlockFromDisk(CMappedRecord& record, const CBlockIndex* pindex);
 
 /** Functions for validating blocks and updating the block tree */
 
 /** Context-independent validity checks */
-bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true);
+bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, int nHeight = INT_MAX);
+/**
+ * Whether the block is an ancestor of the last checkpoint. Its proof of work
+ * and the proofs of its zerocoin and sigma spends are then assumed valid, like
+ * its scripts. Only with -checkpoints. Requires cs_main; callers that check
+ * blocks without it are passed the result.
+ */
+bool IsBlockCheckpointed(const uint256& hash);
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, int nHeight = INT_MAX, bool isVerifyDB = false);
 
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx, CTransaction& tx);
@@ -575,6 +621,14 @@ bool ResetBlockFailureFlags(CBlockIndex *pindex);
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain chainActive;
 
+/**
+ * Tip of chainActive, for callers that only need its height or hash and
+ * should not wait for cs_main. May lag behind chainActive while a block is
+ * being connected. Block indexes are not freed while running, so the result
+ * stays valid.
+ */
+const CBlockIndex* GetChainTipSnapshot();
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
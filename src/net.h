@@ -639,6 +639,22 @@ public:
         }
     }
 
+    /** Send a message whose payload is already serialized. */
+    void PushMessageRaw(const char* pszCommand, const char* pch, size_t nSize)
+    {
+        try
+        {
+            BeginMessage(pszCommand);
+            ssSend.write(pch, nSize);
+            EndMessage(pszCommand);
+        }
+        catch (...)
+        {
+            AbortMessage();
+            throw;
+        }
+    }
+
     /** Send a message containing a1, serialized with flag flag. */
     template<typename T1>
     void PushMessageWithFlag(int flag, const char* pszCommand, const T1& a1)
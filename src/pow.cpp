@@ -17,6 +17,17 @@
 #include "fixed.h"
 
 static CBigNum bnProofOfWorkLimit(~arith_uint256(0) >> 12);
+static const arith_uint256 nProofOfWorkLimit = ~arith_uint256(0) >> 12;
+
+static const uint32_t BlocksTargetSpacing = 150; // 2.5 minutes
+static const unsigned int TimeDaySeconds = 60 * 60 * 24;
+static const int64_t PastSecondsMin = TimeDaySeconds / 288; // 300 secs
+static const int64_t PastSecondsMax = TimeDaySeconds / 2;// 43200 secs
+static const uint32_t PastBlocksMin = PastSecondsMin / BlocksTargetSpacing; // 2 blocks
+static const uint32_t PastBlocksMax = PastSecondsMax / BlocksTargetSpacing; // 288 blocks
+
+static unsigned int BorisRidiculouslyNamedDifficultyFunctionBigNum(const CBlockIndex *pindexLast, uint32_t TargetBlocksSpacingSeconds,
+                                         uint32_t PastBlocksMin, uint32_t PastBlocksMax);
 
 double GetDifficultyHelper(unsigned int nBits) {
     int nShift = (nBits >> 24) & 0xff;
@@ -41,20 +52,32 @@ unsigned int GetNextWorkRequired(const CBlockIndex *pindexLast, const CBlockHead
         return bnProofOfWorkLimit.GetCompact();
     }
 
-    static const uint32_t BlocksTargetSpacing = 150; // 2.5 minutes
-    unsigned int TimeDaySeconds = 60 * 60 * 24;
-    int64_t PastSecondsMin = TimeDaySeconds / 288; // 300 secs
-    int64_t PastSecondsMax = TimeDaySeconds / 2;// 43200 secs
-    uint32_t PastBlocksMin = PastSecondsMin / BlocksTargetSpacing; // 2 blocks
-    uint32_t PastBlocksMax = PastSecondsMax / BlocksTargetSpacing; // 288 blocks
+    if ((pindexLast->nHeight + 1) % params.DifficultyAdjustmentInterval() != 0) // Retarget every nInterval blocks
+    {
+        return pindexLast->nBits;
+    }
 
+    // Only depends on the chain up to pindexLast, so it's computed once per
+    // block. Threads racing to fill it in compute the same value.
+    unsigned int nNextWorkRequired = pindexLast->nNextWorkRequired.Get();
+    if (nNextWorkRequired == 0) {
+        nNextWorkRequired = BorisRidiculouslyNamedDifficultyFunction(pindexLast, BlocksTargetSpacing, PastBlocksMin, PastBlocksMax);
+        pindexLast->nNextWorkRequired.Set(nNextWorkRequired);
+    }
+    return nNextWorkRequired;
+}
 
-    if ((pindexLast->nHeight + 1) % params.DifficultyAdjustmentInterval() != 0) // Retarget every nInterval blocks
+unsigned int GetNextWorkRequiredBigNum(const CBlockIndex *pindexLast, const Consensus::Params &params) {
+    if (pindexLast == NULL) {
+        return bnProofOfWorkLimit.GetCompact();
+    }
+
+    if ((pindexLast->nHeight + 1) % params.DifficultyAdjustmentInterval() != 0)
     {
         return pindexLast->nBits;
     }
 
-    return BorisRidiculouslyNamedDifficultyFunction(pindexLast, BlocksTargetSpacing, PastBlocksMin, PastBlocksMax);
+    return BorisRidiculouslyNamedDifficultyFunctionBigNum(pindexLast, BlocksTargetSpacing, PastBlocksMin, PastBlocksMax);
 }
 
 unsigned int CalculateNextWorkRequired(const CBlockIndex *pindexLast, int64_t nFirstBlockTime, const Consensus::Params &params) {
@@ -97,8 +120,24 @@ bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params
     return true;
 }
 
-unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexLast, uint32_t TargetBlocksSpacingSeconds,
-                                         uint32_t PastBlocksMin, uint32_t PastBlocksMax) {
+namespace {
+
+/** The blocks the retarget averages over, and how long they took */
+struct RetargetWindow
+{
+    uint32_t nPastBlocks;
+    int32_t nActualSeconds;
+    int32_t nTargetSeconds;
+};
+
+/**
+ * Walks back from pindexLast until the mean block time of the blocks walked
+ * leaves the band given by the limit tables, or PastBlocksMax blocks have been
+ * walked. This only looks at block times, the targets of the blocks walked are
+ * averaged separately.
+ */
+RetargetWindow GetRetargetWindow(const CBlockIndex *pindexLast, uint32_t TargetBlocksSpacingSeconds,
+                                 uint32_t PastBlocksMin, uint32_t PastBlocksMax) {
 
     const CBlockIndex *BlockLastSolved = pindexLast;
     const CBlockIndex *BlockReading = pindexLast;
@@ -109,10 +148,8 @@ unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexL
     int32_t nActualSeconds = 0;
     int32_t nTargetSeconds = 0;
     fixed nBlockTimeRatio = 1;
-    CBigNum bnPastTargetAverage;
-    CBigNum bnPastTargetAveragePrev;
 
-    float FastBlocksLimit[5040] = {317.772675, 136.233047, 83.194504, 58.732189, 44.894745, 36.089561, 30.038040,
+    static const float FastBlocksLimit[5040] = {317.772675, 136.233047, 83.194504, 58.732189, 44.894745, 36.089561, 30.038040,
                                    25.646383, 22.327398, 19.739056, 17.669304, 15.980045, 14.577670, 13.396597,
                                    12.389578, 11.521759, 10.766892, 10.104856, 9.519974, 8.999868, 8.534638, 8.116274,
                                    7.738231, 7.395114, 7.082433, 6.796428, 6.533921, 6.292217, 6.069008, 5.862312,
@@ -743,7 +780,7 @@ unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexL
                                    1.009036, 1.009034, 1.009031, 1.009029, 1.009027, 1.009025, 1.009022, 1.009020,
                                    1.009018, 1.009016, 1.009014, 1.009012, 1.009009, 1.009007, 1.009005, 1.009003,
                                    1.009001, 1.008998};
-    float SlowBlocksLimit[5040] = {0.003147, 0.007340, 0.012020, 0.017026, 0.022274, 0.027709, 0.033291, 0.038992,
+    static const float SlowBlocksLimit[5040] = {0.003147, 0.007340, 0.012020, 0.017026, 0.022274, 0.027709, 0.033291, 0.038992,
                                    0.044788, 0.050661, 0.056595, 0.062578, 0.068598, 0.074646, 0.080713, 0.086792,
                                    0.092877, 0.098962, 0.105042, 0.111113, 0.117170, 0.123209, 0.129229, 0.135224,
                                    0.141194, 0.147136, 0.153047, 0.158927, 0.164772, 0.170581, 0.176354, 0.182089,
@@ -1374,23 +1411,11 @@ unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexL
                                    0.991050, 0.991052, 0.991054, 0.991056, 0.991058, 0.991060, 0.991062, 0.991065,
                                    0.991067, 0.991069, 0.991071, 0.991073, 0.991075, 0.991078, 0.991080, 0.991082};
 
-    if (BlockLastSolved == NULL || BlockLastSolved->nHeight == 0 ||
-        (uint64_t) BlockLastSolved->nHeight < PastBlocksMin) { return pindexLast->nBits; }
-
-
     for (unsigned int i = 1; BlockReading && BlockReading->nHeight > 0; i++) {
 
         if (PastBlocksMax > 0 && i > PastBlocksMax) { break; }
         nPastBlocks++;
 
-        if (i == 1) { bnPastTargetAverage.SetCompact(BlockReading->nBits); }
-
-        else {
-            bnPastTargetAverage = ((CBigNum().SetCompact(BlockReading->nBits) - bnPastTargetAveragePrev) / i) +
-                                  bnPastTargetAveragePrev;
-        }
-        bnPastTargetAveragePrev = bnPastTargetAverage;
-
         nActualSeconds = BlockLastSolved->GetBlockTime() - BlockReading->GetBlockTime();
         nTargetSeconds = TargetBlocksSpacingSeconds * nPastBlocks;
         nBlockTimeRatio = 1;
@@ -1417,6 +1442,107 @@ unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexL
         BlockReading = BlockReading->pprev;
     }
 
+    RetargetWindow window;
+    window.nPastBlocks = nPastBlocks;
+    window.nActualSeconds = nActualSeconds;
+    window.nTargetSeconds = nTargetSeconds;
+    return window;
+}
+
+}
+
+unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexLast, uint32_t TargetBlocksSpacingSeconds,
+                                         uint32_t PastBlocksMin, uint32_t PastBlocksMax) {
+
+    const CBlockIndex *BlockLastSolved = pindexLast;
+
+    if (BlockLastSolved == NULL || BlockLastSolved->nHeight == 0 ||
+        (uint64_t) BlockLastSolved->nHeight < PastBlocksMin) { return pindexLast->nBits; }
+
+    RetargetWindow window = GetRetargetWindow(pindexLast, TargetBlocksSpacingSeconds, PastBlocksMin, PastBlocksMax);
+    int32_t nActualSeconds = window.nActualSeconds;
+    int32_t nTargetSeconds = window.nTargetSeconds;
+
+    // Running average of the past targets. Each step is rounded toward zero,
+    // as the signed CBigNum arithmetic this replaces did.
+    arith_uint256 bnPastTargetAverage;
+    const CBlockIndex *BlockReading = pindexLast;
+    for (unsigned int i = 1; i <= window.nPastBlocks; i++) {
+        arith_uint256 bnTarget;
+        bnTarget.SetCompact(BlockReading->nBits);
+        if (i == 1) {
+            bnPastTargetAverage = bnTarget;
+        } else if (bnTarget >= bnPastTargetAverage) {
+            bnTarget -= bnPastTargetAverage;
+            bnTarget.DivMod(i);
+            bnPastTargetAverage += bnTarget;
+        } else {
+            arith_uint256 bnDelta = bnPastTargetAverage - bnTarget;
+            bnDelta.DivMod(i);
+            bnPastTargetAverage -= bnDelta;
+        }
+        BlockReading = BlockReading->pprev;
+    }
+
+    // Limit range of bnPastTargetAverage to a halving or doubling from most recent block target
+    arith_uint256 bnLastTarget;
+    bnLastTarget.SetCompact(BlockLastSolved->nBits);
+    if (bnPastTargetAverage < (bnLastTarget >> 1)) {
+        bnPastTargetAverage = bnLastTarget >> 1;
+    }
+    if (bnPastTargetAverage > (bnLastTarget << 1)) {
+        bnPastTargetAverage = bnLastTarget << 1;
+    }
+
+    arith_uint256 bnNew(bnPastTargetAverage);
+
+    if (nActualSeconds != 0 && nTargetSeconds != 0) {
+
+        if (nActualSeconds > 3 * nTargetSeconds) {
+            nActualSeconds = 3 * nTargetSeconds;
+        } // Maximal difficulty decrease of /3 from constrained past average
+        if (nActualSeconds < nTargetSeconds / 3) {
+            nActualSeconds = nTargetSeconds / 3;
+        } // Maximal difficulty increase of x3 from constrained past average
+
+        // bnNew * nActualSeconds / nTargetSeconds, dividing first so the product can't overflow
+        uint64_t nRemainder = bnNew.DivMod(nTargetSeconds);
+        bnNew *= (uint32_t) nActualSeconds;
+        bnNew += nRemainder * nActualSeconds / nTargetSeconds;
+    }
+
+
+    if (bnNew > nProofOfWorkLimit) { bnNew = nProofOfWorkLimit; }
+
+    return bnNew.GetCompact();
+}
+
+static unsigned int BorisRidiculouslyNamedDifficultyFunctionBigNum(const CBlockIndex *pindexLast, uint32_t TargetBlocksSpacingSeconds,
+                                         uint32_t PastBlocksMin, uint32_t PastBlocksMax) {
+
+    const CBlockIndex *BlockLastSolved = pindexLast;
+
+    if (BlockLastSolved == NULL || BlockLastSolved->nHeight == 0 ||
+        (uint64_t) BlockLastSolved->nHeight < PastBlocksMin) { return pindexLast->nBits; }
+
+    RetargetWindow window = GetRetargetWindow(pindexLast, TargetBlocksSpacingSeconds, PastBlocksMin, PastBlocksMax);
+    int32_t nActualSeconds = window.nActualSeconds;
+    int32_t nTargetSeconds = window.nTargetSeconds;
+
+    CBigNum bnPastTargetAverage;
+    CBigNum bnPastTargetAveragePrev;
+    const CBlockIndex *BlockReading = pindexLast;
+    for (unsigned int i = 1; i <= window.nPastBlocks; i++) {
+        if (i == 1) { bnPastTargetAverage.SetCompact(BlockReading->nBits); }
+
+        else {
+            bnPastTargetAverage = ((CBigNum().SetCompact(BlockReading->nBits) - bnPastTargetAveragePrev) / i) +
+                                  bnPastTargetAveragePrev;
+        }
+        bnPastTargetAveragePrev = bnPastTargetAverage;
+        BlockReading = BlockReading->pprev;
+    }
+
     // Limit range of bnPastTargetAverage to a halving or doubling from most recent block target
     if (bnPastTargetAverage < (CBigNum().SetCompact(BlockLastSolved->nBits) / 2)) {
         bnPastTargetAverage = CBigNum().SetCompact(BlockLastSolved->nBits) / 2;
@@ -1443,20 +1569,65 @@ unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexL
 
     if (bnNew > bnProofOfWorkLimit) { bnNew = bnProofOfWorkLimit; }
 
+    return bnNew.GetCompact();
+}
+
+bool RetargetSanityCheck()
+{
+    // Deterministic chains covering steady, fast, slow and erratic block
+    // times, and targets from well below up to the proof of work limit
+    struct Scenario
+    {
+        uint32_t nMinSpacing;
+        uint32_t nMaxSpacing;
+        uint32_t nMinExponent;
+        uint32_t nMaxExponent;
+    };
+    static const Scenario scenarios[] = {
+        {140, 160, 0x1c, 0x1d},
+        {1, 30, 0x1b, 0x1e},
+        {600, 3000, 0x1d, 0x1f},
+        {0, 1000, 0x1b, 0x1f},
+        {150, 150, 0x1f, 0x1f},
+    };
+    static const int nChainLength = 320;
+    static const int nCheckEvery = 5;
 
-    // debug print
-//    printf("*********************************************************************************\n");
-//    printf("Difficulty Retarget - Boris's Ridiculously Named Difficulty Function\n");
-//    printf("nHeight = %i\n", pindexLast->nHeight);
-//    printf("nPastBlocks = %u\n", nPastBlocks);
-//    printf("nBlockTimeRatio Target/Actual = %.4f\n", nBlockTimeRatio.to_float());
-//    printf("Mean blocktime = %.1fs\n", TargetBlocksSpacingSeconds / nBlockTimeRatio.to_float());
-//    printf("SlowBlocksLimit = %.4f\n", SlowBlocksLimit[nPastBlocks - 1]);
-//    printf("FastBlocksLimit = %.4f\n", FastBlocksLimit[nPastBlocks - 1]);
-//    printf("Before: %08x %.8f\n", BlockLastSolved->nBits, GetDifficultyHelper(BlockLastSolved->nBits));
-//    printf("After: %08x %.8f\n", bnNew.GetCompact(), GetDifficultyHelper(bnNew.GetCompact()));
-//    printf("Ratio After/Before: %.8f\n", GetDifficultyHelper(bnNew.GetCompact()) / GetDifficultyHelper(BlockLastSolved->nBits));
-//    printf("*********************************************************************************\n");
+    uint64_t nRand = 0x9e3779b97f4a7c15ULL;
+    for (unsigned int s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        const Scenario& scenario = scenarios[s];
+        std::vector<CBlockIndex> vChain(nChainLength);
+        uint32_t nTime = 1500000000;
+        for (int i = 0; i < nChainLength; i++) {
+            nRand = nRand * 6364136223846793005ULL + 1442695040888963407ULL;
+            uint32_t nRand32 = nRand >> 32;
+            // Block times may go backwards a little, as they do on the real chain
+            nTime += scenario.nMinSpacing + nRand32 % (scenario.nMaxSpacing - scenario.nMinSpacing + 1);
+            if (nRand32 % 7 == 0)
+                nTime -= nRand32 % 60;
+            uint32_t nExponent = scenario.nMinExponent + (nRand32 >> 8) % (scenario.nMaxExponent - scenario.nMinExponent + 1);
+            uint32_t nMantissa = (uint32_t)(nRand & 0x7fffff) | 0x008000;
+            // Clamp to the limit, so the targets are ones the chain can have
+            arith_uint256 bnTarget;
+            bnTarget.SetCompact((nExponent << 24) | nMantissa);
+            if (bnTarget > nProofOfWorkLimit)
+                bnTarget = nProofOfWorkLimit;
 
-    return bnNew.GetCompact();
+            vChain[i].nHeight = i;
+            vChain[i].nTime = nTime;
+            vChain[i].nBits = bnTarget.GetCompact();
+            vChain[i].pprev = i > 0 ? &vChain[i - 1] : NULL;
+        }
+
+        for (int i = 1; i < nChainLength; i += nCheckEvery) {
+            unsigned int nBits = BorisRidiculouslyNamedDifficultyFunction(&vChain[i], BlocksTargetSpacing, PastBlocksMin, PastBlocksMax);
+            unsigned int nBitsBigNum = BorisRidiculouslyNamedDifficultyFunctionBigNum(&vChain[i], BlocksTargetSpacing, PastBlocksMin, PastBlocksMax);
+            if (nBits != nBitsBigNum) {
+                LogPrintf("%s: scenario %u, height %d: retarget %08x, legacy bignum retarget %08x\n", __func__, s, i, nBits, nBitsBigNum);
+                return false;
+            }
+        }
+    }
+
+    return true;
 }
@@ -18,6 +18,19 @@ class uint256;
 
 unsigned int GetNextWorkRequired(const CBlockIndex *pindexLast, const CBlockHeader *pblock, const Consensus::Params&);
 
+/**
+ * Same as GetNextWorkRequired, but computed with the CBigNum arithmetic the
+ * retarget used to be done with, and never memoized. Only for verifying the
+ * fixed width arithmetic against it.
+ */
+unsigned int GetNextWorkRequiredBigNum(const CBlockIndex *pindexLast, const Consensus::Params&);
+
+/**
+ * Checks on fixed, generated chains that the retarget computes the same
+ * difficulty as the CBigNum arithmetic it used to be done with.
+ */
+bool RetargetSanityCheck();
+
 unsigned int CalculateNextWorkRequired(const CBlockIndex *pindexLast, int64_t nFirstBlockTime, const Consensus::Params&);
 
 unsigned int BorisRidiculouslyNamedDifficultyFunction(const CBlockIndex *pindexLast, uint32_t TargetBlocksSpacingSeconds,
@@ -15,6 +15,7 @@
 #include "crypto/scrypt.h"
 #include "crypto/Lyra2Z/Lyra2Z.h"
 #include "crypto/Lyra2Z/Lyra2.h"
+#include "sync.h"
 #include "util.h"
 #include <iostream>
 #include <chrono>
@@ -23,6 +24,8 @@
 #include <string>
 #include "precomputed_hash.h"
 
+// mapPoWHash is filled from the threads checking blocks during -reindex and -loadblock too
+static CCriticalSection cs_mapPoWHash;
 
 uint256 CBlockHeader::GetHash() const {
     return SerializeHash(*this);
@@ -33,6 +36,7 @@ uint256 CBlockHeader::GetPoWHash(int nHeight, bool forceCalc) const {
 //            std::chrono::system_clock::now().time_since_epoch()).count();
     bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
     if (!fTestNet) {
+        LOCK(cs_mapPoWHash);
         if (nHeight < 0) {
             if (!mapPoWHash.count(1)) {
 //            std::cout << "Start Build Map" << std::endl;
@@ -56,12 +60,16 @@ uint256 CBlockHeader::GetPoWHash(int nHeight, bool forceCalc) const {
 //    int64_t end = std::chrono::duration_cast<std::chrono::milliseconds>(
 //            std::chrono::system_clock::now().time_since_epoch()).count();
 //    std::cout << "GetPowHash nHeight=" << nHeight << ", hash= " << powHash.ToString() << " done in= " << (end - start) << " miliseconds" << std::endl;
-    mapPoWHash.insert(make_pair(nHeight, powHash));
+    {
+        LOCK(cs_mapPoWHash);
+        mapPoWHash.insert(make_pair(nHeight, powHash));
+    }
 //    SetPoWHash(thash);
     return powHash;
 }
 
 void CBlockHeader::InvalidateCachedPoWHash(int nHeight) const {
+    LOCK(cs_mapPoWHash);
     if (nHeight >= 0 && mapPoWHash.count(nHeight) > 0)
         mapPoWHash.erase(nHeight);
 }
@@ -117,9 +117,22 @@ void WalletModel::updateStatus()
 
 void WalletModel::pollBalanceChanged()
 {
-    // Get required locks upfront. This avoids the GUI from getting stuck on
-    // periodical polls if the core is holding the locks for a longer time -
+    // The wallet keeps its balance totals up to date itself, so a poll with
+    // no new block and no wallet event does not need any lock. When locks
+    // are needed they are only tried, which avoids the GUI from getting stuck
+    // on periodical polls if the core is holding them for a longer time -
     // for example, during a wallet rescan.
+    CWalletBalances balances;
+    int nHeight;
+    if(!wallet->TryGetBalances(balances, nHeight))
+        return;
+
+    if(!fForceCheckBalanceChanged && nHeight == cachedNumBlocks)
+        return;
+
+    // Balance and number of transactions might have changed
+    checkBalanceChanged(balances);
+
     TRY_LOCK(cs_main, lockMain);
     if(!lockMain)
         return;
@@ -127,22 +140,16 @@ void WalletModel::pollBalanceChanged()
     if(!lockWallet)
         return;
 
-    if(fForceCheckBalanceChanged || chainActive.Height() != cachedNumBlocks)
-    {
-        fForceCheckBalanceChanged = false;
-
-        // Balance and number of transactions might have changed
-        cachedNumBlocks = chainActive.Height();
+    fForceCheckBalanceChanged = false;
+    cachedNumBlocks = nHeight;
 
-        checkBalanceChanged();
-        if(transactionTableModel)
-            transactionTableModel->updateConfirmations();
+    if(transactionTableModel)
+        transactionTableModel->updateConfirmations();
 
-        // check sigma
-        // support only hd
-        if (zwalletMain) {
-            checkSigmaAmount(false);
-        }
+    // check sigma
+    // support only hd
+    if (zwalletMain) {
+        checkSigmaAmount(false);
     }
 }
 
@@ -177,17 +184,22 @@ void WalletModel::updateSigmaCoins(const QString &pubCoin, const QString &isUsed
 
 void WalletModel::checkBalanceChanged()
 {
-    CAmount newBalance = getBalance();
-    CAmount newUnconfirmedBalance = getUnconfirmedBalance();
-    CAmount newImmatureBalance = getImmatureBalance();
+    checkBalanceChanged(wallet->GetBalances());
+}
+
+void WalletModel::checkBalanceChanged(const CWalletBalances& balances)
+{
+    CAmount newBalance = balances.nBalance;
+    CAmount newUnconfirmedBalance = balances.nUnconfirmed;
+    CAmount newImmatureBalance = balances.nImmature;
     CAmount newWatchOnlyBalance = 0;
     CAmount newWatchUnconfBalance = 0;
     CAmount newWatchImmatureBalance = 0;
     if (haveWatchOnly())
     {
-        newWatchOnlyBalance = getWatchBalance();
-        newWatchUnconfBalance = getWatchUnconfirmedBalance();
-        newWatchImmatureBalance = getWatchImmatureBalance();
+        newWatchOnlyBalance = balances.nWatchOnly;
+        newWatchUnconfBalance = balances.nUnconfirmedWatchOnly;
+        newWatchImmatureBalance = balances.nImmatureWatchOnly;
     }
 
     if(cachedBalance != newBalance || cachedUnconfirmedBalance != newUnconfirmedBalance || cachedImmatureBalance != newImmatureBalance ||
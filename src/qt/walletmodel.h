@@ -259,6 +259,7 @@ private:
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
     void checkBalanceChanged();
+    void checkBalanceChanged(const CWalletBalances& balances);
 
 
 
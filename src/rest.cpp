@@ -8,8 +8,10 @@
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "main.h"
+#include "hash.h"
 #include "httpserver.h"
 #include "rpc/server.h"
+#include "sigma.h"
 #include "streams.h"
 #include "sync.h"
 #include "txmempool.h"
@@ -58,6 +60,29 @@ struct CCoin {
     }
 };
 
+/** A sigma coin group, as listed by /rest/sigma/groups */
+struct CSigmaCoinGroupEntry {
+    int64_t nDenomination;
+    int32_t nGroupId;
+    int32_t nCoins;
+    int32_t nFirstHeight;
+    int32_t nLastHeight;
+    uint256 hashLastBlock;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nDenomination);
+        READWRITE(nGroupId);
+        READWRITE(nCoins);
+        READWRITE(nFirstHeight);
+        READWRITE(nLastHeight);
+        READWRITE(hashLastBlock);
+    }
+};
+
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
 extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
 extern UniValue mempoolInfoToJSON();
@@ -601,6 +626,201 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/**
+ * Answer with 304 Not Modified if the client already has the version of the
+ * resource identified by hash, in the requested format and for the requested
+ * parameters, otherwise tag the reply with it.
+ * Returns whether the request has been answered.
+ */
+static bool CheckETag(HTTPRequest* req, const uint256& hash, RetFormat rf, const std::string& param)
+{
+    // The same data in another format, or for other parameters, is another
+    // representation and must not share its tag
+    const std::string strURI = req->GetURI();
+    const size_t nQuery = strURI.find('?');
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << hash << (int)rf << param << (nQuery == std::string::npos ? std::string() : strURI.substr(nQuery + 1));
+    const std::string strETag = "\"" + ss.GetHash().GetHex() + "\"";
+    std::pair<bool, std::string> ifNoneMatch = req->GetHeader("if-none-match");
+    req->WriteHeader("ETag", strETag);
+    if (ifNoneMatch.first && (ifNoneMatch.second.find(strETag) != std::string::npos || boost::trim_copy(ifNoneMatch.second) == "*")) {
+        req->WriteReply(HTTP_NOT_MODIFIED);
+        return true;
+    }
+    return false;
+}
+
+static bool rest_sigma_groups(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (!param.empty())
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/sigma/groups.<ext>");
+
+    std::vector<CSigmaCoinGroupEntry> vGroups;
+    {
+        LOCK(cs_main);
+        typedef std::pair<std::pair<sigma::CoinDenomination, int>, sigma::CSigmaState::SigmaCoinGroupInfo> GroupPair;
+        BOOST_FOREACH(const GroupPair& group, sigma::CSigmaState::GetState()->GetCoinGroups()) {
+            CSigmaCoinGroupEntry entry;
+            if (!sigma::DenominationToInteger(group.first.first, entry.nDenomination))
+                continue;
+            entry.nGroupId = group.first.second;
+            entry.nCoins = group.second.nCoins;
+            entry.nFirstHeight = group.second.firstBlock ? group.second.firstBlock->nHeight : -1;
+            entry.nLastHeight = group.second.lastBlock ? group.second.lastBlock->nHeight : -1;
+            entry.hashLastBlock = group.second.lastBlock ? group.second.lastBlock->GetBlockHash() : uint256();
+            vGroups.push_back(entry);
+        }
+    }
+    // The state keeps the groups in a hash map, list them in a stable order
+    std::sort(vGroups.begin(), vGroups.end(), [](const CSigmaCoinGroupEntry& a, const CSigmaCoinGroupEntry& b) {
+        return std::make_pair(a.nDenomination, a.nGroupId) < std::make_pair(b.nDenomination, b.nGroupId);
+    });
+
+    CDataStream ssGroups(SER_NETWORK, PROTOCOL_VERSION);
+    ssGroups << vGroups;
+    // Changes whenever a group gets new coins
+    if (CheckETag(req, Hash(ssGroups.begin(), ssGroups.end()), rf, param))
+        return true;
+
+    switch (rf) {
+    case RF_BINARY: {
+        string strBinary = ssGroups.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, strBinary);
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(ssGroups.begin(), ssGroups.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RF_JSON: {
+        UniValue groups(UniValue::VARR);
+        BOOST_FOREACH(const CSigmaCoinGroupEntry& entry, vGroups) {
+            UniValue group(UniValue::VOBJ);
+            group.push_back(Pair("denomination", ValueFromAmount(entry.nDenomination)));
+            group.push_back(Pair("groupid", entry.nGroupId));
+            group.push_back(Pair("coins", entry.nCoins));
+            group.push_back(Pair("firstheight", entry.nFirstHeight));
+            group.push_back(Pair("lastheight", entry.nLastHeight));
+            group.push_back(Pair("lastblockhash", entry.hashLastBlock.GetHex()));
+            groups.push_back(group);
+        }
+        string strJSON = groups.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_sigma_anonset(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    vector<string> uriParts;
+    boost::split(uriParts, param, boost::is_any_of("/"));
+    sigma::CoinDenomination denomination;
+    int32_t nGroupId;
+    if (uriParts.size() != 2 || !sigma::StringToDenomination(uriParts[0], denomination) || !ParseInt32(uriParts[1], &nGroupId))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/sigma/anonset/<denomination>/<groupid>.<ext>");
+
+    // The coins of the group are written in the order GetCoinSetForSpend
+    // returns them, which is the order spends prove membership against:
+    // newest block first. The group's last block leads the reply.
+    CDataStream ssCoins(SER_NETWORK, PROTOCOL_VERSION);
+    uint256 hashLastBlock;
+    int nCoins = 0;
+    {
+        LOCK(cs_main);
+        sigma::CSigmaState::SigmaCoinGroupInfo group;
+        if (!sigma::CSigmaState::GetState()->GetCoinGroupInfo(denomination, nGroupId, group) || !group.lastBlock)
+            return RESTERR(req, HTTP_NOT_FOUND, "coin group " + param + " not found");
+
+        hashLastBlock = group.lastBlock->GetBlockHash();
+        if (CheckETag(req, hashLastBlock, rf, param))
+            return true;
+
+        // Serialized straight from the block index, without collecting the
+        // coins first like GetCoinSetForSpend does
+        const std::pair<sigma::CoinDenomination, int> denomAndId(denomination, nGroupId);
+        ssCoins << hashLastBlock;
+        WriteCompactSize(ssCoins, group.nCoins);
+        for (const CBlockIndex* pindex = group.lastBlock; pindex; pindex = pindex->pprev) {
+            std::map<std::pair<sigma::CoinDenomination, int>, std::vector<sigma::PublicCoin>>::const_iterator it = pindex->sigmaMintedPubCoins.find(denomAndId);
+            if (it != pindex->sigmaMintedPubCoins.end()) {
+                BOOST_FOREACH(const sigma::PublicCoin& coin, it->second) {
+                    ssCoins << coin.getValue();
+                    nCoins++;
+                }
+            }
+            if (pindex == group.firstBlock)
+                break;
+        }
+        if (nCoins != group.nCoins)
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "coin group " + param + " is inconsistent");
+    }
+
+    switch (rf) {
+    case RF_BINARY: {
+        string strBinary = ssCoins.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, strBinary);
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(ssCoins.begin(), ssCoins.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RF_JSON: {
+        uint256 hash;
+        ssCoins >> hash;
+        ReadCompactSize(ssCoins);
+        UniValue coins(UniValue::VARR);
+        while (!ssCoins.empty()) {
+            const size_t nSize = secp_primitives::GroupElement::serialize_size;
+            coins.push_back(HexStr(ssCoins.begin(), ssCoins.begin() + nSize));
+            ssCoins.ignore(nSize);
+        }
+        UniValue objAnonset(UniValue::VOBJ);
+        objAnonset.push_back(Pair("lastblockhash", hash.GetHex()));
+        objAnonset.push_back(Pair("coins", coins));
+        string strJSON = objAnonset.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -613,12 +833,20 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/sigma/groups", rest_sigma_groups},
+      {"/rest/sigma/anonset/", rest_sigma_anonset},
 };
 
+/** All REST endpoints are read-only chain and mempool queries */
+static HTTPWorkQueueKind rest_queue(HTTPRequest*, const std::string&)
+{
+    return HTTP_QUEUE_CHAIN;
+}
+
 bool StartREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
-        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
+        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler, rest_queue);
     return true;
 }
 
@@ -11,10 +11,12 @@
 #include "consensus/validation.h"
 #include "main.h"
 #include "policy/policy.h"
+#include "pow.h"
 #include "primitives/transaction.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
@@ -90,14 +92,14 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+/**
+ * Writes a block. The parts that depend on the active chain are looked up by
+ * the caller, with cs_main held, so that the result can be written without it.
+ */
+void blockToJSON(JSONWriter& result, const CBlock& block, const CBlockIndex* blockindex, int confirmations, const CBlockIndex* pnext, bool txDetails)
 {
-    UniValue result(UniValue::VOBJ);
+    result.BeginObject();
     result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
-    int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
     result.push_back(Pair("confirmations", confirmations));
     result.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
     result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
@@ -106,19 +108,20 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.push_back(Pair("version", block.nVersion));
     result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
     result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    UniValue txs(UniValue::VARR);
+    result.Key("tx");
+    result.BeginArray();
     BOOST_FOREACH(const CTransaction&tx, block.vtx)
     {
         if(txDetails)
         {
             UniValue objTx(UniValue::VOBJ);
             TxToJSON(tx, uint256(), objTx);
-            txs.push_back(objTx);
+            result.push_back(objTx);
         }
         else
-            txs.push_back(tx.GetHash().GetHex());
+            result.push_back(tx.GetHash().GetHex());
     }
-    result.push_back(Pair("tx", txs));
+    result.EndArray();
     result.push_back(Pair("time", block.GetBlockTime()));
     result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
     result.push_back(Pair("nonce", (uint64_t)block.nNonce));
@@ -128,10 +131,34 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
 
     if (blockindex->pprev)
         result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
     if (pnext)
         result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
-    return result;
+    result.EndObject();
+}
+
+static int GetBlockConfirmations(const CBlockIndex* blockindex)
+{
+    AssertLockHeld(cs_main);
+
+    // Only report confirmations if the block is on the main chain
+    if (chainActive.Contains(blockindex))
+        return chainActive.Height() - blockindex->nHeight + 1;
+    return -1;
+}
+
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    int confirmations;
+    const CBlockIndex* pnext;
+    {
+        LOCK(cs_main);
+        confirmations = GetBlockConfirmations(blockindex);
+        pnext = chainActive.Next(blockindex);
+    }
+
+    JSONWriter result;
+    blockToJSON(result, block, blockindex, confirmations, pnext, txDetails);
+    return result.Finish();
 }
 
 UniValue getblockcount(const UniValue& params, bool fHelp)
@@ -147,8 +174,9 @@ UniValue getblockcount(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockcount", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Height();
+    // Answered from the tip snapshot, so it doesn't wait behind slow calls holding cs_main
+    const CBlockIndex* pindexTip = GetChainTipSnapshot();
+    return pindexTip ? pindexTip->nHeight : -1;
 }
 
 UniValue getbestblockhash(const UniValue& params, bool fHelp)
@@ -164,8 +192,10 @@ UniValue getbestblockhash(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getbestblockhash", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    const CBlockIndex* pindexTip = GetChainTipSnapshot();
+    if (!pindexTip)
+        throw JSONRPCError(RPC_MISC_ERROR, "No blocks loaded");
+    return pindexTip->GetBlockHash().GetHex();
 }
 
 UniValue getdifficulty(const UniValue& params, bool fHelp)
@@ -239,34 +269,59 @@ void entryToJSON(UniValue &info, const CTxMemPoolEntry &e)
     info.push_back(Pair("depends", depends));
 }
 
-UniValue mempoolToJSON(bool fVerbose = false)
+/** Number of mempool entries mempoolToJSON looks up at once, while holding mempool.cs */
+static const size_t MEMPOOL_JSON_BATCH_SIZE = 1000;
+
+void mempoolToJSON(JSONWriter& result, bool fVerbose = false)
 {
     if (fVerbose)
     {
-        LOCK(mempool.cs);
-        UniValue o(UniValue::VOBJ);
-        BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
+        // Look the entries up in batches, so mempool.cs isn't held while the
+        // result is written out. Entries removed meanwhile are left out.
+        vector<uint256> vtxid;
+        mempool.queryHashes(vtxid);
+
+        result.BeginObject();
+        size_t i = 0;
+        while (i < vtxid.size())
         {
-            const uint256& hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            entryToJSON(info, e);
-            o.push_back(Pair(hash.ToString(), info));
+            std::vector<std::pair<std::string, UniValue> > vBatch;
+            {
+                LOCK(mempool.cs);
+                for (; i < vtxid.size() && vBatch.size() < MEMPOOL_JSON_BATCH_SIZE; i++)
+                {
+                    CTxMemPool::txiter it = mempool.mapTx.find(vtxid[i]);
+                    if (it == mempool.mapTx.end())
+                        continue;
+                    UniValue info(UniValue::VOBJ);
+                    entryToJSON(info, *it);
+                    vBatch.push_back(Pair(vtxid[i].ToString(), info));
+                }
+            }
+            for (size_t j = 0; j < vBatch.size(); j++)
+                result.push_back(vBatch[j]);
         }
-        return o;
+        result.EndObject();
     }
     else
     {
         vector<uint256> vtxid;
         mempool.queryHashes(vtxid);
 
-        UniValue a(UniValue::VARR);
+        result.BeginArray();
         BOOST_FOREACH(const uint256& hash, vtxid)
-            a.push_back(hash.ToString());
-
-        return a;
+            result.push_back(hash.ToString());
+        result.EndArray();
     }
 }
 
+UniValue mempoolToJSON(bool fVerbose = false)
+{
+    JSONWriter result;
+    mempoolToJSON(result, fVerbose);
+    return result.Finish();
+}
+
 UniValue getrawmempool(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -295,7 +350,9 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
     if (params.size() > 0)
         fVerbose = params[0].get_bool();
 
-    return mempoolToJSON(fVerbose);
+    JSONWriter result(RPCResultSink());
+    mempoolToJSON(result, fVerbose);
+    return result.Finish();
 }
 
 UniValue clearmempool(const UniValue& params, bool fHelp)
@@ -649,8 +706,6 @@ UniValue getblock(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblock", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -658,17 +713,27 @@ UniValue getblock(const UniValue& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    CBlockIndex* pblockindex;
+    int confirmations;
+    const CBlockIndex* pnext;
+    {
+        LOCK(cs_main);
+
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+
+        pblockindex = mapBlockIndex[hash];
+
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
 
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+        if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
 
-    if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        confirmations = GetBlockConfirmations(pblockindex);
+        pnext = chainActive.Next(pblockindex);
+    }
 
     if (!fVerbose)
     {
@@ -678,7 +743,11 @@ UniValue getblock(const UniValue& params, bool fHelp)
         return strHex;
     }
 
-    return blockToJSON(block, pblockindex);
+    // The block is a copy, and the index fields written don't change, so
+    // cs_main isn't held while the result is written out
+    JSONWriter result(RPCResultSink());
+    blockToJSON(result, block, pblockindex, confirmations, pnext, false);
+    return result.Finish();
 }
 
 struct CCoinsStats
@@ -737,11 +806,13 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( height )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time, unless the node runs with -utxostatsindex.\n"
+            "\nArguments:\n"
+            "1. height         (numeric, optional) Report the set as of this block of the active chain, requires -utxostatsindex\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
@@ -749,16 +820,49 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
             "  \"transactions\": n,      (numeric) The number of transactions\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
             "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash, only without -utxostatsindex\n"
+            "  \"multiset_hash\": \"hash\",     (string) The multiset hash of the unspent outputs, only with -utxostatsindex\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "1000")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
     UniValue ret(UniValue::VOBJ);
 
+    if (fUTXOStatsIndex) {
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            if (params.size() > 0) {
+                int nHeight = params[0].get_int();
+                if (nHeight < 0 || nHeight > chainActive.Height())
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+                pindex = chainActive[nHeight];
+            } else {
+                pindex = chainActive.Tip();
+            }
+        }
+
+        CUTXOStats utxoStats;
+        if (pindex && pblocktree->ReadUTXOStats(pindex->GetBlockHash(), utxoStats)) {
+            ret.push_back(Pair("height", (int64_t)pindex->nHeight));
+            ret.push_back(Pair("bestblock", pindex->GetBlockHash().GetHex()));
+            ret.push_back(Pair("transactions", (int64_t)utxoStats.nTransactions));
+            ret.push_back(Pair("txouts", (int64_t)utxoStats.nTransactionOutputs));
+            ret.push_back(Pair("bytes_serialized", (int64_t)utxoStats.nSerializedSize));
+            ret.push_back(Pair("multiset_hash", utxoStats.GetHash().GetHex()));
+            ret.push_back(Pair("total_amount", ValueFromAmount(utxoStats.nTotalAmount)));
+            return ret;
+        }
+        if (params.size() > 0)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "No UTXO set statistics for this block");
+    } else if (params.size() > 0) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Statistics for past blocks require -utxostatsindex");
+    }
+
     CCoinsStats stats;
     FlushStateToDisk();
     if (GetUTXOStats(pcoinsTip, stats)) {
@@ -1144,12 +1248,17 @@ UniValue getchaintips(const UniValue& params, bool fHelp)
 UniValue mempoolInfoToJSON()
 {
     UniValue ret(UniValue::VOBJ);
-    ret.push_back(Pair("size", (int64_t) mempool.size()));
-    ret.push_back(Pair("bytes", (int64_t) mempool.GetTotalTxSize()));
+    ret.push_back(Pair("size", (int64_t) mempool.GetSizeSnapshot()));
+    ret.push_back(Pair("bytes", (int64_t) mempool.GetTotalTxSizeSnapshot()));
     ret.push_back(Pair("usage", (int64_t) mempool.DynamicMemoryUsage()));
     size_t maxmempool = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     ret.push_back(Pair("maxmempool", (int64_t) maxmempool));
     ret.push_back(Pair("mempoolminfee", ValueFromAmount(mempool.GetMinFee(maxmempool).GetFeePerK())));
+    int64_t nLoadProcessed, nLoadTotal;
+    bool fLoading = GetMempoolLoadProgress(nLoadProcessed, nLoadTotal);
+    ret.push_back(Pair("loading", fLoading));
+    if (fLoading)
+        ret.push_back(Pair("loadprogress", nLoadTotal > 0 ? (double)nLoadProcessed / nLoadTotal : 1.0));
 
     return ret;
 }
@@ -1166,7 +1275,9 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
             "  \"bytes\": xxxxx,              (numeric) Sum of all tx sizes\n"
             "  \"usage\": xxxxx,              (numeric) Total memory usage for the mempool\n"
             "  \"maxmempool\": xxxxx,         (numeric) Maximum memory usage for the mempool\n"
-            "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee for tx to be accepted\n"
+            "  \"mempoolminfee\": xxxxx,      (numeric) Minimum fee for tx to be accepted\n"
+            "  \"loading\": true|false,       (boolean) If the mempool saved on the last shutdown is being loaded\n"
+            "  \"loadprogress\": xxxxx        (numeric, optional) Fraction of the saved mempool processed so far, only while loading\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
@@ -1251,6 +1362,61 @@ UniValue reconsiderblock(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+UniValue verifyretarget(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 2)
+        throw runtime_error(
+            "verifyretarget ( startheight endheight )\n"
+            "\nRecomputes the difficulty of the blocks of the active chain with both the current and the\n"
+            "legacy bignum retarget code, and reports the heights at which they disagree, or disagree\n"
+            "with the difficulty the block has.\n"
+            "\nArguments:\n"
+            "1. startheight   (numeric, optional, default=1) the height of the first block to check\n"
+            "2. endheight     (numeric, optional, default=tip) the height of the last block to check\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"checked\": n,         (numeric) the number of blocks checked\n"
+            "  \"mismatches\": [ n ]   (array) the heights at which the results differ\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("verifyretarget", "")
+            + HelpExampleRpc("verifyretarget", "1000, 2000")
+        );
+
+    int nStartHeight = 1;
+    if (params.size() > 0)
+        nStartHeight = std::max(params[0].get_int(), 1);
+
+    // The block index entries of the chain don't change or go away once
+    // created, so cs_main is only needed to find the tip
+    const CBlockIndex* pindexTip;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+    }
+    int nEndHeight = pindexTip->nHeight;
+    if (params.size() > 1)
+        nEndHeight = std::min(params[1].get_int(), nEndHeight);
+
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    UniValue mismatches(UniValue::VARR);
+    int nChecked = 0;
+
+    for (int nHeight = nStartHeight; nHeight <= nEndHeight; nHeight++) {
+        boost::this_thread::interruption_point();
+        const CBlockIndex* pindex = pindexTip->GetAncestor(nHeight);
+        unsigned int nBits = GetNextWorkRequired(pindex->pprev, NULL, consensusParams);
+        if (nBits != GetNextWorkRequiredBigNum(pindex->pprev, consensusParams) || nBits != pindex->nBits)
+            mismatches.push_back(nHeight);
+        nChecked++;
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("checked", nChecked));
+    ret.push_back(Pair("mismatches", mismatches));
+    return ret;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafeMode
   //  --------------------- ------------------------  -----------------------  ----------
@@ -1276,6 +1442,7 @@ static const CRPCCommand commands[] =
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        true  },
     { "hidden",             "reconsiderblock",        &reconsiderblock,        true  },
+    { "hidden",             "verifyretarget",         &verifyretarget,         true  },
 };
 
 void RegisterBlockchainRPCCommands(CRPCTable &tableRPC)
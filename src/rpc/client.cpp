@@ -47,6 +47,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getbalance", 1 },
     { "getbalance", 2 },
     { "getblockhash", 0 },
+    { "verifyretarget", 0 },
+    { "verifyretarget", 1 },
     { "move", 2 },
     { "move", 3 },
     { "sendfrom", 2 },
@@ -90,6 +92,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "fundrawtransaction", 1 },
     { "gettxout", 1 },
     { "gettxout", 2 },
+    { "gettxoutsetinfo", 0 },
     { "gettxoutproof", 0 },
     { "lockunspent", 0 },
     { "lockunspent", 1 },
@@ -173,6 +176,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
 	{ "exodus_getfeedistribution", 0 },
 	{ "exodus_getfeedistributions", 0 },
 	{ "exodus_getbalanceshash", 0 },
+	{ "exodus_getcurrentstatehash", 0 },
 
 	/* Exodus - transaction calls */
 	{ "exodus_send", 2 },
@@ -0,0 +1,135 @@
+// Copyright (c) 2019 The GravityCoin Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonwriter.h"
+
+#include <assert.h>
+
+JSONWriter::JSONWriter(const Sink* psinkIn) : psink(psinkIn), fKeyPending(false)
+{
+}
+
+void JSONWriter::Separate()
+{
+    // Values of objects are preceded by their key, which took care of the separator
+    if (vEmpty.empty() || fKeyPending)
+        return;
+    if (!vEmpty.back())
+        strBuffer += ',';
+    vEmpty.back() = false;
+}
+
+void JSONWriter::Key(const std::string& key)
+{
+    if (psink) {
+        assert(!vEmpty.empty());
+        if (!vEmpty.back())
+            strBuffer += ',';
+        vEmpty.back() = false;
+        strBuffer += UniValue(key).write();
+        strBuffer += ':';
+    }
+    strKey = key;
+    fKeyPending = true;
+}
+
+void JSONWriter::Add(const UniValue& value)
+{
+    if (vStack.empty()) {
+        root = value;
+    } else if (vStack.back().second.isObject()) {
+        vStack.back().second.pushKV(strKey, value);
+    } else {
+        vStack.back().second.push_back(value);
+    }
+    strKey.clear();
+    fKeyPending = false;
+}
+
+void JSONWriter::Value(const UniValue& value)
+{
+    if (psink) {
+        Separate();
+        fKeyPending = false;
+        strBuffer += value.write();
+        if (strBuffer.size() >= JSON_STREAM_CHUNK_SIZE)
+            Flush();
+    } else {
+        Add(value);
+    }
+}
+
+void JSONWriter::Begin(UniValue::VType type)
+{
+    if (psink) {
+        Separate();
+        fKeyPending = false;
+        strBuffer += (type == UniValue::VOBJ) ? '{' : '[';
+        vEmpty.push_back(true);
+    } else {
+        vStack.push_back(std::make_pair(strKey, UniValue(type)));
+        strKey.clear();
+        fKeyPending = false;
+    }
+}
+
+void JSONWriter::End()
+{
+    if (psink) {
+        assert(!vEmpty.empty());
+        vEmpty.pop_back();
+        if (strBuffer.size() >= JSON_STREAM_CHUNK_SIZE)
+            Flush();
+    } else {
+        assert(!vStack.empty());
+        std::pair<std::string, UniValue> top;
+        std::swap(top, vStack.back());
+        vStack.pop_back();
+        strKey = top.first;
+        Add(top.second);
+    }
+}
+
+void JSONWriter::BeginObject()
+{
+    Begin(UniValue::VOBJ);
+}
+
+void JSONWriter::EndObject()
+{
+    if (psink)
+        strBuffer += '}';
+    End();
+}
+
+void JSONWriter::BeginArray()
+{
+    Begin(UniValue::VARR);
+}
+
+void JSONWriter::EndArray()
+{
+    if (psink)
+        strBuffer += ']';
+    End();
+}
+
+void JSONWriter::Flush()
+{
+    if (strBuffer.empty())
+        return;
+    (*psink)(strBuffer);
+    strBuffer.clear();
+}
+
+UniValue JSONWriter::Finish()
+{
+    if (psink) {
+        assert(vEmpty.empty());
+        Flush();
+        return NullUniValue;
+    }
+    assert(vStack.empty());
+    return root;
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2019 The GravityCoin Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef GRAVITYCOIN_RPC_JSONWRITER_H
+#define GRAVITYCOIN_RPC_JSONWRITER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include <univalue.h>
+
+/** Size at which a streaming JSONWriter hands its output over to the sink */
+static const size_t JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Writes a JSON document in document order.
+ *
+ * Without a sink the document is collected into a UniValue, which Finish()
+ * returns. With a sink it is serialized right away and handed over in chunks
+ * of about JSON_STREAM_CHUNK_SIZE bytes, so a large result never has to exist
+ * as a whole, neither as a UniValue tree nor as one string. Chunks always end
+ * between two values.
+ *
+ * RPC handlers that can produce large results write them through a JSONWriter
+ * created on RPCResultSink(), so the same code serves both streamed HTTP
+ * replies and callers that need the UniValue.
+ */
+class JSONWriter
+{
+public:
+    typedef boost::function<void(const std::string&)> Sink;
+
+    explicit JSONWriter(const Sink* psinkIn = NULL);
+
+    bool IsStreaming() const { return psink != NULL; }
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    //! Name of the next value written into the current object
+    void Key(const std::string& key);
+    void Value(const UniValue& value);
+
+    //! Same as UniValue::push_back for objects and arrays
+    void push_back(const std::pair<std::string, UniValue>& pair) { Key(pair.first); Value(pair.second); }
+    void push_back(const UniValue& value) { Value(value); }
+
+    /**
+     * Complete the document. Returns it when collecting, or passes the
+     * remaining output to the sink and returns NullUniValue when streaming.
+     */
+    UniValue Finish();
+
+private:
+    const Sink* psink;
+
+    //! Serialized output not yet passed to the sink
+    std::string strBuffer;
+    //! Per open container, whether nothing was written into it yet
+    std::vector<bool> vEmpty;
+    //! Whether a key was written, whose value is still to come
+    bool fKeyPending;
+
+    //! Containers under construction, with the key they will be stored under
+    std::vector<std::pair<std::string, UniValue> > vStack;
+    std::string strKey;
+    UniValue root;
+
+    void Separate();
+    void Add(const UniValue& value);
+    void Begin(UniValue::VType type);
+    void End();
+    void Flush();
+};
+
+#endif // GRAVITYCOIN_RPC_JSONWRITER_H
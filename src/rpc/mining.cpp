@@ -149,6 +149,8 @@ UniValue generateBlocks(boost::shared_ptr<CReserveScript> coinbaseScript, int nG
             coinbaseScript->KeepScript();
         }
     }
+    // Have the wallet know about the generated coins once this returns
+    SyncWithValidationInterfaceQueue();
     return blockHashes;
 }
 
@@ -694,7 +694,8 @@ UniValue getaddressmempool(const UniValue& params, bool fHelp)
 
     std::sort(indexes.begin(), indexes.end(), timestampSort);
 
-    UniValue result(UniValue::VARR);
+    JSONWriter result(RPCResultSink());
+    result.BeginArray();
 
     for (std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> >::iterator it = indexes.begin(); it != indexes.end(); it++) {
 
@@ -716,7 +717,8 @@ UniValue getaddressmempool(const UniValue& params, bool fHelp)
         result.push_back(delta);
     }
 
-    return result;
+    result.EndArray();
+    return result.Finish();
 }
 
 UniValue getaddressutxos(const UniValue& params, bool fHelp)
@@ -765,7 +767,8 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
 
     std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
 
-    UniValue result(UniValue::VARR);
+    JSONWriter result(RPCResultSink());
+    result.BeginArray();
 
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
         UniValue output(UniValue::VOBJ);
@@ -783,7 +786,8 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         result.push_back(output);
     }
 
-    return result;
+    result.EndArray();
+    return result.Finish();
 }
 
 UniValue getaddressdeltas(const UniValue& params, bool fHelp)
@@ -853,7 +857,8 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         }
     }
 
-    UniValue result(UniValue::VARR);
+    JSONWriter result(RPCResultSink());
+    result.BeginArray();
 
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
         std::string address;
@@ -871,7 +876,8 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         result.push_back(delta);
     }
 
-    return result;
+    result.EndArray();
+    return result.Finish();
 }
 
 UniValue getaddressbalance(const UniValue& params, bool fHelp)
@@ -988,7 +994,8 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
     }
 
     std::set<std::pair<int, std::string> > txids;
-    UniValue result(UniValue::VARR);
+    JSONWriter result(RPCResultSink());
+    result.BeginArray();
 
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
         int height = it->first.blockHeight;
@@ -1009,7 +1016,8 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
         }
     }
 
-    return result;
+    result.EndArray();
+    return result.Finish();
 
 }
 
@@ -478,7 +478,17 @@ UniValue xnodelist(const UniValue &params, bool fHelp) {
         mnodeman.UpdateLastPaid();
     }
 
-    UniValue obj(UniValue::VOBJ);
+    int nBlockHeight = 0;
+    if (strMode == "qualify") {
+        LOCK(cs_main);
+        CBlockIndex *pindex = chainActive.Tip();
+        if (!pindex) return NullUniValue;
+
+        nBlockHeight = pindex->nHeight;
+    }
+
+    JSONWriter obj(RPCResultSink());
+    obj.BeginObject();
     if (strMode == "rank") {
         std::vector <std::pair<int, CXnode>> vXnodeRanks = mnodeman.GetXnodeRanks();
         BOOST_FOREACH(PAIRTYPE(int, CXnode) & s, vXnodeRanks)
@@ -545,14 +555,6 @@ UniValue xnodelist(const UniValue &params, bool fHelp) {
                     continue;
                 obj.push_back(Pair(strOutpoint, strStatus));
             } else if (strMode == "qualify") {
-                int nBlockHeight;
-                {
-                    LOCK(cs_main);
-                    CBlockIndex *pindex = chainActive.Tip();
-                    if (!pindex) return NullUniValue;
-
-                    nBlockHeight = pindex->nHeight;
-                }
                 int nMnCount = mnodeman.CountEnabled();
                 char* reasonStr = mnodeman.GetNotQualifyReason(mn, nBlockHeight, true, nMnCount);
                 std::string strOutpoint = mn.vin.prevout.ToStringShort();
@@ -561,7 +563,8 @@ UniValue xnodelist(const UniValue &params, bool fHelp) {
             }
         }
     }
-    return obj;
+    obj.EndObject();
+    return obj.Finish();
 }
 
 bool DecodeHexVecMnb(std::vector <CXnodeBroadcast> &vecMnb, std::string strHexMnb) {
@@ -6,15 +6,19 @@
 #include "rpc/server.h"
 
 #include "base58.h"
+#include "httpserver.h"
 #include "init.h"
 #include "random.h"
 #include "sync.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "validationinterface.h"
 
 #include <univalue.h>
 
+#include <set>
+
 #include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
@@ -262,6 +266,49 @@ UniValue stop(const UniValue& params, bool fHelp)
     return "GravityCoin server stopping";
 }
 
+UniValue getrpcinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getrpcinfo\n"
+            "\nReturns the state of the work queues RPC and REST requests are handled from.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"xxxx\",       (string) the queue, \"chain\" for read-only chain queries, \"index\" for the ones scanning an index, \"general\" for anything else\n"
+            "    \"depth\": n,            (numeric) requests waiting to be handled\n"
+            "    \"maxdepth\": n,         (numeric) requests that may wait before new ones are rejected (-rpcworkqueue)\n"
+            "    \"threads\": n,          (numeric) worker threads handling the queue\n"
+            "    \"processed\": n,        (numeric) requests handled since startup\n"
+            "    \"rejected\": n,         (numeric) requests rejected because the queue was full\n"
+            "    \"avgwaitms\": x.xxx,    (numeric) average time requests waited in the queue, in milliseconds\n"
+            "    \"maxwaitms\": x.xxx,    (numeric) longest time a request waited in the queue, in milliseconds\n"
+            "    \"avgexecms\": x.xxx     (numeric) average time handling a request took, in milliseconds\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrpcinfo", "")
+            + HelpExampleRpc("getrpcinfo", "")
+        );
+
+    UniValue ret(UniValue::VARR);
+    BOOST_FOREACH(const HTTPWorkQueueStats& stats, GetHTTPWorkQueueStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", stats.strName));
+        obj.push_back(Pair("depth", (uint64_t)stats.nDepth));
+        obj.push_back(Pair("maxdepth", (uint64_t)stats.nMaxDepth));
+        obj.push_back(Pair("threads", stats.nThreads));
+        obj.push_back(Pair("processed", stats.nProcessed));
+        obj.push_back(Pair("rejected", stats.nRejected));
+        obj.push_back(Pair("avgwaitms", stats.nProcessed ? 0.001 * stats.nTotalWaitMicros / stats.nProcessed : 0.0));
+        obj.push_back(Pair("maxwaitms", 0.001 * stats.nMaxWaitMicros));
+        obj.push_back(Pair("avgexecms", stats.nProcessed ? 0.001 * stats.nTotalExecMicros / stats.nProcessed : 0.0));
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
 /**
  * Call Table
  */
@@ -271,6 +318,7 @@ static const CRPCCommand vRPCCommands[] =
     /* Overall control/query calls */
     { "control",            "help",                   &help,                   true  },
     { "control",            "stop",                   &stop,                   true  },
+    { "control",            "getrpcinfo",             &getrpcinfo,             true  },
         /* Address index */
     { "addressindex",       "getaddressmempool",      &getaddressmempool,      true  },
     { "addressindex",       "getaddressutxos",        &getaddressutxos,        false },
@@ -306,6 +354,39 @@ const CRPCCommand *CRPCTable::operator[](const std::string &name) const
     return (*it).second;
 }
 
+bool CRPCTable::IsChainQuery(const std::string &name) const
+{
+    static const std::set<std::string> setMutating = {
+        "clearmempool",
+    };
+    static const std::set<std::string> setRawQueries = {
+        "getrawtransaction",
+        "decoderawtransaction",
+        "decodescript",
+    };
+    const CRPCCommand *pcmd = (*this)[name];
+    if (!pcmd)
+        return false;
+    if (pcmd->category == "blockchain" || pcmd->category == "addressindex")
+        return !setMutating.count(name);
+    return setRawQueries.count(name) > 0;
+}
+
+bool CRPCTable::IsIndexQuery(const std::string &name) const
+{
+    static const std::set<std::string> setIndexQueries = {
+        "getaddressbalance",
+        "getaddressdeltas",
+        "getaddresstxids",
+        "getaddressutxos",
+        "getblockhashes",
+        "gettotalsupply",
+        "gettxoutsetinfo",
+        "verifychain",
+    };
+    return setIndexQueries.count(name) > 0 && IsChainQuery(name);
+}
+
 bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
 {
     if (IsRPCRunning())
@@ -398,6 +479,28 @@ void JSONRequest::parse(const UniValue& valRequest)
         throw JSONRPCError(RPC_INVALID_REQUEST, "Params must be an array");
 }
 
+static void NoSinkCleanup(JSONWriter::Sink*)
+{
+    // the sink is owned by whoever set up the RPCResultSinkScope
+}
+
+static boost::thread_specific_ptr<JSONWriter::Sink> rpcResultSink(NoSinkCleanup);
+
+const JSONWriter::Sink* RPCResultSink()
+{
+    return rpcResultSink.get();
+}
+
+RPCResultSinkScope::RPCResultSinkScope(const JSONWriter::Sink& sink)
+{
+    rpcResultSink.reset(const_cast<JSONWriter::Sink*>(&sink));
+}
+
+RPCResultSinkScope::~RPCResultSinkScope()
+{
+    rpcResultSink.reset();
+}
+
 static UniValue JSONRPCExecOne(const UniValue& req)
 {
     UniValue rpc_result(UniValue::VOBJ);
@@ -447,6 +550,10 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
 
     g_rpcSignals.PreCommand(*pcmd);
 
+    // Wallet calls reflect every block and transaction validated so far
+    if (pcmd->category == "wallet")
+        SyncWithValidationInterfaceQueue();
+
     try
     {
         // Execute
@@ -7,6 +7,7 @@
 #define BITCOIN_RPCSERVER_H
 
 #include "amount.h"
+#include "rpc/jsonwriter.h"
 #include "rpc/protocol.h"
 #include "uint256.h"
 
@@ -124,6 +125,22 @@ void RPCUnsetTimerInterface(RPCTimerInterface *iface);
  */
 void RPCRunLater(const std::string& name, boost::function<void(void)> func, int64_t nSeconds);
 
+/**
+ * Sink the result of the RPC call in progress on this thread can be streamed
+ * to, or NULL if the caller needs the returned UniValue. Handlers producing
+ * large results write them through a JSONWriter on this sink, and return what
+ * JSONWriter::Finish returns.
+ */
+const JSONWriter::Sink* RPCResultSink();
+
+/** Makes RPCResultSink() return the given sink on this thread while in scope */
+class RPCResultSinkScope
+{
+public:
+    explicit RPCResultSinkScope(const JSONWriter::Sink& sink);
+    ~RPCResultSinkScope();
+};
+
 typedef UniValue(*rpcfn_type)(const UniValue& params, bool fHelp);
 
 class CRPCCommand
@@ -147,6 +164,18 @@ public:
     const CRPCCommand* operator[](const std::string& name) const;
     std::string help(const std::string& name) const;
 
+    /**
+     * Whether a method only reads chain, mempool or index data, so it can be
+     * handled apart from wallet and state changing calls.
+     */
+    bool IsChainQuery(const std::string& name) const;
+
+    /**
+     * Whether a chain query scans an index or the UTXO set, and may take long
+     * enough to hold up the cheap ones.
+     */
+    bool IsIndexQuery(const std::string& name) const;
+
     /**
      * Execute a method.
      * @param method   Method to execute
@@ -10,6 +10,7 @@
 #include "wallet/wallet.h"
 #include "wallet/walletdb.h"
 #include "crypto/sha256.h"
+#include "hash.h"
 #include "sigma/coinspend.h"
 #include "sigma/coin.h"
 #include "sigma/remint.h"
@@ -31,6 +32,26 @@ namespace sigma {
 
 static CSigmaState sigmaState;
 
+// Maximum number of spend proofs remembered as verified
+static const size_t SPEND_VERIFICATION_CACHE_SIZE = 20000;
+
+// Spend proofs that already passed verification against a given anonymity set. The same spend is checked when
+// it enters the mempool, the stempool and finally a block, and only the first of these needs to run the proof.
+static CCriticalSection cs_spendVerificationCache;
+static std::set<uint256> spendVerificationCache;
+
+static bool IsSpendVerified(const uint256 &hashSpend) {
+    LOCK(cs_spendVerificationCache);
+    return spendVerificationCache.count(hashSpend) > 0;
+}
+
+static void SetSpendVerified(const uint256 &hashSpend) {
+    LOCK(cs_spendVerificationCache);
+    if (spendVerificationCache.size() >= SPEND_VERIFICATION_CACHE_SIZE)
+        spendVerificationCache.clear();
+    spendVerificationCache.insert(hashSpend);
+}
+
 static bool CheckSigmaSpendSerial(
         CValidationState &state,
         CSigmaTxInfo *sigmaTxInfo,
@@ -188,7 +209,8 @@ bool CheckSigmaSpendTransaction(
         int nHeight,
         bool isCheckWallet,
         bool fStatefulSigmaCheck,
-        CSigmaTxInfo *sigmaTxInfo) {
+        CSigmaTxInfo *sigmaTxInfo,
+        bool fCheckSpendProofs) {
     bool hasSigmaSpendInputs = false, hasNonSigmaInputs = false;
     int vinIndex = -1;
     std::unordered_set<Scalar, sigma::CScalarHash> txSerials;
@@ -262,21 +284,39 @@ bool CheckSigmaSpendTransaction(
         while (index != coinGroup.firstBlock && index->GetBlockHash() != accumulatorBlockHash)
             index = index->pprev;
 
-        // Build a vector with all the public coins with given denomination and accumulator id before
-        // the block on which the spend occured.
-        // This list of public coins is required by function "Verify" of CoinSpend.
-        std::vector<sigma::PublicCoin> anonymity_set;
-        while(true) {
-            BOOST_FOREACH(const sigma::PublicCoin& pubCoinValue,
-                    index->sigmaMintedPubCoins[denominationAndId]) {
-                anonymity_set.push_back(pubCoinValue);
-            }
-            if (index == coinGroup.firstBlock)
-                break;
-            index = index->pprev;
+        // Anonymity set is fully determined by the blocks it spans, so the result of verifying this exact spend
+        // against it can be remembered
+        uint256 hashSpend;
+        if (fCheckSpendProofs) {
+            CHashWriter hashWriter(SER_GETHASH, 0);
+            hashWriter << *(CScriptBase*)(&txin.scriptSig) << txHashForMetadata << (int)denominationAndId.first << denominationAndId.second
+                       << index->GetBlockHash() << coinGroup.firstBlock->GetBlockHash();
+            hashSpend = hashWriter.GetHash();
         }
 
-        passVerify = spend->Verify(anonymity_set, newMetaData);
+        // Proofs of spends in checkpointed blocks are assumed valid
+        if (!fCheckSpendProofs || IsSpendVerified(hashSpend)) {
+            passVerify = true;
+        }
+        else {
+            // Build a vector with all the public coins with given denomination and accumulator id before
+            // the block on which the spend occured.
+            // This list of public coins is required by function "Verify" of CoinSpend.
+            std::vector<sigma::PublicCoin> anonymity_set;
+            while(true) {
+                BOOST_FOREACH(const sigma::PublicCoin& pubCoinValue,
+                        index->sigmaMintedPubCoins[denominationAndId]) {
+                    anonymity_set.push_back(pubCoinValue);
+                }
+                if (index == coinGroup.firstBlock)
+                    break;
+                index = index->pprev;
+            }
+
+            passVerify = spend->Verify(anonymity_set, newMetaData);
+            if (passVerify)
+                SetSpendVerified(hashSpend);
+        }
         if (passVerify) {
             Scalar serial = spend->getCoinSerialNumber();
             // do not check for duplicates in case we've seen exact copy of this tx in this block before
@@ -398,7 +438,8 @@ bool CheckSigmaTransaction(
         int nHeight,
         bool isCheckWallet,
         bool fStatefulSigmaCheck,
-        CSigmaTxInfo *sigmaTxInfo)
+        CSigmaTxInfo *sigmaTxInfo,
+        bool fCheckSpendProofs)
 {
     auto& consensus = ::Params().GetConsensus();
 
@@ -480,7 +521,7 @@ bool CheckSigmaTransaction(
         if (!isVerifyDB) {
             if (!CheckSigmaSpendTransaction(
                 tx, denominations, state, hashTx, isVerifyDB, nHeight,
-                isCheckWallet, fStatefulSigmaCheck, sigmaTxInfo)) {
+                isCheckWallet, fStatefulSigmaCheck, sigmaTxInfo, fCheckSpendProofs)) {
                     return false;
             }
         }
@@ -625,7 +666,7 @@ bool ConnectBlockSigma(
 bool GetOutPointFromBlock(COutPoint& outPoint, const GroupElement &pubCoinValue, const CBlock &block){
     secp_primitives::GroupElement txPubCoinValue;
     // cycle transaction hashes, looking for this pubcoin.
-    BOOST_FOREACH(CTransaction tx, block.vtx){
+    BOOST_FOREACH(const CTransaction &tx, block.vtx){
         uint32_t nIndex = 0;
         for (const CTxOut &txout: tx.vout) {
             if (txout.scriptPubKey.IsSigmaMint()){
@@ -1001,6 +1042,23 @@ bool CSigmaState::HasCoinHash(GroupElement &pubCoinValue, const uint256 &pubCoin
     return false;
 }
 
+void CSigmaState::GetCoinsByHash(
+        const std::set<uint256> &pubCoinValueHashes,
+        std::map<uint256, std::pair<sigma::PublicCoin, CMintedCoinInfo>> &pubCoins) {
+    if (pubCoinValueHashes.empty())
+        return;
+
+    std::size_t nFound = 0;
+    for (auto it = GetMints().begin(); it != GetMints().end(); ++it) {
+        uint256 pubCoinValueHash = it->first.getValueHash();
+        if (pubCoinValueHashes.count(pubCoinValueHash)) {
+            pubCoins[pubCoinValueHash] = std::make_pair(it->first, it->second);
+            if (++nFound == pubCoinValueHashes.size())
+                break;
+        }
+    }
+}
+
 int CSigmaState::GetCoinSetForSpend(
         CChain *chain,
         int maxHeight,
@@ -63,7 +63,8 @@ bool CheckSigmaTransaction(
 	int nHeight,
   bool isCheckWallet,
   bool fStatefulSigmaCheck,
-  CSigmaTxInfo *zerocoinTxInfo);
+  CSigmaTxInfo *zerocoinTxInfo,
+  bool fCheckSpendProofs = true);
 
 void DisconnectTipSigma(CBlock &block, CBlockIndex *pindexDelete);
 
@@ -140,6 +141,10 @@ public:
     bool HasCoin(const sigma::PublicCoin& pubCoin);
     // Query if there is a coin with given hash of a pubCoin value. If so, store preimage in pubCoin param
     bool HasCoinHash(GroupElement &pubCoinValue, const uint256 &pubCoinValueHash);
+    // Look up a batch of coins by the hashes of their pubCoin values, walking the minted coins only once.
+    // Found coins are stored in pubCoins together with their mint info
+    void GetCoinsByHash(const std::set<uint256> &pubCoinValueHashes,
+        std::map<uint256, std::pair<sigma::PublicCoin, CMintedCoinInfo>> &pubCoins);
 
     // Given denomination and id returns latest accumulator value and corresponding block hash
     // Do not take into account coins with height more than maxHeight
@@ -26,6 +26,7 @@ static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
+static const char DB_UTXOSTATS = 'U';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
@@ -296,6 +297,14 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned i
     return true;
 }
 
+bool CBlockTreeDB::WriteUTXOStats(const uint256 &hashBlock, const CUTXOStats &stats) {
+    return Write(std::make_pair(DB_UTXOSTATS, hashBlock), stats);
+}
+
+bool CBlockTreeDB::ReadUTXOStats(const uint256 &hashBlock, CUTXOStats &stats) {
+    return Read(std::make_pair(DB_UTXOSTATS, hashBlock), stats);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -10,6 +10,7 @@
 #include "dbwrapper.h"
 #include "chain.h"
 #include "spentindex.h"
+#include "utxostats.h"
 
 #include <map>
 #include <string>
@@ -128,6 +129,8 @@ public:
 
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
+    bool WriteUTXOStats(const uint256 &hashBlock, const CUTXOStats &stats);
+    bool ReadUTXOStats(const uint256 &hashBlock, CUTXOStats &stats);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
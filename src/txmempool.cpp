@@ -464,6 +464,8 @@ bool CTxMemPool::addUnchecked(const uint256 &hash, const CTxMemPoolEntry &entry,
         newit->vTxHashesIdx = vTxHashes.size() - 1;
     }
     totalTxSize += entry.GetTxSize();
+    nSizeSnapshot = mapTx.size();
+    nTotalTxSizeSnapshot = totalTxSize;
 
     nTransactionsUpdated++;
 
@@ -492,6 +494,8 @@ void CTxMemPool::removeUnchecked(txiter it) {
 
     mapLinks.erase(it);
     mapTx.erase(it);
+    nSizeSnapshot = mapTx.size();
+    nTotalTxSizeSnapshot = totalTxSize;
     nTransactionsUpdated++;
     minerPolicyEstimator->removeTx(hash);
     LogPrintf("removeUnchecked ->OK\n");
@@ -803,6 +807,8 @@ void CTxMemPool::_clear() {
     mapTx.clear();
     mapNextTx.clear();
     totalTxSize = 0;
+    nSizeSnapshot = 0;
+    nTotalTxSizeSnapshot = 0;
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_TXMEMPOOL_H
 #define BITCOIN_TXMEMPOOL_H
 
+#include <atomic>
 #include <list>
 #include <memory>
 #include <set>
@@ -413,6 +414,9 @@ private:
     CBlockPolicyEstimator* minerPolicyEstimator;
 
     uint64_t totalTxSize;      //!< sum of all mempool tx' byte sizes
+    //! Copies of the transaction count and totalTxSize, readable without cs
+    std::atomic<unsigned long> nSizeSnapshot;
+    std::atomic<uint64_t> nTotalTxSizeSnapshot;
     uint64_t cachedInnerUsage; //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
 
     CFeeRate minReasonableRelayFee;
@@ -633,6 +637,10 @@ public:
         return totalTxSize;
     }
 
+    /** Same as size() and GetTotalTxSize(), without waiting for cs */
+    unsigned long GetSizeSnapshot() const { return nSizeSnapshot; }
+    uint64_t GetTotalTxSizeSnapshot() const { return nTotalTxSizeSnapshot; }
+
     bool exists(uint256 hash) const
     {
         LOCK(cs);
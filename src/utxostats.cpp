@@ -0,0 +1,72 @@
+// Copyright (c) 2019 The GravityCoin Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxostats.h"
+
+#include "clientversion.h"
+#include "coins.h"
+#include "hash.h"
+
+using secp_primitives::GroupElement;
+
+namespace {
+
+GroupElement OutputPoint(const uint256& txid, unsigned int n, const CCoins& coins)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << txid << VARINT(n) << VARINT(coins.nHeight * 2 + (coins.fCoinBase ? 1 : 0)) << coins.vout[n];
+    uint256 seed = ss.GetHash();
+    GroupElement point;
+    point.generate(seed.begin());
+    return point;
+}
+
+bool HasOutput(const CCoins* pcoins, unsigned int n)
+{
+    return pcoins && pcoins->IsAvailable(n);
+}
+
+}
+
+void CUTXOStats::Update(const uint256& txid, const CCoins* pcoinsBefore, const CCoins* pcoinsAfter)
+{
+    if (pcoinsBefore && !pcoinsBefore->IsPruned()) {
+        nTransactions--;
+        nSerializedSize -= 32 + ::GetSerializeSize(*pcoinsBefore, SER_DISK, CLIENT_VERSION);
+    }
+    if (pcoinsAfter && !pcoinsAfter->IsPruned()) {
+        nTransactions++;
+        nSerializedSize += 32 + ::GetSerializeSize(*pcoinsAfter, SER_DISK, CLIENT_VERSION);
+    }
+
+    size_t nOutputs = std::max(pcoinsBefore ? pcoinsBefore->vout.size() : 0, pcoinsAfter ? pcoinsAfter->vout.size() : 0);
+    for (unsigned int i = 0; i < nOutputs; i++) {
+        bool fBefore = HasOutput(pcoinsBefore, i);
+        bool fAfter = HasOutput(pcoinsAfter, i);
+        // Outputs of a transaction only ever get spent, so an output present
+        // on both sides is the same one
+        if (fBefore == fAfter)
+            continue;
+        const CCoins& coins = fBefore ? *pcoinsBefore : *pcoinsAfter;
+        GroupElement point = OutputPoint(txid, i, coins);
+        if (fBefore) {
+            nTransactionOutputs--;
+            nTotalAmount -= coins.vout[i].nValue;
+            multiset += point.inverse();
+        } else {
+            nTransactionOutputs++;
+            nTotalAmount += coins.vout[i].nValue;
+            multiset += point;
+        }
+    }
+}
+
+uint256 CUTXOStats::GetHash() const
+{
+    if (multiset == GroupElement())
+        return uint256();
+    std::vector<unsigned char> vch(GroupElement::serialize_size);
+    multiset.serialize(vch.data());
+    return Hash(vch.begin(), vch.end());
+}
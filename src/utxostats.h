@@ -0,0 +1,61 @@
+// Copyright (c) 2019 The GravityCoin Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef GRAVITYCOIN_UTXOSTATS_H
+#define GRAVITYCOIN_UTXOSTATS_H
+
+#include "amount.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <secp256k1/include/GroupElement.h>
+
+class CCoins;
+
+/**
+ * Statistics about the unspent transaction output set as of a block, kept up
+ * to date while blocks are connected, so they can be reported without walking
+ * the chainstate.
+ *
+ * The set itself is summarized by a multiset hash: every unspent output maps
+ * to a curve point, and the set hashes to the sum of the points of its members.
+ * Creating an output adds its point, spending it adds the inverse, so the hash
+ * only depends on the contents of the set and not on how it was reached.
+ */
+class CUTXOStats
+{
+public:
+    //! Number of transactions with unspent outputs
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    //! Size of the chainstate entries, as reported by gettxoutsetinfo
+    uint64_t nSerializedSize;
+    CAmount nTotalAmount;
+    secp_primitives::GroupElement multiset;
+
+    CUTXOStats() : nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(VARINT(nTransactions));
+        READWRITE(VARINT(nTransactionOutputs));
+        READWRITE(VARINT(nSerializedSize));
+        READWRITE(nTotalAmount);
+        READWRITE(multiset);
+    }
+
+    /**
+     * Account for the unspent outputs of transaction txid changing from
+     * pcoinsBefore to pcoinsAfter. Either may be NULL or pruned if the
+     * transaction had or has no unspent outputs.
+     */
+    void Update(const uint256& txid, const CCoins* pcoinsBefore, const CCoins* pcoinsAfter);
+
+    //! Digest of the multiset hash
+    uint256 GetHash() const;
+};
+
+#endif // GRAVITYCOIN_UTXOSTATS_H
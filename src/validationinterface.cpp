@@ -4,10 +4,138 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "validationinterface.h"
+
+#include "chain.h"
+#include "main.h"
+#include "netbase.h"
+#include "primitives/block.h"
 #include "util.h"
 
+#include <deque>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread.hpp>
+
 static CMainSignals g_signals;
 
+namespace {
+
+/** Notifications to listeners, delivered in order by a single background thread */
+class CValidationQueue
+{
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<boost::function<void ()> > queue;
+    //! Whether a notification taken off the queue is being delivered
+    bool fBusy;
+    bool fStop;
+    boost::thread thread;
+
+    void Loop()
+    {
+        RenameThread("bitcoin-valqueue");
+        while (true) {
+            boost::function<void ()> func;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                fBusy = false;
+                cond.notify_all();
+                while (!fStop && queue.empty())
+                    cond.wait(lock);
+                // Pending notifications are delivered before stopping
+                if (queue.empty())
+                    return;
+                func.swap(queue.front());
+                queue.pop_front();
+                fBusy = true;
+            }
+            try {
+                func();
+            } catch (const std::exception& e) {
+                PrintExceptionContinue(&e, "valqueue");
+            } catch (...) {
+                PrintExceptionContinue(NULL, "valqueue");
+            }
+        }
+    }
+
+    bool IsRunning() const { return thread.get_id() != boost::thread::id(); }
+
+public:
+    CValidationQueue() : fBusy(false), fStop(false) {}
+
+    void Start()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (IsRunning())
+            return;
+        fStop = false;
+        thread = boost::thread(boost::bind(&CValidationQueue::Loop, this));
+    }
+
+    void Stop()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (!IsRunning())
+                return;
+            fStop = true;
+        }
+        cond.notify_all();
+        thread.join();
+
+        // Deliver what was queued while the thread was finishing
+        std::deque<boost::function<void ()> > remaining;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            thread = boost::thread();
+            remaining.swap(queue);
+        }
+        for (size_t i = 0; i < remaining.size(); i++)
+            remaining[i]();
+    }
+
+    void Push(const boost::function<void ()>& func)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (IsRunning()) {
+                queue.push_back(func);
+                cond.notify_all();
+                return;
+            }
+        }
+        func();
+    }
+
+    /** Wait until no more than nMax notifications are pending */
+    void Wait(size_t nMax)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        // Listeners waiting on their own notifications would never return
+        if (!IsRunning() || boost::this_thread::get_id() == thread.get_id())
+            return;
+        while (queue.size() + (fBusy ? 1 : 0) > nMax)
+            cond.wait(lock);
+    }
+};
+
+CValidationQueue g_queue;
+
+void DeliverSyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, const boost::shared_ptr<const CBlock>& pblock)
+{
+    g_signals.SyncTransaction(tx, pindex, pblock.get());
+}
+
+void DeliverSyncBlock(const boost::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, bool fConnected)
+{
+    for (size_t i = 0; i < pblock->vtx.size(); i++)
+        g_signals.SyncTransaction(pblock->vtx[i], pindex, fConnected ? pblock.get() : NULL);
+}
+
+}
+
 CMainSignals& GetMainSignals()
 {
     return g_signals;
@@ -23,9 +151,13 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
+    g_signals.XnodeChanged.connect(boost::bind(&CValidationInterface::XnodeChanged, pwalletIn, _1, _2, _3, _4));
+    g_signals.ExodusTransaction.connect(boost::bind(&CValidationInterface::ExodusTransaction, pwalletIn, _1, _2, _3, _4, _5, _6));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
+    g_signals.ExodusTransaction.disconnect(boost::bind(&CValidationInterface::ExodusTransaction, pwalletIn, _1, _2, _3, _4, _5, _6));
+    g_signals.XnodeChanged.disconnect(boost::bind(&CValidationInterface::XnodeChanged, pwalletIn, _1, _2, _3, _4));
     g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
     g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
@@ -38,6 +170,8 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
 }
 
 void UnregisterAllValidationInterfaces() {
+    g_signals.ExodusTransaction.disconnect_all_slots();
+    g_signals.XnodeChanged.disconnect_all_slots();
     g_signals.BlockFound.disconnect_all_slots();
     g_signals.ScriptForMining.disconnect_all_slots();
     g_signals.BlockChecked.disconnect_all_slots();
@@ -50,5 +184,55 @@ void UnregisterAllValidationInterfaces() {
 }
 
 void SyncWithWallets(const CTransaction &tx, const CBlockIndex *pindex, const CBlock *pblock) {
-    g_signals.SyncTransaction(tx, pindex, pblock);
+    boost::shared_ptr<const CBlock> pblockCopy;
+    if (pblock)
+        pblockCopy = boost::make_shared<const CBlock>(*pblock);
+    g_queue.Push(boost::bind(&DeliverSyncTransaction, tx, pindex, pblockCopy));
+}
+
+void SyncBlockWithWallets(const boost::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, bool fConnected) {
+    g_queue.Push(boost::bind(&DeliverSyncBlock, pblock, pindex, fConnected));
+}
+
+void NotifyUpdatedBlockTip(const CBlockIndex *pindex) {
+    g_queue.Push(boost::bind(boost::ref(g_signals.UpdatedBlockTip), pindex));
+}
+
+void NotifySetBestChain(const CBlockLocator &locator) {
+    g_queue.Push(boost::bind(boost::ref(g_signals.SetBestChain), locator));
+}
+
+void NotifyUpdatedTransaction(const uint256 &hash) {
+    g_queue.Push(boost::bind(boost::ref(g_signals.UpdatedTransaction), hash));
+}
+
+void NotifyXnodeChanged(const COutPoint &outpoint, const CService &addr, int nState, XnodeChange change) {
+    g_queue.Push(boost::bind(boost::ref(g_signals.XnodeChanged), outpoint, addr, nState, change));
+}
+
+void NotifyExodusTransaction(const uint256 &txid, const CBlockIndex *pindex, unsigned int idx, unsigned int type, unsigned short version, int result) {
+    g_queue.Push(boost::bind(boost::ref(g_signals.ExodusTransaction), txid, pindex, idx, type, version, result));
+}
+
+void StartValidationInterfaceQueue() {
+    g_queue.Start();
+}
+
+void StopValidationInterfaceQueue() {
+    g_queue.Stop();
+}
+
+void CallFunctionInValidationInterfaceQueue(const boost::function<void ()> &func) {
+    g_queue.Push(func);
+}
+
+void SyncWithValidationInterfaceQueue() {
+    // The listeners may need cs_main to get through the queue
+    AssertLockNotHeld(cs_main);
+    g_queue.Wait(0);
+}
+
+void LimitValidationInterfaceQueue() {
+    AssertLockNotHeld(cs_main);
+    g_queue.Wait(MAX_VALIDATION_QUEUE_SIZE);
 }
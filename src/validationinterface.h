@@ -6,6 +6,7 @@
 #ifndef BITCOIN_VALIDATIONINTERFACE_H
 #define BITCOIN_VALIDATIONINTERFACE_H
 
+#include <boost/function.hpp>
 #include <boost/signals2/signal.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -13,7 +14,9 @@ class CBlock;
 class CBlockIndex;
 struct CBlockLocator;
 class CBlockIndex;
+class COutPoint;
 class CReserveScript;
+class CService;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
@@ -29,6 +32,47 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 void UnregisterAllValidationInterfaces();
 /** Push an updated transaction to all registered wallets */
 void SyncWithWallets(const CTransaction& tx, const CBlockIndex *pindex, const CBlock* pblock = NULL);
+/** Push all transactions of a block that was connected (fConnected) or disconnected to all registered wallets */
+void SyncBlockWithWallets(const boost::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, bool fConnected);
+/** Notify all registered listeners of an updated block chain tip */
+void NotifyUpdatedBlockTip(const CBlockIndex *pindex);
+/** Notify all registered listeners of a new active block chain */
+void NotifySetBestChain(const CBlockLocator &locator);
+/** Notify all registered listeners of an updated transaction without new data */
+void NotifyUpdatedTransaction(const uint256 &hash);
+
+/** Ways an xnode list entry can change */
+enum XnodeChange {
+    XNODE_LIST_ADDED,
+    XNODE_LIST_STATE,
+    XNODE_LIST_REMOVED
+};
+
+/** Notify all registered listeners of a change to the xnode list */
+void NotifyXnodeChanged(const COutPoint &outpoint, const CService &addr, int nState, XnodeChange change);
+/** Notify all registered listeners of the result of processing an Exodus transaction */
+void NotifyExodusTransaction(const uint256 &txid, const CBlockIndex *pindex, unsigned int idx, unsigned int type, unsigned short version, int result);
+
+/**
+ * The notifications above are delivered in order by a single background
+ * thread, so validation does not wait for the listeners while holding
+ * cs_main. Before the thread is started and after it is stopped they are
+ * delivered right away on the calling thread.
+ */
+
+/** Maximum number of notifications pending before block connection waits for the listeners */
+static const size_t MAX_VALIDATION_QUEUE_SIZE = 1000;
+
+/** Start delivering notifications on a background thread */
+void StartValidationInterfaceQueue();
+/** Deliver all pending notifications, and go back to delivering them on the calling thread */
+void StopValidationInterfaceQueue();
+/** Run func on the notification thread, after all notifications queued so far */
+void CallFunctionInValidationInterfaceQueue(const boost::function<void ()>& func);
+/** Wait until all notifications queued so far have been delivered. Must not be called with cs_main held. */
+void SyncWithValidationInterfaceQueue();
+/** Wait until at most MAX_VALIDATION_QUEUE_SIZE notifications are pending. Must not be called with cs_main held. */
+void LimitValidationInterfaceQueue();
 
 class CValidationInterface {
 protected:
@@ -41,6 +85,8 @@ protected:
     virtual void BlockChecked(const CBlock&, const CValidationState&) {}
     virtual void GetScriptForMining(boost::shared_ptr<CReserveScript>&) {};
     virtual void ResetRequestCount(const uint256 &hash) {};
+    virtual void XnodeChanged(const COutPoint &outpoint, const CService &addr, int nState, XnodeChange change) {}
+    virtual void ExodusTransaction(const uint256 &txid, const CBlockIndex *pindex, unsigned int idx, unsigned int type, unsigned short version, int result) {}
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
@@ -65,6 +111,10 @@ struct CMainSignals {
     boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
     /** Notifies listeners that a block has been successfully mined */
     boost::signals2::signal<void (const uint256 &)> BlockFound;
+    /** Notifies listeners of an xnode being added to, changing state in or removed from the xnode list */
+    boost::signals2::signal<void (const COutPoint &, const CService &, int, XnodeChange)> XnodeChanged;
+    /** Notifies listeners of the result of processing an Exodus transaction (result 0 if valid) */
+    boost::signals2::signal<void (const uint256 &, const CBlockIndex *, unsigned int, unsigned int, unsigned short, int)> ExodusTransaction;
 };
 
 CMainSignals& GetMainSignals();
@@ -1486,6 +1486,55 @@ void AcentryToJSON(const CAccountingEntry& acentry, const string& strAccount, Un
     }
 }
 
+/** Number of entries listtransactions produces at once, while holding the locks */
+static const size_t LIST_TRANSACTIONS_BATCH_SIZE = 1000;
+
+// Lists the entries of an item of CWallet::wtxOrdered, like listtransactions does
+static void ListOrderedItem(const CWallet::TxPair& item, const string& strAccount, bool fLong, const isminefilter& filter, UniValue& ret)
+{
+    CWalletTx *const pwtx = item.first;
+    if (pwtx != 0)
+        ListTransactions(*pwtx, strAccount, 0, fLong, ret, filter);
+    CAccountingEntry *const pacentry = item.second;
+    if (pacentry != 0)
+        AcentryToJSON(*pacentry, strAccount, ret);
+}
+
+// An item of CWallet::wtxOrdered that listtransactions lists, by what identifies
+// it rather than by pointer, as it may be removed while the locks are released
+struct ListedItem
+{
+    int64_t nOrderPos;
+    //! Null for accounting entries
+    uint256 txid;
+    //! Number of entries the item had when counted
+    int nEntries;
+
+    ListedItem(int64_t nOrderPosIn, const CWallet::TxPair& item, int nEntriesIn)
+      : nOrderPos(nOrderPosIn), txid(item.first ? item.first->GetHash() : uint256()), nEntries(nEntriesIn) {}
+};
+
+// Looks a listed item up again, returns false if it is gone
+static bool FindListedItem(const ListedItem& listed, CWallet::TxPair& item)
+{
+    AssertLockHeld(pwalletMain->cs_wallet);
+    if (!listed.txid.IsNull()) {
+        std::map<uint256, CWalletTx>::iterator it = pwalletMain->mapWallet.find(listed.txid);
+        if (it == pwalletMain->mapWallet.end())
+            return false;
+        item = CWallet::TxPair(&it->second, (CAccountingEntry*)0);
+        return true;
+    }
+    std::pair<CWallet::TxItems::iterator, CWallet::TxItems::iterator> range = pwalletMain->wtxOrdered.equal_range(listed.nOrderPos);
+    for (CWallet::TxItems::iterator it = range.first; it != range.second; ++it) {
+        if (it->second.second != 0) {
+            item = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
 UniValue listtransactions(const UniValue& params, bool fHelp)
 {
     if (!EnsureWalletIsAvailable(fHelp))
@@ -1550,8 +1599,6 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
             + HelpExampleRpc("listtransactions", "\"*\", 20, 100")
         );
 
-    LOCK2(cs_main, pwalletMain->cs_wallet);
-
     string strAccount = "*";
     if (params.size() > 0)
         strAccount = params[0].get_str();
@@ -1571,46 +1618,63 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
     if (nFrom < 0)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative from");
 
-    UniValue ret(UniValue::VARR);
-
-    const CWallet::TxItems & txOrdered = pwalletMain->wtxOrdered;
-
-    // iterate backwards until we have nCount items to return:
-    for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it)
+    // The result is the entries nFrom to nFrom+nCount, counted from the newest,
+    // returned oldest to newest. To stream the entries as they are produced,
+    // first count the entries of the newest items, then produce the ones in
+    // range starting from the oldest item. Counting doesn't need the long form.
+    std::vector<ListedItem> vItems;
+    int nEntries = 0;
     {
-        CWalletTx *const pwtx = (*it).second.first;
-        if (pwtx != 0)
-            ListTransactions(*pwtx, strAccount, 0, true, ret, filter);
-        CAccountingEntry *const pacentry = (*it).second.second;
-        if (pacentry != 0)
-            AcentryToJSON(*pacentry, strAccount, ret);
-
-        if ((int)ret.size() >= (nCount+nFrom)) break;
-    }
-    // ret is newest to oldest
-
-    if (nFrom > (int)ret.size())
-        nFrom = ret.size();
-    if ((nFrom + nCount) > (int)ret.size())
-        nCount = ret.size() - nFrom;
-
-    vector<UniValue> arrTmp = ret.getValues();
+        LOCK2(cs_main, pwalletMain->cs_wallet);
 
-    vector<UniValue>::iterator first = arrTmp.begin();
-    std::advance(first, nFrom);
-    vector<UniValue>::iterator last = arrTmp.begin();
-    std::advance(last, nFrom+nCount);
+        const CWallet::TxItems & txOrdered = pwalletMain->wtxOrdered;
 
-    if (last != arrTmp.end()) arrTmp.erase(last, arrTmp.end());
-    if (first != arrTmp.begin()) arrTmp.erase(arrTmp.begin(), first);
-
-    std::reverse(arrTmp.begin(), arrTmp.end()); // Return oldest to newest
+        for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend() && nEntries < nFrom + nCount; ++it)
+        {
+            UniValue entries(UniValue::VARR);
+            ListOrderedItem((*it).second, strAccount, false, filter, entries);
+            if (entries.size() > 0)
+                vItems.push_back(ListedItem((*it).first, (*it).second, (int)entries.size()));
+            nEntries += entries.size();
+        }
+    }
 
-    ret.clear();
-    ret.setArray();
-    ret.push_backV(arrTmp);
+    // The locks are only held while producing a batch of entries, not while
+    // the reply is written to the client. Items removed from the wallet in
+    // between, e.g. by removeprunedfunds, are skipped.
+    JSONWriter result(RPCResultSink());
+    result.BeginArray();
+    int nPos = nEntries;
+    std::vector<ListedItem>::reverse_iterator rit = vItems.rbegin();
+    while (rit != vItems.rend())
+    {
+        std::vector<UniValue> vBatch;
+        {
+            LOCK2(cs_main, pwalletMain->cs_wallet);
+            for (; rit != vItems.rend() && vBatch.size() < LIST_TRANSACTIONS_BATCH_SIZE; ++rit)
+            {
+                // Entries of this item are at nPos to nPos+count-1, newest first
+                nPos -= rit->nEntries;
+                if (nPos >= nFrom + nCount || nPos + rit->nEntries <= nFrom)
+                    continue;
+                CWallet::TxPair item;
+                if (!FindListedItem(*rit, item))
+                    continue;
+                UniValue entries(UniValue::VARR);
+                ListOrderedItem(item, strAccount, true, filter, entries);
+                for (int i = std::min((int)entries.size(), rit->nEntries) - 1; i >= 0; i--)
+                {
+                    if (nPos + i >= nFrom && nPos + i < nFrom + nCount)
+                        vBatch.push_back(entries[i]);
+                }
+            }
+        }
+        BOOST_FOREACH(const UniValue& entry, vBatch)
+            result.push_back(entry);
+    }
+    result.EndArray();
 
-    return ret;
+    return result.Finish();
 }
 
 UniValue listaccounts(const UniValue& params, bool fHelp)
@@ -3507,7 +3571,8 @@ UniValue listsigmamints(const UniValue& params, bool fHelp) {
     list <CSigmaEntry> listPubcoin;
     CWalletDB walletdb(pwalletMain->strWalletFile);
     listPubcoin = zwalletMain->GetTracker().MintsAsZerocoinEntries(false, false);
-    UniValue results(UniValue::VARR);
+    JSONWriter results(RPCResultSink());
+    results.BeginArray();
 
     BOOST_FOREACH(const CSigmaEntry &zerocoinItem, listPubcoin) {
         if (fAllStatus || zerocoinItem.IsUsed || (zerocoinItem.randomness != uint64_t(0) && zerocoinItem.serialNumber != uint64_t(0))) {
@@ -3523,7 +3588,8 @@ UniValue listsigmamints(const UniValue& params, bool fHelp) {
         }
     }
 
-    return results;
+    results.EndArray();
+    return results.Finish();
 }
 
 
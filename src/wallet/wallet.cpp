@@ -31,6 +31,7 @@
 #include "script/sign.h"
 #include "timedata.h"
 #include "txmempool.h"
+#include "blockprefetcher.h"
 #include "util.h"
 #include "ui_interface.h"
 #include "utilmoneystr.h"
@@ -1167,19 +1168,30 @@ void CWallet::SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex,
 //    LogPrintf("SyncTransaction()\n");
     LOCK2(cs_main, cs_wallet);
 
-    if (!AddToWalletIfInvolvingMe(tx, pblock, true)) {
-//        LogPrintf("Not mine!\n");
-        return; // Not one of ours
+    if (AddToWalletIfInvolvingMe(tx, pblock, true)) {
+        // If a transaction changes 'conflicted' state, that changes the balance
+        // available of the outputs it spends. So force those to be
+        // recomputed, also:
+        BOOST_FOREACH(const CTxIn &txin, tx.vin)
+        {
+            if (mapWallet.count(txin.prevout.hash))
+                mapWallet[txin.prevout.hash].MarkDirty();
+        }
     }
 
-    // If a transaction changes 'conflicted' state, that changes the balance
-    // available of the outputs it spends. So force those to be
-    // recomputed, also:
-    BOOST_FOREACH(const CTxIn &txin, tx.vin)
-    {
-        if (mapWallet.count(txin.prevout.hash))
-            mapWallet[txin.prevout.hash].MarkDirty();
-    }
+    // Also run for foreign transactions: UpdatedBlockTip is not signalled
+    // during initial download, and this is how the balance cache and the
+    // mint tracker notice the tip has moved then
+    UpdateBalances();
+    if (zwalletMain)
+        zwalletMain->GetTracker().UpdateChainHeight();
+}
+
+void CWallet::UpdatedBlockTip(const CBlockIndex *pindex) {
+    LOCK2(cs_main, cs_wallet);
+    UpdateBalances();
+    if (zwalletMain)
+        zwalletMain->GetTracker().UpdateChainHeight();
 }
 
 
@@ -1534,17 +1546,117 @@ void CWalletTx::GetAccountAmounts(const string &strAccount, CAmount &nReceived,
     }
 }
 
+//! Number of blocks scanned between releases of cs_main and cs_wallet during a rescan
+static const size_t RESCAN_BATCH_SIZE = 100;
+
+namespace {
+
+/**
+ * Pre-filter for the rescan, run on the block reading threads.
+ *
+ * It has to accept every transaction AddToWalletIfInvolvingMe might add
+ * because of its outputs or its sigma inputs, so it only errs towards false
+ * positives. The sigma mints and serials of the wallet are copied upfront,
+ * the keystore has its own lock and is queried directly. Regular inputs are
+ * left to the scanning thread, as they may spend an output found earlier in
+ * the same rescan.
+ */
+class CWalletRescanFilter
+{
+private:
+    const CWallet *pwallet;
+    std::set<uint256> setMintHashes;
+    std::set<uint256> setSerialHashes;
+
+public:
+    CWalletRescanFilter(const CWallet *pwalletIn) : pwallet(pwalletIn)
+    {
+        AssertLockHeld(pwallet->cs_wallet);
+        if (!pwallet->fFileBacked)
+            return;
+
+        CWalletDB walletdb(pwallet->strWalletFile);
+        BOOST_FOREACH(const CHDMint &dMint, walletdb.ListHDMints()) {
+            setMintHashes.insert(dMint.GetPubCoinHash());
+        }
+        std::list<CSigmaSpendEntry> listSpends;
+        walletdb.ListCoinSpendSerial(listSpends);
+        BOOST_FOREACH(const CSigmaSpendEntry &spend, listSpends) {
+            setSerialHashes.insert(primitives::GetSerialHash(spend.coinSerial));
+        }
+
+        // Coins of the HD mint pool, which the rescan may come across
+        // before the mint tracker has seen them
+        BOOST_FOREACH(const PAIRTYPE(uint256, MintPoolEntry) &entry, walletdb.ListMintPool()) {
+            setMintHashes.insert(entry.first);
+        }
+        BOOST_FOREACH(const PAIRTYPE(uint256, GroupElement) &pair, walletdb.ListSerialPubcoinPairs()) {
+            setSerialHashes.insert(pair.first);
+        }
+    }
+
+    bool operator()(const CTransaction &tx, const CBlockIndex *pindex) const
+    {
+        BOOST_FOREACH(const CTxOut &txout, tx.vout) {
+            if (txout.scriptPubKey.IsSigmaMint()) {
+                try {
+                    GroupElement pubCoin = sigma::ParseSigmaMintScript(txout.scriptPubKey);
+                    if (setMintHashes.count(primitives::GetPubCoinValueHash(pubCoin)))
+                        return true;
+                } catch (std::invalid_argument &) {
+                }
+            } else if (::IsMine(*pwallet, txout.scriptPubKey) != ISMINE_NO) {
+                return true;
+            }
+        }
+
+        BOOST_FOREACH(const CTxIn &txin, tx.vin) {
+            if (txin.IsSigmaSpend()) {
+                std::unique_ptr<sigma::CoinSpend> spend;
+                try {
+                    std::tie(spend, std::ignore) = sigma::ParseSigmaSpend(txin);
+                } catch (CBadTxIn &) {
+                    continue;
+                } catch (std::ios_base::failure &) {
+                    continue;
+                }
+                if (setSerialHashes.count(primitives::GetSerialHash(spend->getCoinSerialNumber())))
+                    return true;
+            } else if (txin.IsZerocoinRemint()) {
+                // Remints are rare, leave them to the full check
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+} // namespace
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
+ *
+ * Blocks are read and pre-filtered on worker threads, only the candidate
+ * transactions are passed to AddToWalletIfInvolvingMe. cs_main and cs_wallet
+ * are released every RESCAN_BATCH_SIZE blocks, blocks disconnected meanwhile
+ * are skipped and blocks connected meanwhile are scanned in another round.
  */
 int CWallet::ScanForWalletTransactions(CBlockIndex *pindexStart, bool fUpdate) {
     int ret = 0;
     int64_t nNow = GetTime();
     const CChainParams &chainParams = Params();
 
-    CBlockIndex *pindex = pindexStart;
+    int nThreads = GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS);
+    if (nThreads <= 0)
+        nThreads = std::max(boost::thread::hardware_concurrency(), 1U);
+
+    const CBlockIndex *pindex = pindexStart;
+    double dProgressStart;
+    double dProgressTip;
+    std::unique_ptr<CWalletRescanFilter> filter;
     {
         LOCK2(cs_main, cs_wallet);
 
@@ -1555,36 +1667,77 @@ int CWallet::ScanForWalletTransactions(CBlockIndex *pindexStart, bool fUpdate) {
 
         ShowProgress(_("Rescanning..."),
                      0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
-        double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(),
-                                                                     false);
-        while (pindex) {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99,
-                                                                      (int) ((Checkpoints::GuessVerificationProgress(
-                                                                              chainParams.Checkpoints(), pindex,
-                                                                              false) - dProgressStart) /
-                                                                             (dProgressTip - dProgressStart) * 100))));
-
-            CBlock block;
-            ReadBlockFromDisk(block, pindex, Params().GetConsensus());
-            BOOST_FOREACH(CTransaction & tx, block.vtx)
-            {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-                    ret++;
-            }
-            pindex = chainActive.Next(pindex);
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight,
-                          Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+        dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
+        dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
+
+        filter.reset(new CWalletRescanFilter(this));
+    }
+
+    while (pindex) {
+        // resolve the blocks upfront, so the prefetching threads don't need to access the chain
+        std::vector<const CBlockIndex*> vIndexes;
+        {
+            LOCK(cs_main);
+            for (const CBlockIndex *pindexNext = pindex; pindexNext; pindexNext = chainActive.Next(pindexNext))
+                vIndexes.push_back(pindexNext);
+        }
+
+        CBlockPrefetcher prefetcher(vIndexes, boost::cref(*filter), nThreads, 16 * nThreads);
+        size_t nPos = 0;
+        while (nPos < vIndexes.size()) {
+            LOCK2(cs_main, cs_wallet);
+            for (size_t nEnd = std::min(nPos + RESCAN_BATCH_SIZE, vIndexes.size()); nPos < nEnd; ++nPos) {
+                pindex = vIndexes[nPos];
+                if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+                    ShowProgress(_("Rescanning..."), std::max(1, std::min(99,
+                                                                          (int) ((Checkpoints::GuessVerificationProgress(
+                                                                                  chainParams.Checkpoints(), pindex,
+                                                                                  false) - dProgressStart) /
+                                                                                 (dProgressTip - dProgressStart) * 100))));
+
+                CBlockPrefetcher::Entry entry;
+                prefetcher.Next(entry);
+                if (!entry.fRead || !chainActive.Contains(pindex))
+                    continue;
+
+                const CBlock &block = entry.block;
+                for (size_t i = 0; i < block.vtx.size(); i++) {
+                    const CTransaction &tx = block.vtx[i];
+                    if (entry.vCandidates[i] || (fUpdate && mapWallet.count(tx.GetHash())) || SpendsWalletTx(tx)) {
+                        if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
+                            ret++;
+                    }
+                }
+
+                if (GetTime() >= nNow + 60) {
+                    nNow = GetTime();
+                    LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight,
+                              Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+                }
             }
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+
+        // continue with the blocks connected while the locks were released
+        LOCK(cs_main);
+        if (vIndexes.empty() || vIndexes.back() == chainActive.Tip())
+            break;
+        pindex = chainActive.Next(chainActive.FindFork(vIndexes.back()));
     }
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     return ret;
 }
 
+bool CWallet::SpendsWalletTx(const CTransaction &tx) const {
+    AssertLockHeld(cs_wallet);
+    BOOST_FOREACH(const CTxIn &txin, tx.vin) {
+        if (txin.IsZerocoinSpend() || txin.IsSigmaSpend() || txin.IsZerocoinRemint())
+            continue;
+        if (mapWallet.count(txin.prevout.hash))
+            return true;
+    }
+    return false;
+}
+
 void CWallet::ReacceptWalletTransactions() {
     LogPrintf("CWallet::ReacceptWalletTransactions()\n");
     // If transactions aren't being broadcasted, don't let them into local mempool either
@@ -1670,6 +1823,22 @@ set <uint256> CWalletTx::GetConflicts() const {
     return result;
 }
 
+void CWalletTx::MarkDirty() {
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+
+    // Whatever invalidated the credit caches also invalidates this
+    // transaction's share of the wallet totals
+    if (pwallet)
+        pwallet->MarkBalanceDirty(GetHash());
+}
+
 CAmount CWalletTx::GetDebit(const isminefilter &filter) const {
     if (vin.empty())
         return 0;
@@ -1965,18 +2134,127 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime) {
  */
 
 
-CAmount CWallet::GetBalance() const {
-    CAmount nTotal = 0;
+void CWallet::MarkBalanceDirty(const uint256 &hash) const {
+    LOCK(cs_balances);
+    setBalancePending.insert(hash);
+}
+
+void CWallet::UpdateBalances() const {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    const CBlockIndex *pindexTip = chainActive.Tip();
+
+    std::set<uint256> setPending;
     {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+        LOCK(cs_balances);
+        if (pindexTip != pindexBalances)
+            setBalancePending.insert(setBalanceVolatile.begin(), setBalanceVolatile.end());
+        setPending.swap(setBalancePending);
+    }
+
+    // Credits are computed outside cs_balances: they may mark transactions
+    // dirty again, which would re-enter it
+    std::vector<std::pair<uint256, CWalletBalances>> vUpdates;
+    std::vector<std::pair<uint256, bool>> vVolatile;
+    vUpdates.reserve(setPending.size());
+    vVolatile.reserve(setPending.size());
+    BOOST_FOREACH(const uint256 &hash, setPending) {
+        CWalletBalances contribution;
+        bool fVolatile = false;
+        map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+        if (it != mapWallet.end()) {
+            const CWalletTx &wtx = it->second;
+            int nDepth = wtx.GetDepthInMainChain();
+            bool fTrusted = wtx.IsTrusted();
+            bool fUnconfirmed = !fTrusted && nDepth == 0 && (wtx.InMempool() || wtx.InStempool());
+            if (fTrusted) {
+                contribution.nBalance = wtx.GetAvailableCredit();
+                contribution.nWatchOnly = wtx.GetAvailableWatchOnlyCredit();
+            }
+            if (fUnconfirmed) {
+                contribution.nUnconfirmed = wtx.GetAvailableCredit();
+                contribution.nUnconfirmedWatchOnly = wtx.GetAvailableWatchOnlyCredit();
+            }
+            contribution.nImmature = wtx.GetImmatureCredit();
+            contribution.nImmatureWatchOnly = wtx.GetImmatureWatchOnlyCredit();
+            // Conflicted transactions (negative depth) can come back with a reorg
+            fVolatile = (nDepth <= 0 && !wtx.isAbandoned()) ||
+                        (wtx.IsCoinBase() && nDepth > 0 && wtx.GetBlocksToMaturity() > 0);
+        }
+        vUpdates.push_back(std::make_pair(hash, contribution));
+        vVolatile.push_back(std::make_pair(hash, fVolatile));
+    }
+
+    LOCK(cs_balances);
+    for (size_t i = 0; i < vUpdates.size(); i++) {
+        const uint256 &hash = vUpdates[i].first;
+        std::map<uint256, CWalletBalances>::iterator mi = mapBalanceContributions.find(hash);
+        if (mi != mapBalanceContributions.end()) {
+            balancesCached -= mi->second;
+            mapBalanceContributions.erase(mi);
+        }
+        if (!vUpdates[i].second.IsNull()) {
+            balancesCached += vUpdates[i].second;
+            mapBalanceContributions.insert(vUpdates[i]);
+        }
+        if (vVolatile[i].second)
+            setBalanceVolatile.insert(hash);
+        else
+            setBalanceVolatile.erase(hash);
+    }
+    pindexBalances = pindexTip;
+    nBalancesHeight = pindexTip ? pindexTip->nHeight : -1;
+}
+
+CWalletBalances CWallet::GetBalances(int *pnHeight) const {
+    bool fStale;
+    {
+        LOCK(cs_balances);
+        fStale = !setBalancePending.empty() || pindexBalances == NULL;
+    }
+    // Never wait for cs_main here. Callers that hold it, like the RPC
+    // handlers, get the pending transactions folded in; the others get the
+    // totals as of the last fold, which the next wallet event brings up to
+    // date.
+    if (fStale) {
+        TRY_LOCK(cs_main, lockMain);
+        if (lockMain) {
+            LOCK(cs_wallet);
+            UpdateBalances();
         }
     }
 
-    return nTotal;
+    LOCK(cs_balances);
+    if (pnHeight)
+        *pnHeight = nBalancesHeight;
+    return balancesCached;
+}
+
+bool CWallet::TryGetBalances(CWalletBalances &balances, int &nHeight) const {
+    bool fStale;
+    {
+        LOCK(cs_balances);
+        fStale = !setBalancePending.empty() || pindexBalances == NULL;
+    }
+    if (fStale) {
+        TRY_LOCK(cs_main, lockMain);
+        if (!lockMain)
+            return false;
+        TRY_LOCK(cs_wallet, lockWallet);
+        if (!lockWallet)
+            return false;
+        UpdateBalances();
+    }
+
+    LOCK(cs_balances);
+    balances = balancesCached;
+    nHeight = nBalancesHeight;
+    return true;
+}
+
+CAmount CWallet::GetBalance() const {
+    return GetBalances().nBalance;
 }
 
 CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated) const {
@@ -2421,57 +2699,19 @@ bool CWallet::GetCoinsToSpend(
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 &&
-                (pcoin->InMempool() || pcoin->InStempool()))
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchOnly;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 &&
-                (pcoin->InMempool() || pcoin->InStempool()))
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmedWatchOnly;
 }
 
 // Recursively determine the rounds of a given input (How deep is the PrivateSend chain for a given input)
@@ -2627,15 +2867,7 @@ bool CWallet::IsCollateralAmount(CAmount nInputAmount) const {
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmatureWatchOnly;
 }
 
 void CWallet::AvailableCoins(vector <COutput> &vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl,
@@ -2894,49 +3126,35 @@ void CWallet::ListAvailableSigmaMintCoins(vector<COutput> &vCoins, bool fOnlyCon
 
     vCoins.clear();
     LOCK2(cs_main, cs_wallet);
-    list<CSigmaEntry> listOwnCoins;
-    CWalletDB walletdb(pwalletMain->strWalletFile);
-    listOwnCoins = zwalletMain->GetTracker().MintsAsZerocoinEntries();
-    LogPrintf("listOwnCoins.size()=%s\n", listOwnCoins.size());
-    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-        const CWalletTx *pcoin = &(*it).second;
-//        LogPrintf("pcoin=%s\n", pcoin->GetHash().ToString());
-        if (!CheckFinalTx(*pcoin)) {
-            LogPrintf("!CheckFinalTx(*pcoin)=%s\n", !CheckFinalTx(*pcoin));
+
+    // Start from the tracker's metadata of unspent mints and look up only the
+    // transactions holding them, rather than scanning all of mapWallet. Mints
+    // of any depth are listed, callers filter them by confirmations.
+    std::vector<CMintMeta> listMints = zwalletMain->GetTracker().ListMints(true, false, false);
+    LogPrintf("listMints.size()=%s\n", listMints.size());
+    for (const CMintMeta& mint : listMints) {
+        if (mint.txid.IsNull())
             continue;
-        }
 
-        if (fOnlyConfirmed && !pcoin->IsTrusted()) {
-            LogPrintf("fOnlyConfirmed = %s, !pcoin->IsTrusted()\n", fOnlyConfirmed, !pcoin->IsTrusted());
+        map<uint256, CWalletTx>::const_iterator it = mapWallet.find(mint.txid);
+        if (it == mapWallet.end())
             continue;
-        }
 
-        if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0) {
-            LogPrintf("Not trusted\n");
+        const CWalletTx *pcoin = &(*it).second;
+        if (!CheckFinalTx(*pcoin))
+            continue;
+
+        if (fOnlyConfirmed && !pcoin->IsTrusted())
             continue;
-        }
 
         int nDepth = pcoin->GetDepthInMainChain();
-        if (nDepth < 0) {
-            LogPrintf("nDepth=%s\n", nDepth);
+        if (nDepth < 0)
             continue;
-        }
-        LogPrintf("pcoin->vout.size()=%s\n", pcoin->vout.size());
 
         for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-            if (pcoin->vout[i].scriptPubKey.IsSigmaMint()) {
-                CTxOut txout = pcoin->vout[i];
-                secp_primitives::GroupElement pubCoin = sigma::ParseSigmaMintScript(
-                    txout.scriptPubKey);
-                LogPrintf("Pubcoin=%s\n", pubCoin.tostring());
-                // CHECKING PROCESS
-                BOOST_FOREACH(const CSigmaEntry &ownCoinItem, listOwnCoins) {
-                   if (ownCoinItem.value == pubCoin && ownCoinItem.IsUsed == false &&
-                        ownCoinItem.randomness != uint64_t(0) && ownCoinItem.serialNumber != uint64_t(0)) {
-                        vCoins.push_back(COutput(pcoin, i, nDepth, true, true));
-                        LogPrintf("-->OK\n");
-                    }
-                }
+            if (pcoin->vout[i].scriptPubKey.IsSigmaMint() &&
+                sigma::ParseSigmaMintScript(pcoin->vout[i].scriptPubKey) == mint.GetPubCoinValue()) {
+                vCoins.push_back(COutput(pcoin, i, nDepth, true, true));
             }
         }
     }
@@ -7741,6 +7959,8 @@ std::string CWallet::GetWalletHelpString(bool showDebug) {
     strUsage += HelpMessageOpt("-disablewallet", _("Do not load the wallet and disable wallet RPC calls"));
     strUsage += HelpMessageOpt("-keypool=<n>",
                                strprintf(_("Set key pool size to <n> (default: %u)"), DEFAULT_KEYPOOL_SIZE));
+    strUsage += HelpMessageOpt("-mintpoolsize=<n>",
+                               strprintf(_("Set the number of HD Sigma mints generated ahead of use to <n> (default: %u)"), DEFAULT_MINTPOOL_SIZE));
     strUsage += HelpMessageOpt("-fallbackfee=<amt>", strprintf(
             _("A fee rate (in %s/kB) that will be used when fee estimation has insufficient data (default: %s)"),
             CURRENCY_UNIT, FormatMoney(DEFAULT_FALLBACK_FEE)));
@@ -7751,6 +7971,9 @@ std::string CWallet::GetWalletHelpString(bool showDebug) {
                                strprintf(_("Fee (in %s/kB) to add to transactions you send (default: %s)"),
                                          CURRENCY_UNIT, FormatMoney(payTxFee.GetFeePerK())));
     strUsage += HelpMessageOpt("-rescan", _("Rescan the block chain for missing wallet transactions on startup"));
+    strUsage += HelpMessageOpt("-rescanthreads=<n>",
+                               strprintf(_("Number of threads reading and filtering blocks during a rescan (0 = number of cores, default: %d)"),
+                                         DEFAULT_RESCAN_THREADS));
     strUsage += HelpMessageOpt("-salvagewallet",
                                _("Attempt to recover private keys from a corrupt wallet on startup"));
     if (showDebug)
@@ -51,6 +51,10 @@ extern bool bSpendZeroConfChange;
 extern bool fSendFreeTransactions;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 100;
+//! -mintpoolsize default
+static const unsigned int DEFAULT_MINTPOOL_SIZE = 20;
+//! -rescanthreads default (0 = number of cores)
+static const int DEFAULT_RESCAN_THREADS = 0;
 //! -paytxfee default
 static const CAmount DEFAULT_TRANSACTION_FEE = 0;
 //! -fallbackfee default
@@ -428,17 +432,7 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -625,6 +619,47 @@ enum MintAlgorithm {
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
  */
+/** Wallet balance totals, or the contribution of a single transaction to them */
+struct CWalletBalances
+{
+    CAmount nBalance;
+    CAmount nUnconfirmed;
+    CAmount nImmature;
+    CAmount nWatchOnly;
+    CAmount nUnconfirmedWatchOnly;
+    CAmount nImmatureWatchOnly;
+
+    CWalletBalances() : nBalance(0), nUnconfirmed(0), nImmature(0), nWatchOnly(0), nUnconfirmedWatchOnly(0), nImmatureWatchOnly(0) {}
+
+    bool IsNull() const
+    {
+        return nBalance == 0 && nUnconfirmed == 0 && nImmature == 0 &&
+               nWatchOnly == 0 && nUnconfirmedWatchOnly == 0 && nImmatureWatchOnly == 0;
+    }
+
+    CWalletBalances& operator+=(const CWalletBalances& other)
+    {
+        nBalance += other.nBalance;
+        nUnconfirmed += other.nUnconfirmed;
+        nImmature += other.nImmature;
+        nWatchOnly += other.nWatchOnly;
+        nUnconfirmedWatchOnly += other.nUnconfirmedWatchOnly;
+        nImmatureWatchOnly += other.nImmatureWatchOnly;
+        return *this;
+    }
+
+    CWalletBalances& operator-=(const CWalletBalances& other)
+    {
+        nBalance -= other.nBalance;
+        nUnconfirmed -= other.nUnconfirmed;
+        nImmature -= other.nImmature;
+        nWatchOnly -= other.nWatchOnly;
+        nUnconfirmedWatchOnly -= other.nUnconfirmedWatchOnly;
+        nImmatureWatchOnly -= other.nImmatureWatchOnly;
+        return *this;
+    }
+};
+
 class CWallet : public CCryptoKeyStore, public CValidationInterface
 {
 private:
@@ -652,6 +687,27 @@ private:
     mutable bool fAnonymizableTallyCachedNonDenom;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
 
+    /**
+     * Balance totals maintained incrementally from wallet events instead of
+     * being recomputed over mapWallet on every query. Each transaction's
+     * contribution is kept so it can be backed out when the transaction is
+     * marked dirty. Transactions whose contribution depends on the chain tip
+     * or on the mempool (unconfirmed and conflicted ones, and immature
+     * coinbases) are kept in setBalanceVolatile and re-evaluated whenever the
+     * tip moves.
+     * cs_balances is a leaf lock and may be taken with or without cs_wallet.
+     */
+    mutable CCriticalSection cs_balances;
+    mutable CWalletBalances balancesCached;
+    mutable std::map<uint256, CWalletBalances> mapBalanceContributions;
+    mutable std::set<uint256> setBalancePending;
+    mutable std::set<uint256> setBalanceVolatile;
+    mutable const CBlockIndex *pindexBalances;
+    mutable int nBalancesHeight;
+
+    //! Fold pending transactions into balancesCached. Requires cs_main and cs_wallet.
+    void UpdateBalances() const;
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -727,6 +783,8 @@ public:
         fAnonymizableTallyCachedNonDenom = false;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
+        pindexBalances = NULL;
+        nBalancesHeight = -1;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -840,8 +898,11 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, const CBlock* pblock);
+    void UpdatedBlockTip(const CBlockIndex *pindex);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    //! Whether a transaction spends an output of a wallet transaction
+    bool SpendsWalletTx(const CTransaction& tx) const;
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime);
@@ -852,6 +913,12 @@ public:
     CAmount GetWatchOnlyBalance() const;
     CAmount GetUnconfirmedWatchOnlyBalance() const;
     CAmount GetImmatureWatchOnlyBalance() const;
+    //! All the totals above at once, together with the height they were computed at
+    CWalletBalances GetBalances(int *pnHeight = NULL) const;
+    //! Same as GetBalances, but fails instead of waiting for cs_main or cs_wallet
+    bool TryGetBalances(CWalletBalances& balances, int& nHeight) const;
+    //! Queue a transaction for re-evaluation by the balance cache
+    void MarkBalanceDirty(const uint256& hash) const;
     // get the PrivateSend chain depth for a given input
     int GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const;
     // respect current settings
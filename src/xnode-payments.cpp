@@ -73,8 +73,115 @@ std::string GetRequiredPaymentsString(int nBlockHeight) {
 
 void CXnodePayments::Clear() {
     LOCK2(cs_mapXnodeBlocks, cs_mapXnodePaymentVotes);
-    mapXnodeBlocks.clear();
+    vecBlockVotes.clear();
     mapXnodePaymentVotes.clear();
+    nHeightExpired = 0;
+    nBlockCount = 0;
+}
+
+CXnodeBlockVotes* CXnodePayments::GetBlockVotes(int nBlockHeight, bool fCreate) {
+    if (nBlockHeight < 0) return NULL;
+
+    if (fCreate) {
+        // only grows, so an xnode count going up and down doesn't move all heights around
+        size_t nSize = GetStorageLimit() + MNPAYMENTS_FUTURE_BLOCKS + 1;
+        if (nSize > vecBlockVotes.size())
+            ResizeBlockVotes(nSize);
+    }
+    if (vecBlockVotes.empty()) return NULL;
+
+    CXnodeBlockVotes& blockVotes = vecBlockVotes[nBlockHeight % vecBlockVotes.size()];
+    if (blockVotes.nBlockHeight == nBlockHeight) return &blockVotes;
+    if (!fCreate || blockVotes.nBlockHeight > nBlockHeight) return NULL;
+
+    ClearBlockVotes(blockVotes);
+    blockVotes.nBlockHeight = nBlockHeight;
+    blockVotes.blockPayees.nBlockHeight = nBlockHeight;
+    // A storage limit that grew lets heights CheckAndRemove dropped already
+    // back in, have it look at them again once they leave the range
+    if (nBlockHeight < nHeightExpired)
+        nHeightExpired = nBlockHeight;
+    return &blockVotes;
+}
+
+void CXnodePayments::ClearBlockVotes(CXnodeBlockVotes& blockVotes) {
+    if (blockVotes.nBlockHeight < 0) return;
+    LogPrint("mnpayments", "CXnodePayments::ClearBlockVotes -- Removing old Xnode payments: nBlockHeight=%d\n", blockVotes.nBlockHeight);
+    BOOST_FOREACH(const uint256& hash, blockVotes.vecVoteHashes) {
+        mapXnodePaymentVotes.erase(hash);
+    }
+    if (!blockVotes.blockPayees.vecPayees.empty())
+        nBlockCount--;
+    blockVotes = CXnodeBlockVotes();
+}
+
+void CXnodePayments::ResizeBlockVotes(size_t nSize) {
+    std::vector<CXnodeBlockVotes> vecBlockVotesOld;
+    vecBlockVotesOld.swap(vecBlockVotes);
+    vecBlockVotes.resize(nSize);
+    BOOST_FOREACH(CXnodeBlockVotes& blockVotesOld, vecBlockVotesOld) {
+        if (blockVotesOld.nBlockHeight < 0) continue;
+        CXnodeBlockVotes& blockVotes = vecBlockVotes[blockVotesOld.nBlockHeight % nSize];
+        if (blockVotes.nBlockHeight > blockVotesOld.nBlockHeight) {
+            ClearBlockVotes(blockVotesOld);
+            continue;
+        }
+        ClearBlockVotes(blockVotes);
+        std::swap(blockVotes, blockVotesOld);
+    }
+}
+
+static bool CompareBlockVotesByHeight(const CXnodeBlockVotes* a, const CXnodeBlockVotes* b) {
+    return a->nBlockHeight < b->nBlockHeight;
+}
+
+std::vector<const CXnodeBlockVotes*> CXnodePayments::GetStoredBlockVotes() const {
+    AssertLockHeld(cs_mapXnodeBlocks);
+    std::vector<const CXnodeBlockVotes*> vecStored;
+    vecStored.reserve(nBlockCount);
+    BOOST_FOREACH(const CXnodeBlockVotes& blockVotes, vecBlockVotes) {
+        if (!blockVotes.blockPayees.vecPayees.empty())
+            vecStored.push_back(&blockVotes);
+    }
+    std::sort(vecStored.begin(), vecStored.end(), CompareBlockVotesByHeight);
+    return vecStored;
+}
+
+void CXnodePayments::LoadBlockPayeesMap(const std::map<int, CXnodeBlockPayees>& mapXnodeBlocks) {
+    LOCK2(cs_mapXnodeBlocks, cs_mapXnodePaymentVotes);
+    vecBlockVotes.clear();
+    nHeightExpired = 0;
+    nBlockCount = 0;
+
+    std::map<uint256, CXnodePaymentVote>::iterator itVote = mapXnodePaymentVotes.begin();
+    while (itVote != mapXnodePaymentVotes.end()) {
+        CXnodeBlockVotes* pblockVotes = GetBlockVotes(itVote->second.nBlockHeight, true);
+        if (pblockVotes) {
+            pblockVotes->vecVoteHashes.push_back(itVote->first);
+            ++itVote;
+        } else {
+            mapXnodePaymentVotes.erase(itVote++);
+        }
+    }
+    for (std::map<int, CXnodeBlockPayees>::const_iterator it = mapXnodeBlocks.begin(); it != mapXnodeBlocks.end(); ++it) {
+        CXnodeBlockVotes* pblockVotes = GetBlockVotes(it->first, false);
+        if (!pblockVotes || it->second.vecPayees.empty()) continue;
+        if (pblockVotes->blockPayees.vecPayees.empty())
+            nBlockCount++;
+        pblockVotes->blockPayees = it->second;
+    }
+}
+
+CXnodeBlockPayees* CXnodePayments::GetBlockPayees(int nBlockHeight) {
+    AssertLockHeld(cs_mapXnodeBlocks);
+    CXnodeBlockVotes* pblockVotes = GetBlockVotes(nBlockHeight, false);
+    if (!pblockVotes || pblockVotes->blockPayees.vecPayees.empty()) return NULL;
+    return &pblockVotes->blockPayees;
+}
+
+bool CXnodePayments::HasBlockPayees(int nBlockHeight) {
+    LOCK(cs_mapXnodeBlocks);
+    return GetBlockPayees(nBlockHeight) != NULL;
 }
 
 bool CXnodePayments::CanVote(COutPoint outXnode, int nBlockHeight) {
@@ -197,26 +304,30 @@ void CXnodePayments::ProcessMessage(CNode *pfrom, std::string &strCommand, CData
 
         pfrom->setAskFor.erase(nHash);
 
+        // votes are only stored for the heights in range
+        int nFirstBlock = pCurrentBlockIndex->nHeight - GetStorageLimit();
+        if (vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > pCurrentBlockIndex->nHeight + MNPAYMENTS_FUTURE_BLOCKS) {
+            LogPrint("mnpayments", "XNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, pCurrentBlockIndex->nHeight);
+            return;
+        }
+
         {
-            LOCK(cs_mapXnodePaymentVotes);
+            LOCK2(cs_mapXnodeBlocks, cs_mapXnodePaymentVotes);
             if (mapXnodePaymentVotes.count(nHash)) {
                 LogPrint("mnpayments", "XNODEPAYMENTVOTE -- hash=%s, nHeight=%d seen\n", nHash.ToString(), pCurrentBlockIndex->nHeight);
                 return;
             }
+            CXnodeBlockVotes* pblockVotes = GetBlockVotes(vote.nBlockHeight, true);
+            if (!pblockVotes) return;
 
             // Avoid processing same vote multiple times
             mapXnodePaymentVotes[nHash] = vote;
+            pblockVotes->vecVoteHashes.push_back(nHash);
             // but first mark vote as non-verified,
             // AddPaymentVote() below should take care of it if vote is actually ok
             mapXnodePaymentVotes[nHash].MarkAsNotVerified();
         }
 
-        int nFirstBlock = pCurrentBlockIndex->nHeight - GetStorageLimit();
-        if (vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > pCurrentBlockIndex->nHeight + 20) {
-            LogPrint("mnpayments", "XNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, pCurrentBlockIndex->nHeight);
-            return;
-        }
-
         std::string strError = "";
         if (!vote.IsValid(pfrom, pCurrentBlockIndex->nHeight, strError)) {
             LogPrint("mnpayments", "XNODEPAYMENTVOTE -- invalid message, error: %s\n", strError);
@@ -287,8 +398,11 @@ bool CXnodePaymentVote::Sign() {
 }
 
 bool CXnodePayments::GetBlockPayee(int nBlockHeight, CScript &payee) {
-    if (mapXnodeBlocks.count(nBlockHeight)) {
-        return mapXnodeBlocks[nBlockHeight].GetBestPayee(payee);
+    LOCK(cs_mapXnodeBlocks);
+
+    CXnodeBlockPayees* pblockPayees = GetBlockPayees(nBlockHeight);
+    if (pblockPayees) {
+        return pblockPayees->GetBestPayee(payee);
     }
 
     return false;
@@ -307,7 +421,8 @@ bool CXnodePayments::IsScheduled(CXnode &mn, int nNotBlockHeight) {
     CScript payee;
     for (int64_t h = pCurrentBlockIndex->nHeight; h <= pCurrentBlockIndex->nHeight + 8; h++) {
         if (h == nNotBlockHeight) continue;
-        if (mapXnodeBlocks.count(h) && mapXnodeBlocks[h].GetBestPayee(payee) && mnpayee == payee) {
+        CXnodeBlockPayees* pblockPayees = GetBlockPayees(h);
+        if (pblockPayees && pblockPayees->GetBestPayee(payee) && mnpayee == payee) {
             return true;
         }
     }
@@ -324,14 +439,17 @@ bool CXnodePayments::AddPaymentVote(const CXnodePaymentVote &vote) {
 
     LOCK2(cs_mapXnodeBlocks, cs_mapXnodePaymentVotes);
 
-    mapXnodePaymentVotes[vote.GetHash()] = vote;
+    CXnodeBlockVotes* pblockVotes = GetBlockVotes(vote.nBlockHeight, true);
+    if (!pblockVotes) return false;
 
-    if (!mapXnodeBlocks.count(vote.nBlockHeight)) {
-        CXnodeBlockPayees blockPayees(vote.nBlockHeight);
-        mapXnodeBlocks[vote.nBlockHeight] = blockPayees;
-    }
+    uint256 hash = vote.GetHash();
+    if (!mapXnodePaymentVotes.count(hash))
+        pblockVotes->vecVoteHashes.push_back(hash);
+    mapXnodePaymentVotes[hash] = vote;
 
-    mapXnodeBlocks[vote.nBlockHeight].AddPayee(vote);
+    if (pblockVotes->blockPayees.vecPayees.empty())
+        nBlockCount++;
+    pblockVotes->blockPayees.AddPayee(vote);
 
     return true;
 }
@@ -467,8 +585,9 @@ std::string CXnodeBlockPayees::GetRequiredPaymentsString() {
 std::string CXnodePayments::GetRequiredPaymentsString(int nBlockHeight) {
     LOCK(cs_mapXnodeBlocks);
 
-    if (mapXnodeBlocks.count(nBlockHeight)) {
-        return mapXnodeBlocks[nBlockHeight].GetRequiredPaymentsString();
+    CXnodeBlockPayees* pblockPayees = GetBlockPayees(nBlockHeight);
+    if (pblockPayees) {
+        return pblockPayees->GetRequiredPaymentsString();
     }
 
     return "Unknown";
@@ -477,8 +596,9 @@ std::string CXnodePayments::GetRequiredPaymentsString(int nBlockHeight) {
 bool CXnodePayments::IsTransactionValid(const CTransaction &txNew, int nBlockHeight) {
     LOCK(cs_mapXnodeBlocks);
 
-    if (mapXnodeBlocks.count(nBlockHeight)) {
-        return mapXnodeBlocks[nBlockHeight].IsTransactionValid(txNew);
+    CXnodeBlockPayees* pblockPayees = GetBlockPayees(nBlockHeight);
+    if (pblockPayees) {
+        return pblockPayees->IsTransactionValid(txNew);
     }
 
     return true;
@@ -489,21 +609,55 @@ void CXnodePayments::CheckAndRemove() {
 
     LOCK2(cs_mapXnodeBlocks, cs_mapXnodePaymentVotes);
 
-    int nLimit = GetStorageLimit();
+    // Only the heights that left the range since the last run need dropping,
+    // anything older was dropped already
+    int nFirstBlock = pCurrentBlockIndex->nHeight - GetStorageLimit();
+    if (nFirstBlock - nHeightExpired > (int)vecBlockVotes.size()) {
+        // more heights than slots, look at each slot once instead
+        BOOST_FOREACH(CXnodeBlockVotes& blockVotes, vecBlockVotes) {
+            if (blockVotes.nBlockHeight < nFirstBlock)
+                ClearBlockVotes(blockVotes);
+        }
+    } else {
+        for (int h = nHeightExpired; h < nFirstBlock; h++) {
+            CXnodeBlockVotes* pblockVotes = GetBlockVotes(h, false);
+            if (pblockVotes)
+                ClearBlockVotes(*pblockVotes);
+        }
+    }
+    nHeightExpired = std::max(nHeightExpired, nFirstBlock);
+    LogPrintf("CXnodePayments::CheckAndRemove -- %s\n", ToString());
 
-    std::map<uint256, CXnodePaymentVote>::iterator it = mapXnodePaymentVotes.begin();
-    while (it != mapXnodePaymentVotes.end()) {
-        CXnodePaymentVote vote = (*it).second;
+    if (fSanityCheck)
+        Check();
+}
 
-        if (pCurrentBlockIndex->nHeight - vote.nBlockHeight > nLimit) {
-            LogPrint("mnpayments", "CXnodePayments::CheckAndRemove -- Removing old Xnode payment: nBlockHeight=%d\n", vote.nBlockHeight);
-            mapXnodePaymentVotes.erase(it++);
-            mapXnodeBlocks.erase(vote.nBlockHeight);
-        } else {
-            ++it;
+void CXnodePayments::Check() {
+    LOCK2(cs_mapXnodeBlocks, cs_mapXnodePaymentVotes);
+
+    std::set<uint256> setVoteHashes;
+    int nBlocks = 0;
+    for (size_t i = 0; i < vecBlockVotes.size(); i++) {
+        const CXnodeBlockVotes& blockVotes = vecBlockVotes[i];
+        if (blockVotes.nBlockHeight < 0) {
+            assert(blockVotes.vecVoteHashes.empty() && blockVotes.blockPayees.vecPayees.empty());
+            continue;
         }
+        assert(blockVotes.nBlockHeight % vecBlockVotes.size() == i);
+        assert(blockVotes.nBlockHeight >= nHeightExpired);
+        assert(blockVotes.blockPayees.nBlockHeight == blockVotes.nBlockHeight);
+        BOOST_FOREACH(const uint256& hash, blockVotes.vecVoteHashes) {
+            std::map<uint256, CXnodePaymentVote>::const_iterator it = mapXnodePaymentVotes.find(hash);
+            assert(it != mapXnodePaymentVotes.end());
+            assert(it->second.nBlockHeight == blockVotes.nBlockHeight);
+            assert(setVoteHashes.insert(hash).second);
+        }
+        if (!blockVotes.blockPayees.vecPayees.empty())
+            nBlocks++;
     }
-    LogPrintf("CXnodePayments::CheckAndRemove -- %s\n", ToString());
+    // every vote is listed by the slot of its height, exactly once
+    assert(setVoteHashes.size() == mapXnodePaymentVotes.size());
+    assert(nBlocks == nBlockCount);
 }
 
 bool CXnodePaymentVote::IsValid(CNode *pnode, int nValidationHeight, std::string &strError) {
@@ -630,7 +784,7 @@ void CXnodePaymentVote::Relay() {
     RelayInv(inv);
 }
 
-bool CXnodePaymentVote::CheckSignature(const CPubKey &pubKeyXnode, int nValidationHeight, int &nDos) {
+bool CXnodePaymentVote::CheckSignature(const CPubKey &pubKeyXnode, int nValidationHeight, int &nDos, bool fLog) {
     // do not ban by default
     nDos = 0;
 
@@ -646,6 +800,8 @@ bool CXnodePaymentVote::CheckSignature(const CPubKey &pubKeyXnode, int nValidati
         if (xnodeSync.IsXnodeListSynced() && nBlockHeight > nValidationHeight) {
             nDos = 20;
         }
+        if (!fLog)
+            return false;
         return error("CXnodePaymentVote::CheckSignature -- Got bad Xnode payment signature, xnode=%s, error: %s", vinXnode.prevout.ToStringShort().c_str(), strError);
     }
 
@@ -671,9 +827,10 @@ void CXnodePayments::Sync(CNode *pnode) {
 
     int nInvCount = 0;
 
-    for (int h = pCurrentBlockIndex->nHeight; h < pCurrentBlockIndex->nHeight + 20; h++) {
-        if (mapXnodeBlocks.count(h)) {
-            BOOST_FOREACH(CXnodePayee & payee, mapXnodeBlocks[h].vecPayees)
+    for (int h = pCurrentBlockIndex->nHeight; h < pCurrentBlockIndex->nHeight + MNPAYMENTS_FUTURE_BLOCKS; h++) {
+        CXnodeBlockPayees* pblockPayees = GetBlockPayees(h);
+        if (pblockPayees) {
+            BOOST_FOREACH(CXnodePayee & payee, pblockPayees->vecPayees)
             {
                 std::vector <uint256> vecVoteHashes = payee.GetVoteHashes();
                 BOOST_FOREACH(uint256 & hash, vecVoteHashes)
@@ -702,7 +859,7 @@ void CXnodePayments::RequestLowDataPaymentBlocks(CNode *pnode) {
     const CBlockIndex *pindex = pCurrentBlockIndex;
 
     while (pCurrentBlockIndex->nHeight - pindex->nHeight < nLimit) {
-        if (!mapXnodeBlocks.count(pindex->nHeight)) {
+        if (!GetBlockPayees(pindex->nHeight)) {
             // We have no idea about this block height, let's ask
             vToFetch.push_back(CInv(MSG_XNODE_PAYMENT_BLOCK, pindex->GetBlockHash()));
             // We should not violate GETDATA rules
@@ -717,12 +874,16 @@ void CXnodePayments::RequestLowDataPaymentBlocks(CNode *pnode) {
         pindex = pindex->pprev;
     }
 
-    std::map<int, CXnodeBlockPayees>::iterator it = mapXnodeBlocks.begin();
+    std::vector<CXnodeBlockVotes>::iterator it = vecBlockVotes.begin();
 
-    while (it != mapXnodeBlocks.end()) {
+    while (it != vecBlockVotes.end()) {
+        if (it->blockPayees.vecPayees.empty()) {
+            ++it;
+            continue;
+        }
         int nTotalVotes = 0;
         bool fFound = false;
-        BOOST_FOREACH(CXnodePayee & payee, it->second.vecPayees)
+        BOOST_FOREACH(CXnodePayee & payee, it->blockPayees.vecPayees)
         {
             if (payee.GetVoteCount() >= MNPAYMENTS_SIGNATURES_REQUIRED) {
                 fFound = true;
@@ -746,12 +907,12 @@ void CXnodePayments::RequestLowDataPaymentBlocks(CNode *pnode) {
 //                CBitcoinAddress address2(address1);
 //                printf("payee %s votes %d\n", address2.ToString().c_str(), payee.GetVoteCount());
 //            }
-//            printf("block %d votes total %d\n", it->first, nTotalVotes);
+//            printf("block %d votes total %d\n", it->nBlockHeight, nTotalVotes);
 //        )
         // END DEBUG
         // Low data block found, let's try to sync it
         uint256 hash;
-        if (GetBlockHash(hash, it->first)) {
+        if (GetBlockHash(hash, it->nBlockHeight)) {
             vToFetch.push_back(CInv(MSG_XNODE_PAYMENT_BLOCK, hash));
         }
         // We should not violate GETDATA rules
@@ -774,7 +935,7 @@ std::string CXnodePayments::ToString() const {
     std::ostringstream info;
 
     info << "Votes: " << (int) mapXnodePaymentVotes.size() <<
-         ", Blocks: " << (int) mapXnodeBlocks.size();
+         ", Blocks: " << nBlockCount;
 
     return info.str();
 }
@@ -18,10 +18,12 @@ class CXnodeBlockPayees;
 
 static const int MNPAYMENTS_SIGNATURES_REQUIRED         = 6;
 static const int MNPAYMENTS_SIGNATURES_TOTAL            = 10;
+// votes are accepted for blocks up to this far ahead of the tip
+static const int MNPAYMENTS_FUTURE_BLOCKS               = 20;
 
 extern CCriticalSection cs_vecPayees;
 extern CCriticalSection cs_mapXnodeBlocks;
-extern CCriticalSection cs_mapXnodePayeeVotes;
+extern CCriticalSection cs_mapXnodePaymentVotes;
 
 extern CXnodePayments mnpayments;
 
@@ -99,6 +101,23 @@ public:
     std::string GetRequiredPaymentsString();
 };
 
+// All votes seen for a block height, verified or not, and the payees of the
+// verified ones. A slot in the ring buffer of CXnodePayments.
+class CXnodeBlockVotes
+{
+public:
+    // -1 while the slot is unused
+    int nBlockHeight;
+    CXnodeBlockPayees blockPayees;
+    std::vector<uint256> vecVoteHashes;
+
+    CXnodeBlockVotes() :
+        nBlockHeight(-1),
+        blockPayees(),
+        vecVoteHashes()
+        {}
+};
+
 // vote for the winning payment
 class CXnodePaymentVote
 {
@@ -142,7 +161,8 @@ public:
     }
 
     bool Sign();
-    bool CheckSignature(const CPubKey& pubKeyXnode, int nValidationHeight, int &nDos);
+    /// fLog = false checks quietly, for callers that check the signature again and report it then
+    bool CheckSignature(const CPubKey& pubKeyXnode, int nValidationHeight, int &nDos, bool fLog = true);
 
     bool IsValid(CNode* pnode, int nValidationHeight, std::string& strError);
     void Relay();
@@ -169,19 +189,56 @@ private:
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
+    // Ring buffer of the stored block heights, height h lives at h % size().
+    // Sized to hold GetStorageLimit() blocks back and MNPAYMENTS_FUTURE_BLOCKS ahead,
+    // so a height is dropped as a whole when a newer height takes its slot over.
+    std::vector<CXnodeBlockVotes> vecBlockVotes;
+    // heights below this were already dropped by CheckAndRemove
+    int nHeightExpired;
+    // number of heights with payees
+    int nBlockCount;
+    // whether CheckAndRemove checks the votes for consistency, -checkxnpayments
+    bool fSanityCheck;
+
+    // Returns the slot of nBlockHeight, or NULL. With fCreate, takes the slot
+    // over from an older height, unless nBlockHeight itself is too old.
+    // Requires cs_mapXnodeBlocks, and cs_mapXnodePaymentVotes with fCreate.
+    CXnodeBlockVotes* GetBlockVotes(int nBlockHeight, bool fCreate);
+    void ClearBlockVotes(CXnodeBlockVotes& blockVotes);
+    void ResizeBlockVotes(size_t nSize);
+
+    // The slots with payees, by height. Requires cs_mapXnodeBlocks.
+    std::vector<const CXnodeBlockVotes*> GetStoredBlockVotes() const;
+    void LoadBlockPayeesMap(const std::map<int, CXnodeBlockPayees>& mapXnodeBlocks);
+
 public:
+    // all votes seen for the stored block heights, by hash
     std::map<uint256, CXnodePaymentVote> mapXnodePaymentVotes;
-    std::map<int, CXnodeBlockPayees> mapXnodeBlocks;
     std::map<COutPoint, int> mapXnodesLastVote;
 
-    CXnodePayments() : nStorageCoeff(1.25), nMinBlocksToStore(5000) {}
+    CXnodePayments() : nStorageCoeff(1.25), nMinBlocksToStore(5000), nHeightExpired(0), nBlockCount(0), fSanityCheck(false) {}
 
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        // also written from the scheduler thread while votes come in
+        LOCK2(cs_mapXnodeBlocks, cs_mapXnodePaymentVotes);
         READWRITE(mapXnodePaymentVotes);
-        READWRITE(mapXnodeBlocks);
+        // the block heights are stored as a std::map<int, CXnodeBlockPayees>,
+        // to keep the file format, but written straight from the slots
+        if(ser_action.ForRead()) {
+            std::map<int, CXnodeBlockPayees> mapXnodeBlocks;
+            READWRITE(mapXnodeBlocks);
+            LoadBlockPayeesMap(mapXnodeBlocks);
+        } else {
+            std::vector<const CXnodeBlockVotes*> vecStored = GetStoredBlockVotes();
+            WriteCompactSize(s, vecStored.size());
+            BOOST_FOREACH(const CXnodeBlockVotes* pblockVotes, vecStored) {
+                ::Serialize(s, pblockVotes->nBlockHeight, nType, nVersion);
+                ::Serialize(s, pblockVotes->blockPayees, nType, nVersion);
+            }
+        }
     }
 
     void Clear();
@@ -193,6 +250,13 @@ public:
     void Sync(CNode* node);
     void RequestLowDataPaymentBlocks(CNode* pnode);
     void CheckAndRemove();
+    void SetSanityCheck(bool fSanityCheckIn) { fSanityCheck = fSanityCheckIn; }
+    /// Asserts that the ring buffer and mapXnodePaymentVotes agree, and that no expired height is left
+    void Check();
+
+    /// Payees of nBlockHeight, or NULL if there are no votes for it. Requires cs_mapXnodeBlocks.
+    CXnodeBlockPayees* GetBlockPayees(int nBlockHeight);
+    bool HasBlockPayees(int nBlockHeight);
 
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight);
@@ -206,7 +270,7 @@ public:
     void FillBlockPayee(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, CTxOut& txoutXnodeRet);
     std::string ToString() const;
 
-    int GetBlockCount() { return mapXnodeBlocks.size(); }
+    int GetBlockCount() { return nBlockCount; }
     int GetVoteCount() { return mapXnodePaymentVotes.size(); }
 
     bool IsEnoughData();
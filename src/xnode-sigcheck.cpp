@@ -0,0 +1,193 @@
+// Copyright (c) 2019 The GravityCoin Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "xnode-sigcheck.h"
+
+#include "net.h"
+#include "protocol.h"
+#include "util.h"
+#include "xnode.h"
+#include "xnode-payments.h"
+#include "xnode-sync.h"
+#include "xnodeman.h"
+
+#include <boost/bind.hpp>
+
+// Defined in net.cpp, wakes the message handler thread
+extern boost::condition_variable messageHandlerCondition;
+
+CXnodeSigCheckPool xnodeSigCheckPool;
+
+CXnodeSigCheckPool::Item::Item(CNode* pfromIn, const std::string& strCommandIn, const CDataStream& vRecvIn, bool fCheckedIn)
+  : pfrom(pfromIn), strCommand(strCommandIn), vRecv(vRecvIn), fChecked(fCheckedIn)
+{
+}
+
+CXnodeSigCheckPool::CXnodeSigCheckPool() : fStarted(false), fQuit(false), nTaken(0)
+{
+}
+
+void CXnodeSigCheckPool::Start(int nThreads)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (fStarted)
+        return;
+    for (int i = 0; i < std::max(nThreads, 1); ++i) {
+        threads.create_thread(boost::bind(&CXnodeSigCheckPool::WorkerLoop, this));
+    }
+    fStarted = true;
+}
+
+void CXnodeSigCheckPool::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (!fStarted)
+            return;
+        fQuit = true;
+    }
+    condWorker.notify_all();
+    threads.join_all();
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    BOOST_FOREACH(Item& item, queueItems) {
+        item.pfrom->Release();
+    }
+    queueItems.clear();
+    mapQueuedByPeer.clear();
+    nTaken = 0;
+    fStarted = false;
+    fQuit = false;
+}
+
+void CXnodeSigCheckPool::CheckSignatures(const std::string& strCommand, CDataStream vRecv)
+{
+    // The managers check everything again later, and report failures then,
+    // so don't log them here
+    int nDos = 0;
+    try {
+        if (strCommand == NetMsgType::MNANNOUNCE) {
+            CXnodeBroadcast mnb;
+            vRecv >> mnb;
+            mnb.CheckSignature(nDos, false);
+            if (!mnb.lastPing.vchSig.empty())
+                mnb.lastPing.CheckSignature(mnb.pubKeyXnode, nDos, false);
+        } else if (strCommand == NetMsgType::MNPING) {
+            CXnodePing mnp;
+            vRecv >> mnp;
+            xnode_info_t info = mnodeman.GetXnodeInfo(mnp.vin);
+            if (info.fInfoValid)
+                mnp.CheckSignature(info.pubKeyXnode, nDos, false);
+        } else if (strCommand == NetMsgType::XNODEPAYMENTVOTE) {
+            CXnodePaymentVote vote;
+            vRecv >> vote;
+            xnode_info_t info = mnodeman.GetXnodeInfo(vote.vinXnode);
+            if (info.fInfoValid)
+                vote.CheckSignature(info.pubKeyXnode, 0, nDos, false);
+        }
+    } catch (const std::exception&) {
+        // malformed, ProcessMessage rejects it
+    }
+}
+
+void CXnodeSigCheckPool::WorkerLoop()
+{
+    RenameThread("bitcoin-xnodesig");
+
+    std::vector<Item*> vBatch;
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fQuit && nTaken == queueItems.size()) {
+                condWorker.wait(lock);
+            }
+            if (fQuit) return;
+            // Items stay put in the deque, ProcessResults only removes checked ones
+            while (nTaken < queueItems.size() && vBatch.size() < XNODE_SIGCHECK_BATCH_SIZE) {
+                Item& item = queueItems[nTaken++];
+                // queued only to keep the order of their peer's messages
+                if (!item.fChecked)
+                    vBatch.push_back(&item);
+            }
+            if (vBatch.empty())
+                continue;
+        }
+
+        BOOST_FOREACH(Item* pitem, vBatch) {
+            CheckSignatures(pitem->strCommand, pitem->vRecv);
+        }
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            BOOST_FOREACH(Item* pitem, vBatch) {
+                pitem->fChecked = true;
+            }
+        }
+        vBatch.clear();
+        // Have the message handler process the results rather than wait for its timeout
+        messageHandlerCondition.notify_one();
+    }
+}
+
+bool CXnodeSigCheckPool::Push(CNode* pfrom, const std::string& strCommand, const CDataStream& vRecv)
+{
+    bool fSigned = strCommand == NetMsgType::MNANNOUNCE ||
+                   strCommand == NetMsgType::MNPING ||
+                   strCommand == NetMsgType::XNODEPAYMENTVOTE;
+    // The managers drop these right away then
+    bool fCheck = fSigned && !fLiteMode && xnodeSync.IsBlockchainSynced();
+
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (!fStarted || fQuit)
+            return false;
+        // Processing it now would have it overtake the messages the peer sent before
+        if (mapQueuedByPeer.count(pfrom)) {
+            if (queueItems.size() >= MAX_XNODE_SIGCHECK_QUEUE_HARD) {
+                LogPrint("xnode", "CXnodeSigCheckPool::Push -- queue full, dropping %s, peer=%d\n", SanitizeString(strCommand), pfrom->id);
+                return true;
+            }
+            if (queueItems.size() >= MAX_XNODE_SIGCHECK_QUEUE)
+                fCheck = false;
+        } else if (!fCheck || queueItems.size() >= MAX_XNODE_SIGCHECK_QUEUE) {
+            return false;
+        }
+        queueItems.push_back(Item(pfrom->AddRef(), strCommand, vRecv, !fCheck));
+        mapQueuedByPeer[pfrom]++;
+    }
+    if (fCheck)
+        condWorker.notify_one();
+    return true;
+}
+
+void CXnodeSigCheckPool::ProcessResults(const Processor& process)
+{
+    std::vector<Item> vItems;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (!queueItems.empty() && queueItems.front().fChecked) {
+            vItems.push_back(queueItems.front());
+            queueItems.pop_front();
+            // items queued checked already may not have been taken by a worker yet
+            if (nTaken > 0)
+                --nTaken;
+            std::map<CNode*, int>::iterator it = mapQueuedByPeer.find(vItems.back().pfrom);
+            if (--it->second == 0)
+                mapQueuedByPeer.erase(it);
+        }
+    }
+
+    BOOST_FOREACH(Item& item, vItems) {
+        if (!item.pfrom->fDisconnect) {
+            try {
+                process(item.pfrom, item.strCommand, item.vRecv);
+            } catch (const std::ios_base::failure& e) {
+                LogPrintf("%s(%s): Exception '%s' caught, peer=%d\n", __func__, SanitizeString(item.strCommand), e.what(), item.pfrom->id);
+            } catch (const std::exception& e) {
+                PrintExceptionContinue(&e, "CXnodeSigCheckPool::ProcessResults()");
+            }
+        }
+        item.pfrom->Release();
+    }
+}
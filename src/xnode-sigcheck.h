@@ -0,0 +1,105 @@
+// Copyright (c) 2019 The GravityCoin Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef GRAVITYCOIN_XNODE_SIGCHECK_H
+#define GRAVITYCOIN_XNODE_SIGCHECK_H
+
+#include "streams.h"
+
+#include <deque>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+class CNode;
+
+/** -xnodesigthreads default (number of threads verifying xnode message signatures, 0 = auto) */
+static const int DEFAULT_XNODE_SIGCHECK_THREADS = 0;
+/** Maximum number of threads verifying xnode message signatures */
+static const int MAX_XNODE_SIGCHECK_THREADS = 8;
+/** Number of messages a worker takes at once */
+static const size_t XNODE_SIGCHECK_BATCH_SIZE = 16;
+/** Messages queued beyond this are processed right away, on the message handler thread */
+static const size_t MAX_XNODE_SIGCHECK_QUEUE = 10000;
+/** Messages of peers with messages queued are dropped beyond this, as they can't be processed right away */
+static const size_t MAX_XNODE_SIGCHECK_QUEUE_HARD = 2 * MAX_XNODE_SIGCHECK_QUEUE;
+
+/**
+ * Verifies the signatures of xnode announcements, pings and payment votes on a
+ * pool of worker threads, before the managers process them:
+ *
+ * - the message handler queues these messages with Push() instead of
+ *   processing them right away,
+ * - the workers take them in batches and verify their signatures, which leaves
+ *   the good ones in the verified signature cache of CDarkSendSigner,
+ * - ProcessResults() has the managers process the verified messages on the
+ *   message handler thread, in the order they arrived, where checking their
+ *   signatures again is a cache lookup.
+ *
+ * A message the workers can't verify, e.g. a ping of an xnode whose
+ * announcement is still queued, is processed all the same and has its
+ * signature checked then.
+ *
+ * Once a peer has messages queued, all its extension messages are queued
+ * behind them, also the unsigned ones and those past the queue limit, so
+ * they are processed in the order the peer sent them.
+ */
+class CXnodeSigCheckPool
+{
+public:
+    //! Processes a message, like ProcessMessage does for the GravityCoin modules
+    typedef boost::function<void (CNode*, std::string&, CDataStream&)> Processor;
+
+private:
+    struct Item
+    {
+        CNode* pfrom;
+        std::string strCommand;
+        CDataStream vRecv;
+        bool fChecked;
+
+        Item(CNode* pfromIn, const std::string& strCommandIn, const CDataStream& vRecvIn, bool fCheckedIn);
+    };
+
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+    boost::thread_group threads;
+    bool fStarted;
+    bool fQuit;
+
+    //! Messages in the order they arrived, taken off the front once checked
+    std::deque<Item> queueItems;
+    //! Number of messages at the front of queueItems that workers took already
+    size_t nTaken;
+    //! Number of messages in queueItems by peer, for the peers that have any
+    std::map<CNode*, int> mapQueuedByPeer;
+
+    void WorkerLoop();
+    static void CheckSignatures(const std::string& strCommand, CDataStream vRecv);
+
+public:
+    CXnodeSigCheckPool();
+
+    void Start(int nThreads);
+    /** Stops the workers, and drops the messages that weren't processed yet. */
+    void Stop();
+
+    /**
+     * Queues a message to have its signature verified ahead, if it is of a
+     * kind that gets one, or to keep it behind the queued messages of the
+     * same peer. Returns false if the caller should process it now.
+     */
+    bool Push(CNode* pfrom, const std::string& strCommand, const CDataStream& vRecv);
+
+    /** Processes the verified messages at the front of the queue. */
+    void ProcessResults(const Processor& process);
+};
+
+extern CXnodeSigCheckPool xnodeSigCheckPool;
+
+#endif // GRAVITYCOIN_XNODE_SIGCHECK_H
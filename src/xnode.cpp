@@ -16,6 +16,8 @@
 
 #include <boost/lexical_cast.hpp>
 
+#include <limits>
+
 
 CXnode::CXnode() :
         vin(),
@@ -36,7 +38,9 @@ CXnode::CXnode() :
         nPoSeBanScore(0),
         nPoSeBanHeight(0),
         fAllowMixingTx(true),
-        fUnitTest(false) {}
+        fUnitTest(false),
+        nTimeNextCheck(0),
+        fCollateralChecked(false) {}
 
 CXnode::CXnode(CService addrNew, CTxIn vinNew, CPubKey pubKeyCollateralAddressNew, CPubKey pubKeyXnodeNew, int nProtocolVersionIn) :
         vin(vinNew),
@@ -57,7 +61,9 @@ CXnode::CXnode(CService addrNew, CTxIn vinNew, CPubKey pubKeyCollateralAddressNe
         nPoSeBanScore(0),
         nPoSeBanHeight(0),
         fAllowMixingTx(true),
-        fUnitTest(false) {}
+        fUnitTest(false),
+        nTimeNextCheck(0),
+        fCollateralChecked(false) {}
 
 CXnode::CXnode(const CXnode &other) :
         vin(other.vin),
@@ -78,7 +84,9 @@ CXnode::CXnode(const CXnode &other) :
         nPoSeBanScore(other.nPoSeBanScore),
         nPoSeBanHeight(other.nPoSeBanHeight),
         fAllowMixingTx(other.fAllowMixingTx),
-        fUnitTest(other.fUnitTest) {}
+        fUnitTest(other.fUnitTest),
+        nTimeNextCheck(other.nTimeNextCheck),
+        fCollateralChecked(other.fCollateralChecked) {}
 
 CXnode::CXnode(const CXnodeBroadcast &mnb) :
         vin(mnb.vin),
@@ -99,7 +107,9 @@ CXnode::CXnode(const CXnodeBroadcast &mnb) :
         nPoSeBanScore(0),
         nPoSeBanHeight(0),
         fAllowMixingTx(true),
-        fUnitTest(false) {}
+        fUnitTest(false),
+        nTimeNextCheck(0),
+        fCollateralChecked(false) {}
 
 //CSporkManager sporkManager;
 //
@@ -165,6 +175,17 @@ void CXnode::Check(bool fForce) {
     if (!fForce && (GetTime() - nTimeLastChecked < XNODE_CHECK_SECONDS)) return;
     nTimeLastChecked = GetTime();
 
+    int nActiveStatePrev = nActiveState;
+    UpdateState();
+    ScheduleNextCheck();
+    if (nActiveState != nActiveStatePrev) {
+        // let CXnodeMan::Check announce the new state
+        nTimeNextCheck = 0;
+        mnodeman.ScheduleCheck(nTimeNextCheck);
+    }
+}
+
+void CXnode::UpdateState() {
     LogPrint("xnode", "CXnode::Check -- Xnode %s is in %s state\n", vin.prevout.ToStringShort(), GetStateString());
 
     //once spent, stop doing the checks
@@ -172,19 +193,25 @@ void CXnode::Check(bool fForce) {
 
     int nHeight = 0;
     if (!fUnitTest) {
-        TRY_LOCK(cs_main, lockMain);
-        if (!lockMain) return;
-
-        CCoins coins;
-        if (!pcoinsTip->GetCoins(vin.prevout.hash, coins) ||
-            (unsigned int) vin.prevout.n >= coins.vout.size() ||
-            coins.vout[vin.prevout.n].IsNull()) {
-            nActiveState = XNODE_OUTPOINT_SPENT;
-            LogPrint("xnode", "CXnode::Check -- Failed to find Xnode UTXO, xnode=%s\n", vin.prevout.ToStringShort());
-            return;
+        // Once found, spends of the collateral come in through CXnodeMan::SyncTransaction
+        if (!fCollateralChecked) {
+            TRY_LOCK(cs_main, lockMain);
+            if (!lockMain) return;
+
+            CCoins coins;
+            if (!pcoinsTip->GetCoins(vin.prevout.hash, coins) ||
+                (unsigned int) vin.prevout.n >= coins.vout.size() ||
+                coins.vout[vin.prevout.n].IsNull()) {
+                nActiveState = XNODE_OUTPOINT_SPENT;
+                LogPrint("xnode", "CXnode::Check -- Failed to find Xnode UTXO, xnode=%s\n", vin.prevout.ToStringShort());
+                return;
+            }
+            fCollateralChecked = true;
         }
 
-        nHeight = chainActive.Height();
+        const CBlockIndex* pindexTip = GetChainTipSnapshot();
+        if (pindexTip)
+            nHeight = pindexTip->nHeight;
     }
 
     if (IsPoSeBanned()) {
@@ -280,6 +307,72 @@ void CXnode::Check(bool fForce) {
     }
 }
 
+void CXnode::ScheduleNextCheck() {
+    int64_t nNow = GetTime();
+    if (IsOutpointSpent()) {
+        // final, CXnodeMan::CheckAndRemove drops it
+        nTimeNextCheck = std::numeric_limits<int64_t>::max();
+        return;
+    }
+    if (!fUnitTest && !fCollateralChecked) {
+        // cs_main was busy, try again soon
+        nTimeNextCheck = nNow + XNODE_CHECK_SECONDS;
+        mnodeman.ScheduleCheck(nTimeNextCheck);
+        return;
+    }
+
+    // The state only changes by itself when one of these timeouts passes. Pings,
+    // broadcasts, PoSe scores and collateral spends check the xnode right away,
+    // and CXnodeMan checks all xnodes again on every new block.
+    int64_t nDelay = std::numeric_limits<int64_t>::max();
+    if (lastPing != CXnodePing()) {
+        int64_t nPingAge = GetAdjustedTime() - lastPing.sigTime;
+        const int64_t arrPingTimeouts[] = {XNODE_MIN_MNP_SECONDS, XNODE_EXPIRATION_SECONDS, XNODE_NEW_START_REQUIRED_SECONDS};
+        BOOST_FOREACH(int64_t nTimeout, arrPingTimeouts) {
+            if (nTimeout > nPingAge)
+                nDelay = std::min(nDelay, nTimeout - nPingAge);
+        }
+    }
+    int64_t nWatchdogAge = nNow - nTimeLastWatchdogVote;
+    if (XNODE_WATCHDOG_MAX_SECONDS >= nWatchdogAge)
+        nDelay = std::min(nDelay, XNODE_WATCHDOG_MAX_SECONDS - nWatchdogAge + 1);
+
+    nTimeNextCheck = nDelay == std::numeric_limits<int64_t>::max() ? nDelay : nNow + nDelay;
+    mnodeman.ScheduleCheck(nTimeNextCheck);
+}
+
+void CXnode::SetCollateralSpent() {
+    LOCK(cs);
+    if (IsOutpointSpent()) return;
+    nActiveState = XNODE_OUTPOINT_SPENT;
+    nTimeNextCheck = std::numeric_limits<int64_t>::max();
+    LogPrint("xnode", "CXnode::SetCollateralSpent -- Xnode UTXO spent, xnode=%s\n", vin.prevout.ToStringShort());
+}
+
+void CXnode::RecheckCollateral() {
+    LOCK(cs);
+    // The spend may have been disconnected, the next check sets the state from scratch
+    if (IsOutpointSpent())
+        nActiveState = XNODE_PRE_ENABLED;
+    fCollateralChecked = false;
+    nTimeNextCheck = 0;
+    mnodeman.ScheduleCheck(nTimeNextCheck);
+}
+
+void CXnode::IncreasePoSeBanScore() {
+    LOCK(cs);
+    if (nPoSeBanScore < XNODE_POSE_BAN_MAX_SCORE) nPoSeBanScore++;
+    nTimeNextCheck = 0;
+    mnodeman.ScheduleCheck(nTimeNextCheck);
+}
+
+void CXnode::DecreasePoSeBanScore() {
+    LOCK(cs);
+    if (nPoSeBanScore > -XNODE_POSE_BAN_MAX_SCORE) nPoSeBanScore--;
+    nTimeNextCheck = 0;
+    mnodeman.ScheduleCheck(nTimeNextCheck);
+}
+
 bool CXnode::IsValidNetAddr() {
     return IsValidNetAddr(addr);
 }
@@ -407,8 +500,8 @@ void CXnode::UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScanBack)
     for (int i = 0; BlockReading && BlockReading->nHeight > nBlockLastPaid && i < nMaxBlocksToScanBack; i++) {
 //        LogPrintf("mnpayments.mapXnodeBlocks.count(BlockReading->nHeight)=%s\n", mnpayments.mapXnodeBlocks.count(BlockReading->nHeight));
 //        LogPrintf("mnpayments.mapXnodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2)=%s\n", mnpayments.mapXnodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2));
-        if (mnpayments.mapXnodeBlocks.count(BlockReading->nHeight) &&
-            mnpayments.mapXnodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2)) {
+        CXnodeBlockPayees* pblockPayees = mnpayments.GetBlockPayees(BlockReading->nHeight);
+        if (pblockPayees && pblockPayees->HasPayeeWithVotes(mnpayee, 2)) {
             // LogPrintf("i=%s, BlockReading->nHeight=%s\n", i, BlockReading->nHeight);
             CBlock block;
             if (!ReadBlockFromDisk(block, BlockReading, Params().GetConsensus())) // shouldn't really happen
@@ -732,7 +825,7 @@ bool CXnodeBroadcast::Sign(CKey &keyCollateralAddress) {
     return true;
 }
 
-bool CXnodeBroadcast::CheckSignature(int &nDos) {
+bool CXnodeBroadcast::CheckSignature(int &nDos, bool fLog) {
     std::string strMessage;
     std::string strError = "";
     nDos = 0;
@@ -741,10 +834,12 @@ bool CXnodeBroadcast::CheckSignature(int &nDos) {
                  pubKeyCollateralAddress.GetID().ToString() + pubKeyXnode.GetID().ToString() +
                  boost::lexical_cast<std::string>(nProtocolVersion);
 
-    LogPrint("xnode", "CXnodeBroadcast::CheckSignature -- strMessage: %s  pubKeyCollateralAddress address: %s  sig: %s\n", strMessage, CBitcoinAddress(pubKeyCollateralAddress.GetID()).ToString(), EncodeBase64(&vchSig[0], vchSig.size()));
+    if (fLog)
+        LogPrint("xnode", "CXnodeBroadcast::CheckSignature -- strMessage: %s  pubKeyCollateralAddress address: %s  sig: %s\n", strMessage, CBitcoinAddress(pubKeyCollateralAddress.GetID()).ToString(), EncodeBase64(&vchSig[0], vchSig.size()));
 
     if (!darkSendSigner.VerifyMessage(pubKeyCollateralAddress, vchSig, strMessage, strError)) {
-        LogPrintf("CXnodeBroadcast::CheckSignature -- Got bad Xnode announce signature, error: %s\n", strError);
+        if (fLog)
+            LogPrintf("CXnodeBroadcast::CheckSignature -- Got bad Xnode announce signature, error: %s\n", strError);
         nDos = 100;
         return false;
     }
@@ -788,13 +883,14 @@ bool CXnodePing::Sign(CKey &keyXnode, CPubKey &pubKeyXnode) {
     return true;
 }
 
-bool CXnodePing::CheckSignature(CPubKey &pubKeyXnode, int &nDos) {
+bool CXnodePing::CheckSignature(CPubKey &pubKeyXnode, int &nDos, bool fLog) {
     std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
     std::string strError = "";
     nDos = 0;
 
     if (!darkSendSigner.VerifyMessage(pubKeyXnode, vchSig, strMessage, strError)) {
-        LogPrintf("CXnodePing::CheckSignature -- Got bad Xnode ping signature, xnode=%s, error: %s\n", vin.prevout.ToStringShort(), strError);
+        if (fLog)
+            LogPrintf("CXnodePing::CheckSignature -- Got bad Xnode ping signature, xnode=%s, error: %s\n", vin.prevout.ToStringShort(), strError);
         nDos = 33;
         return false;
     }
@@ -81,7 +81,8 @@ public:
     bool IsExpired() { return GetTime() - sigTime > XNODE_NEW_START_REQUIRED_SECONDS; }
 
     bool Sign(CKey& keyXnode, CPubKey& pubKeyXnode);
-    bool CheckSignature(CPubKey& pubKeyXnode, int &nDos);
+    /// fLog = false checks quietly, for callers that check the signature again and report it then
+    bool CheckSignature(CPubKey& pubKeyXnode, int &nDos, bool fLog = true);
     bool SimpleCheck(int& nDos);
     bool CheckAndUpdate(CXnode* pmn, bool fFromNewBroadcast, int& nDos);
     void Relay();
@@ -145,6 +146,9 @@ private:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
+    void UpdateState();
+    void ScheduleNextCheck();
+
 public:
     enum state {
         XNODE_PRE_ENABLED,
@@ -176,6 +180,10 @@ public:
     int nPoSeBanHeight;
     bool fAllowMixingTx;
     bool fUnitTest;
+    // Not serialized: when Check() has to run next for the state to change without news about the xnode
+    int64_t nTimeNextCheck;
+    // Not serialized: whether the collateral was found unspent, later spends are reported to CXnodeMan::SyncTransaction
+    bool fCollateralChecked;
 
     // KEEP TRACK OF GOVERNANCE ITEMS EACH XNODE HAS VOTE UPON FOR RECALCULATION
     std::map<uint256, int> mapGovernanceObjectsVotedOn;
@@ -238,6 +246,8 @@ public:
         swap(first.nPoSeBanHeight, second.nPoSeBanHeight);
         swap(first.fAllowMixingTx, second.fAllowMixingTx);
         swap(first.fUnitTest, second.fUnitTest);
+        swap(first.nTimeNextCheck, second.nTimeNextCheck);
+        swap(first.fCollateralChecked, second.fCollateralChecked);
         swap(first.mapGovernanceObjectsVotedOn, second.mapGovernanceObjectsVotedOn);
     }
 
@@ -248,6 +258,12 @@ public:
 
     void Check(bool fForce = false);
 
+    int64_t GetTimeNextCheck() { LOCK(cs); return nTimeNextCheck; }
+    /// The collateral was spent in a connected block
+    void SetCollateralSpent();
+    /// The transaction of the collateral or of its spend left the chain, look the collateral up again on the next check
+    void RecheckCollateral();
+
     bool IsBroadcastedWithin(int nSeconds) { return GetAdjustedTime() - sigTime < nSeconds; }
 
     bool IsPingedWithin(int nSeconds, int64_t nTimeToCheckAt = -1)
@@ -284,8 +300,8 @@ public:
     bool IsValidNetAddr();
     static bool IsValidNetAddr(CService addrIn);
 
-    void IncreasePoSeBanScore() { if(nPoSeBanScore < XNODE_POSE_BAN_MAX_SCORE) nPoSeBanScore++; }
-    void DecreasePoSeBanScore() { if(nPoSeBanScore > -XNODE_POSE_BAN_MAX_SCORE) nPoSeBanScore--; }
+    void IncreasePoSeBanScore();
+    void DecreasePoSeBanScore();
 
     xnode_info_t GetInfo();
 
@@ -373,7 +389,8 @@ public:
     bool CheckOutpoint(int& nDos);
 
     bool Sign(CKey& keyCollateralAddress);
-    bool CheckSignature(int& nDos);
+    /// fLog = false checks quietly, for callers that check the signature again and report it then
+    bool CheckSignature(int& nDos, bool fLog = true);
     void RelayXNode();
 };
 
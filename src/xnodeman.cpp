@@ -11,9 +11,11 @@
 #include "xnodeman.h"
 #include "netfulfilledman.h"
 #include "util.h"
+#include "validationinterface.h"
 
 /** Xnode manager */
 CXnodeMan mnodeman;
+CXnodeCollateralWatcher xnodeCollateralWatcher;
 
 const std::string CXnodeMan::SERIALIZATION_VERSION_STRING = "CXnodeMan-Version-4";
 
@@ -96,8 +98,47 @@ void CXnodeIndex::RebuildIndex()
     }
 }
 
+void CXnodeListCache::Set(size_t nIndex, const CXnode& mn)
+{
+    if (nIndex == size()) {
+        vOutpoint.push_back(mn.vin.prevout);
+        vActiveState.push_back(mn.nActiveState);
+        vProtocolVersion.push_back(mn.nProtocolVersion);
+        vBlockLastPaid.push_back(mn.nBlockLastPaid);
+        vSigTime.push_back(mn.sigTime);
+        return;
+    }
+    vOutpoint[nIndex] = mn.vin.prevout;
+    vActiveState[nIndex] = mn.nActiveState;
+    vProtocolVersion[nIndex] = mn.nProtocolVersion;
+    vBlockLastPaid[nIndex] = mn.nBlockLastPaid;
+    vSigTime[nIndex] = mn.sigTime;
+}
+
+void CXnodeListCache::Erase(size_t nIndex)
+{
+    vOutpoint.erase(vOutpoint.begin() + nIndex);
+    vActiveState.erase(vActiveState.begin() + nIndex);
+    vProtocolVersion.erase(vProtocolVersion.begin() + nIndex);
+    vBlockLastPaid.erase(vBlockLastPaid.begin() + nIndex);
+    vSigTime.erase(vSigTime.begin() + nIndex);
+}
+
+void CXnodeListCache::Clear()
+{
+    vOutpoint.clear();
+    vActiveState.clear();
+    vProtocolVersion.clear();
+    vBlockLastPaid.clear();
+    vSigTime.clear();
+}
+
 CXnodeMan::CXnodeMan() : cs(),
   vXnodes(),
+  cacheXnodes(),
+  setCollaterals(),
+  nTimeNextCheck(0),
+  fCheckAll(true),
   mAskedUsForXnodeList(),
   mWeAskedForXnodeList(),
   mWeAskedForXnodeListEntry(),
@@ -126,8 +167,13 @@ bool CXnodeMan::Add(CXnode &mn)
     if (pmn == NULL) {
         LogPrint("xnode", "CXnodeMan::Add -- Adding new Xnode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
         vXnodes.push_back(mn);
+        cacheXnodes.Set(vXnodes.size() - 1, vXnodes.back());
+        setCollaterals.insert(mn.vin.prevout);
         indexXnodes.AddXnodeVIN(mn.vin);
+        // have the collateral looked up on the next tick
+        vXnodes.back().RecheckCollateral();
         fXnodesAdded = true;
+        NotifyChanged(mn);
         return true;
     }
 
@@ -163,17 +209,62 @@ void CXnodeMan::AskForMN(CNode* pnode, const CTxIn &vin)
     pnode->PushMessage(NetMsgType::DSEG, vin);
 }
 
+void CXnodeMan::NotifyChanged(const CXnode &mn)
+{
+    LOCK(cs);
+
+    std::map<COutPoint, int>::iterator it = mapNotifiedStates.find(mn.vin.prevout);
+    if (it == mapNotifiedStates.end()) {
+        mapNotifiedStates.insert(std::make_pair(mn.vin.prevout, mn.nActiveState));
+        NotifyXnodeChanged(mn.vin.prevout, mn.addr, mn.nActiveState, XNODE_LIST_ADDED);
+    } else if (it->second != mn.nActiveState) {
+        it->second = mn.nActiveState;
+        NotifyXnodeChanged(mn.vin.prevout, mn.addr, mn.nActiveState, XNODE_LIST_STATE);
+    }
+}
+
+void CXnodeMan::UpdateListCache(const CXnode &mn)
+{
+    AssertLockHeld(cs);
+    cacheXnodes.Set(&mn - &vXnodes[0], mn);
+}
+
 void CXnodeMan::Check()
 {
     LOCK(cs);
 
 //    LogPrint("xnode", "CXnodeMan::Check -- nLastWatchdogVoteTime=%d, IsWatchdogActive()=%d\n", nLastWatchdogVoteTime, IsWatchdogActive());
 
-    BOOST_FOREACH(CXnode& mn, vXnodes) {
-        mn.Check();
+    // Xnodes change state by themselves only when a ping or watchdog timeout
+    // passes, so most ticks have nothing to do
+    int64_t nNow = GetTime();
+    if (!fCheckAll && nNow < nTimeNextCheck) return;
+    bool fCheckAllNow = fCheckAll;
+    fCheckAll = false;
+    // xnodes that aren't due yet put their time back below
+    nTimeNextCheck = std::numeric_limits<int64_t>::max();
+
+    for (size_t i = 0; i < vXnodes.size(); i++) {
+        CXnode& mn = vXnodes[i];
+        int64_t nTimeNextCheckXnode = mn.GetTimeNextCheck();
+        if (fCheckAllNow || nTimeNextCheckXnode <= nNow) {
+            mn.Check(true);
+            cacheXnodes.Set(i, mn);
+            // Also picks up state changes made outside of Check, and xnodes
+            // loaded from the cache
+            NotifyChanged(mn);
+        } else {
+            ScheduleCheck(nTimeNextCheckXnode);
+        }
     }
 }
 
+void CXnodeMan::ScheduleCheck(int64_t nTime)
+{
+    int64_t nTimeCurrent = nTimeNextCheck;
+    while (nTime < nTimeCurrent && !nTimeNextCheck.compare_exchange_weak(nTimeCurrent, nTime)) {}
+}
+
 void CXnodeMan::CheckAndRemove()
 {
     if(!xnodeSync.IsXnodeListSynced()) return;
@@ -193,10 +284,10 @@ void CXnodeMan::CheckAndRemove()
         // ask for up to MNB_RECOVERY_MAX_ASK_ENTRIES xnode entries at a time
         int nAskForMnbRecovery = MNB_RECOVERY_MAX_ASK_ENTRIES;
         while(it != vXnodes.end()) {
-            CXnodeBroadcast mnb = CXnodeBroadcast(*it);
-            uint256 hash = mnb.GetHash();
+            size_t nIndex = it - vXnodes.begin();
             // If collateral was spent ...
-            if ((*it).IsOutpointSpent()) {
+            if (cacheXnodes.vActiveState[nIndex] == CXnode::XNODE_OUTPOINT_SPENT) {
+                uint256 hash = CXnodeBroadcast(*it).GetHash();
                 LogPrint("xnode", "CXnodeMan::CheckAndRemove -- Removing Xnode: %s  addr=%s  %i now\n", (*it).GetStateString(), (*it).addr.ToString(), size() - 1);
 
                 // erase all of the broadcasts we've seen from this txin, ...
@@ -205,14 +296,23 @@ void CXnodeMan::CheckAndRemove()
 
                 // and finally remove it from the list
 //                it->FlagGovernanceItemsAsDirty();
+                if (mapNotifiedStates.erase((*it).vin.prevout))
+                    NotifyXnodeChanged((*it).vin.prevout, (*it).addr, (*it).nActiveState, XNODE_LIST_REMOVED);
+                setCollaterals.erase((*it).vin.prevout);
+                cacheXnodes.Erase(nIndex);
                 it = vXnodes.erase(it);
                 fXnodesRemoved = true;
             } else {
                 bool fAsk = pCurrentBlockIndex &&
                             (nAskForMnbRecovery > 0) &&
                             xnodeSync.IsSynced() &&
-                            it->IsNewStartRequired() &&
-                            !IsMnbRecoveryRequested(hash);
+                            cacheXnodes.vActiveState[nIndex] == CXnode::XNODE_NEW_START_REQUIRED;
+                // only hash the broadcast of the few xnodes that could need it
+                uint256 hash;
+                if(fAsk) {
+                    hash = CXnodeBroadcast(*it).GetHash();
+                    fAsk = !IsMnbRecoveryRequested(hash);
+                }
                 if(fAsk) {
                     // this mn is in a non-recoverable state and we haven't asked other nodes yet
                     std::set<CNetAddr> setRequested;
@@ -365,7 +465,14 @@ void CXnodeMan::CheckAndRemove()
 void CXnodeMan::Clear()
 {
     LOCK(cs);
+    BOOST_FOREACH(const CXnode& mn, vXnodes) {
+        if (mapNotifiedStates.count(mn.vin.prevout))
+            NotifyXnodeChanged(mn.vin.prevout, mn.addr, mn.nActiveState, XNODE_LIST_REMOVED);
+    }
+    mapNotifiedStates.clear();
     vXnodes.clear();
+    cacheXnodes.Clear();
+    setCollaterals.clear();
     mAskedUsForXnodeList.clear();
     mWeAskedForXnodeList.clear();
     mWeAskedForXnodeListEntry.clear();
@@ -383,8 +490,8 @@ int CXnodeMan::CountXnodes(int nProtocolVersion)
     int nCount = 0;
     nProtocolVersion = nProtocolVersion == -1 ? mnpayments.GetMinXnodePaymentsProto() : nProtocolVersion;
 
-    BOOST_FOREACH(CXnode& mn, vXnodes) {
-        if(mn.nProtocolVersion < nProtocolVersion) continue;
+    for (size_t i = 0; i < cacheXnodes.size(); i++) {
+        if(cacheXnodes.vProtocolVersion[i] < nProtocolVersion) continue;
         nCount++;
     }
 
@@ -397,8 +504,8 @@ int CXnodeMan::CountEnabled(int nProtocolVersion)
     int nCount = 0;
     nProtocolVersion = nProtocolVersion == -1 ? mnpayments.GetMinXnodePaymentsProto() : nProtocolVersion;
 
-    BOOST_FOREACH(CXnode& mn, vXnodes) {
-        if(mn.nProtocolVersion < nProtocolVersion || !mn.IsEnabled()) continue;
+    for (size_t i = 0; i < cacheXnodes.size(); i++) {
+        if(cacheXnodes.vProtocolVersion[i] < nProtocolVersion || cacheXnodes.vActiveState[i] != CXnode::XNODE_ENABLED) continue;
         nCount++;
     }
 
@@ -459,10 +566,10 @@ CXnode* CXnodeMan::Find(const CTxIn &vin)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CXnode& mn, vXnodes)
+    for (size_t i = 0; i < cacheXnodes.size(); i++)
     {
-        if(mn.vin.prevout == vin.prevout)
-            return &mn;
+        if(cacheXnodes.vOutpoint[i] == vin.prevout)
+            return &vXnodes[i];
     }
     return NULL;
 }
@@ -596,51 +703,24 @@ CXnode* CXnodeMan::GetNextXnodeInQueueForPayment(int nBlockHeight, bool fFilterS
     CXnode *pBestXnode = NULL;
     std::vector<std::pair<int, CXnode*> > vecXnodeLastPaid;
 
+    // Bring the states of the xnodes that are due for a check up to date
+    Check();
+
     /*
         Make a vector with all of the last paid times
     */
     int nMnCount = CountEnabled();
-    int index = 0;
-    BOOST_FOREACH(CXnode &mn, vXnodes)
+    int nMinProtocol = mnpayments.GetMinXnodePaymentsProto();
+    int64_t nAdjustedTime = GetAdjustedTime();
+    for (size_t i = 0; i < cacheXnodes.size(); i++)
     {
-        index += 1;
-        // LogPrintf("index=%s, mn=%s\n", index, mn.ToString());
-        /*if (!mn.IsValidForPayment()) {
-            LogPrint("xnodeman", "Xnode, %s, addr(%s), not-qualified: 'not valid for payment'\n",
-                     mn.vin.prevout.ToStringShort(), CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString());
-            continue;
-        }
-        // //check protocol version
-        if (mn.nProtocolVersion < mnpayments.GetMinXnodePaymentsProto()) {
-            // LogPrintf("Invalid nProtocolVersion!\n");
-            // LogPrintf("mn.nProtocolVersion=%s!\n", mn.nProtocolVersion);
-            // LogPrintf("mnpayments.GetMinXnodePaymentsProto=%s!\n", mnpayments.GetMinXnodePaymentsProto());
-            LogPrint("xnodeman", "Xnode, %s, addr(%s), not-qualified: 'invalid nProtocolVersion'\n",
-                     mn.vin.prevout.ToStringShort(), CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString());
-            continue;
-        }
-        //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
-        if (mnpayments.IsScheduled(mn, nBlockHeight)) {
-            // LogPrintf("mnpayments.IsScheduled!\n");
-            LogPrint("xnodeman", "Xnode, %s, addr(%s), not-qualified: 'IsScheduled'\n",
-                     mn.vin.prevout.ToStringShort(), CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString());
-            continue;
-        }
-        //it's too new, wait for a cycle
-        if (fFilterSigTime && mn.sigTime + (nMnCount * 2.6 * 60) > GetAdjustedTime()) {
-            // LogPrintf("it's too new, wait for a cycle!\n");
-            LogPrint("xnodeman", "Xnode, %s, addr(%s), not-qualified: 'it's too new, wait for a cycle!', sigTime=%s, will be qualifed after=%s\n",
-                     mn.vin.prevout.ToStringShort(), CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString(), DateTimeStrFormat("%Y-%m-%d %H:%M UTC", mn.sigTime).c_str(), DateTimeStrFormat("%Y-%m-%d %H:%M UTC", mn.sigTime + (nMnCount * 2.6 * 60)).c_str());
-            continue;
-        }
-        //make sure it has at least as many confirmations as there are xnodes
-        if (mn.GetCollateralAge() < nMnCount) {
-            // LogPrintf("mn.GetCollateralAge()=%s!\n", mn.GetCollateralAge());
-            // LogPrintf("nMnCount=%s!\n", nMnCount);
-            LogPrint("xnodeman", "Xnode, %s, addr(%s), not-qualified: 'mn.GetCollateralAge() < nMnCount', CollateralAge=%d, nMnCount=%d\n",
-                     mn.vin.prevout.ToStringShort(), CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString(), mn.GetCollateralAge(), nMnCount);
-            continue;
-        }*/
+        // Most xnodes drop out on the fields in the cache, only look at the
+        // others' payment schedule and collateral
+        if (cacheXnodes.vActiveState[i] != CXnode::XNODE_ENABLED) continue;
+        if (cacheXnodes.vProtocolVersion[i] < nMinProtocol) continue;
+        if (fFilterSigTime && cacheXnodes.vSigTime[i] + (nMnCount * 2.6 * 60) > nAdjustedTime) continue;
+
+        CXnode &mn = vXnodes[i];
         char* reasonStr = GetNotQualifyReason(mn, nBlockHeight, fFilterSigTime, nMnCount);
         if (reasonStr != NULL) {
             LogPrint("xnodeman", "Xnode, %s, addr(%s), qualify %s\n",
@@ -648,7 +728,7 @@ CXnode* CXnodeMan::GetNextXnodeInQueueForPayment(int nBlockHeight, bool fFilterS
             delete [] reasonStr;
             continue;
         }
-        vecXnodeLastPaid.push_back(std::make_pair(mn.GetLastPaidBlock(), &mn));
+        vecXnodeLastPaid.push_back(std::make_pair(cacheXnodes.vBlockLastPaid[i], &mn));
     }
     nCount = (int)vecXnodeLastPaid.size();
 
@@ -739,14 +819,11 @@ int CXnodeMan::GetXnodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol
     LOCK(cs);
 
     // scan for winner
-    BOOST_FOREACH(CXnode& mn, vXnodes) {
-        if(mn.nProtocolVersion < nMinProtocol) continue;
-        if(fOnlyActive) {
-            if(!mn.IsEnabled()) continue;
-        }
-        else {
-            if(!mn.IsValidForPayment()) continue;
-        }
+    for (size_t i = 0; i < cacheXnodes.size(); i++) {
+        if(cacheXnodes.vProtocolVersion[i] < nMinProtocol) continue;
+        // IsValidForPayment() is IsEnabled() for now
+        if(cacheXnodes.vActiveState[i] != CXnode::XNODE_ENABLED) continue;
+        CXnode& mn = vXnodes[i];
         int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
 
         vecXnodeScores.push_back(std::make_pair(nScore, &mn));
@@ -775,10 +852,11 @@ std::vector<std::pair<int, CXnode> > CXnodeMan::GetXnodeRanks(int nBlockHeight,
     LOCK(cs);
 
     // scan for winner
-    BOOST_FOREACH(CXnode& mn, vXnodes) {
+    for (size_t i = 0; i < cacheXnodes.size(); i++) {
 
-        if(mn.nProtocolVersion < nMinProtocol || !mn.IsEnabled()) continue;
+        if(cacheXnodes.vProtocolVersion[i] < nMinProtocol || cacheXnodes.vActiveState[i] != CXnode::XNODE_ENABLED) continue;
 
+        CXnode& mn = vXnodes[i];
         int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
 
         vecXnodeScores.push_back(std::make_pair(nScore, &mn));
@@ -808,11 +886,12 @@ CXnode* CXnodeMan::GetXnodeByRank(int nRank, int nBlockHeight, int nMinProtocol,
     }
 
     // Fill scores
-    BOOST_FOREACH(CXnode& mn, vXnodes) {
+    for (size_t i = 0; i < cacheXnodes.size(); i++) {
 
-        if(mn.nProtocolVersion < nMinProtocol) continue;
-        if(fOnlyActive && !mn.IsEnabled()) continue;
+        if(cacheXnodes.vProtocolVersion[i] < nMinProtocol) continue;
+        if(fOnlyActive && cacheXnodes.vActiveState[i] != CXnode::XNODE_ENABLED) continue;
 
+        CXnode& mn = vXnodes[i];
         int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
 
         vecXnodeScores.push_back(std::make_pair(nScore, &mn));
@@ -927,7 +1006,10 @@ void CXnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStrea
         if(pmn && pmn->IsNewStartRequired()) return;
 
         int nDos = 0;
-        if(mnp.CheckAndUpdate(pmn, false, nDos)) return;
+        bool fAccepted = mnp.CheckAndUpdate(pmn, false, nDos);
+        // an accepted ping re-checks the xnode, which may change its state
+        if(pmn) UpdateListCache(*pmn);
+        if(fAccepted) return;
 
         if(nDos > 0) {
             // if anything significant failed, mark that node
@@ -1470,6 +1552,7 @@ void CXnodeMan::UpdateXnodeList(CXnodeBroadcast mnb)
         } else {
             CXnodeBroadcast mnbOld = mapSeenXnodeBroadcast[CXnodeBroadcast(*pmn).GetHash()].second;
             if (pmn->UpdateFromNewBroadcast(mnb)) {
+                UpdateListCache(*pmn);
                 xnodeSync.AddedXnodeList();
                 mapSeenXnodeBroadcast.erase(mnbOld.GetHash());
             }
@@ -1534,7 +1617,9 @@ bool CXnodeMan::CheckMnbAndUpdateXnodeList(CNode* pfrom, CXnodeBroadcast mnb, in
         CXnode *pmn = Find(mnb.vin);
         if (pmn) {
             CXnodeBroadcast mnbOld = mapSeenXnodeBroadcast[CXnodeBroadcast(*pmn).GetHash()].second;
-            if (!mnb.Update(pmn, nDos)) {
+            bool fUpdated = mnb.Update(pmn, nDos);
+            UpdateListCache(*pmn);
+            if (!fUpdated) {
                 LogPrint("xnode", "CXnodeMan::CheckMnbAndUpdateXnodeList -- Update() failed, xnode=%s\n", mnb.vin.prevout.ToStringShort());
                 return false;
             }
@@ -1588,8 +1673,9 @@ void CXnodeMan::UpdateLastPaid()
     LogPrint("mnpayments", "CXnodeMan::UpdateLastPaid -- nHeight=%d, nMaxBlocksToScanBack=%d, IsFirstRun=%s\n",
                              pCurrentBlockIndex->nHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
 
-    BOOST_FOREACH(CXnode& mn, vXnodes) {
-        mn.UpdateLastPaid(pCurrentBlockIndex, nMaxBlocksToScanBack);
+    for (size_t i = 0; i < vXnodes.size(); i++) {
+        vXnodes[i].UpdateLastPaid(pCurrentBlockIndex, nMaxBlocksToScanBack);
+        cacheXnodes.vBlockLastPaid[i] = vXnodes[i].nBlockLastPaid;
     }
 
     // every time is like the first time if winners list is not synced
@@ -1648,6 +1734,7 @@ void CXnodeMan::CheckXnode(const CTxIn& vin, bool fForce)
         return;
     }
     pMN->Check(fForce);
+    UpdateListCache(*pMN);
 }
 
 void CXnodeMan::CheckXnode(const CPubKey& pubKeyXnode, bool fForce)
@@ -1658,6 +1745,7 @@ void CXnodeMan::CheckXnode(const CPubKey& pubKeyXnode, bool fForce)
         return;
     }
     pMN->Check(fForce);
+    UpdateListCache(*pMN);
 }
 
 int CXnodeMan::GetXnodeState(const CTxIn& vin)
@@ -1712,6 +1800,13 @@ void CXnodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
     pCurrentBlockIndex = pindex;
     LogPrint("xnode", "CXnodeMan::UpdatedBlockTip -- pCurrentBlockIndex->nHeight=%d\n", pCurrentBlockIndex->nHeight);
 
+    {
+        // PoSe bans end, and the sync, watchdog and spork states the checks
+        // depend on change, with the height
+        LOCK(cs);
+        fCheckAll = true;
+    }
+
     CheckSameAddr();
 
     if(fXNode) {
@@ -1743,3 +1838,46 @@ void CXnodeMan::NotifyXnodeUpdates()
     fXnodesAdded = false;
     fXnodesRemoved = false;
 }
+
+void CXnodeMan::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
+{
+    LOCK(cs);
+
+    if (pblock) {
+        // connected, so spent for good
+        BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+            if (!setCollaterals.count(txin.prevout)) continue;
+            CXnode* pmn = Find(txin);
+            if (pmn == NULL) continue;
+            pmn->SetCollateralSpent();
+            UpdateListCache(*pmn);
+            NotifyChanged(*pmn);
+        }
+        return;
+    }
+
+    // Disconnected or in the mempool: the spends of tx aren't in the chain
+    // right now, and neither are its outputs. A reorg may confirm them again
+    // right away, so only look the collaterals up again.
+    BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+        if (!setCollaterals.count(txin.prevout)) continue;
+        CXnode* pmn = Find(txin);
+        if (pmn == NULL) continue;
+        pmn->RecheckCollateral();
+        UpdateListCache(*pmn);
+    }
+    const uint256 hash = tx.GetHash();
+    std::set<COutPoint>::const_iterator it = setCollaterals.lower_bound(COutPoint(hash, 0));
+    for (; it != setCollaterals.end() && it->hash == hash; ++it) {
+        CXnode* pmn = Find(CTxIn(*it));
+        if (pmn == NULL) continue;
+        pmn->RecheckCollateral();
+        UpdateListCache(*pmn);
+    }
+}
+
+void CXnodeCollateralWatcher::SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex, const CBlock *pblock)
+{
+    if (fLiteMode) return;
+    mnodeman.SyncTransaction(tx, pblock);
+}
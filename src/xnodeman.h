@@ -7,6 +7,9 @@
 
 #include "xnode.h"
 #include "sync.h"
+#include "validationinterface.h"
+
+#include <atomic>
 
 using namespace std;
 
@@ -78,6 +81,31 @@ private:
 
 };
 
+/**
+ * The fields of the xnodes that list scans and payee selection filter on, in
+ * dense arrays at the same index as CXnodeMan::vXnodes. A pass over the list
+ * then only reads these, and goes to the CXnode objects for the few entries
+ * that pass the filter.
+ *
+ * CXnodeMan refreshes an entry whenever it changes or checks the xnode.
+ */
+class CXnodeListCache
+{
+public:
+    std::vector<COutPoint> vOutpoint;
+    std::vector<int> vActiveState;
+    std::vector<int> vProtocolVersion;
+    std::vector<int> vBlockLastPaid;
+    std::vector<int64_t> vSigTime;
+
+    size_t size() const { return vOutpoint.size(); }
+
+    /// Copy the fields of mn, the xnode at nIndex, appending it if nIndex is the end
+    void Set(size_t nIndex, const CXnode& mn);
+    void Erase(size_t nIndex);
+    void Clear();
+};
+
 class CXnodeMan
 {
 public:
@@ -119,6 +147,14 @@ private:
 
     // map to hold all MNs
     std::vector<CXnode> vXnodes;
+    // hot fields of vXnodes, at the same index
+    CXnodeListCache cacheXnodes;
+    // collateral outpoints of vXnodes, to spot spends of them in SyncTransaction
+    std::set<COutPoint> setCollaterals;
+    // earliest time an xnode is due for a check, see ScheduleCheck
+    std::atomic<int64_t> nTimeNextCheck;
+    // whether to check all xnodes on the next tick, set on new blocks
+    bool fCheckAll;
     // who's asked for the Xnode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForXnodeList;
     // who we asked for the Xnode list and the last time
@@ -148,6 +184,15 @@ private:
     /// Set when xnodes are removed, cleared when CGovernanceManager is notified
     bool fXnodesRemoved;
 
+    /// State of each xnode as last announced to the validation interface listeners
+    std::map<COutPoint, int> mapNotifiedStates;
+
+    /// Announce an xnode that is new or changed state since the last announcement
+    void NotifyChanged(const CXnode &mn);
+
+    /// Refresh the entry of mn, which must be in vXnodes, in cacheXnodes
+    void UpdateListCache(const CXnode &mn);
+
     std::vector<uint256> vecDirtyGovernanceObjectHashes;
 
     int64_t nLastWatchdogVoteTime;
@@ -180,6 +225,15 @@ public:
         }
 
         READWRITE(vXnodes);
+        if(ser_action.ForRead()) {
+            setCollaterals.clear();
+            cacheXnodes.Clear();
+            for (size_t i = 0; i < vXnodes.size(); i++) {
+                setCollaterals.insert(vXnodes[i].vin.prevout);
+                cacheXnodes.Set(i, vXnodes[i]);
+            }
+            fCheckAll = true;
+        }
         READWRITE(mAskedUsForXnodeList);
         READWRITE(mWeAskedForXnodeList);
         READWRITE(mWeAskedForXnodeListEntry);
@@ -205,9 +259,12 @@ public:
     void AskForMN(CNode *pnode, const CTxIn &vin);
     void AskForMnb(CNode *pnode, const uint256 &hash);
 
-    /// Check all Xnodes
+    /// Check the Xnodes that are due for it, or all of them after a new block
     void Check();
 
+    /// Have Check() run no later than nTime. Doesn't lock, xnodes call it while holding their own lock.
+    void ScheduleCheck(int64_t nTime);
+
     /// Check all Xnodes and remove inactive
     void CheckAndRemove();
 
@@ -357,6 +414,9 @@ public:
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
 
+    /// Follows the spends of xnode collaterals in connected blocks, and collaterals leaving the chain
+    void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+
     /**
      * Called to notify CGovernanceManager that the xnode index has been updated.
      * Must be called while not holding the CXnodeMan::cs mutex
@@ -365,4 +425,13 @@ public:
 
 };
 
+/** Passes the transactions of connected and disconnected blocks on to mnodeman */
+class CXnodeCollateralWatcher : public CValidationInterface
+{
+protected:
+    void SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex, const CBlock *pblock);
+};
+
+extern CXnodeCollateralWatcher xnodeCollateralWatcher;
+
 #endif
@@ -11,6 +11,7 @@
 #include "xnode-payments.h"
 #include "xnode-sync.h"
 #include "sigma/remint.h"
+#include "libzerocoin/ParallelTasks.h"
 
 #include <atomic>
 #include <sstream>
@@ -101,7 +102,8 @@ bool CheckRemintGravityCoinTransaction(const CTransaction &tx,
                                 int nHeight,
                                 bool isCheckWallet,
                                 bool fStatefulZerocoinCheck,
-                                CZerocoinTxInfo *zerocoinTxInfo) {
+                                CZerocoinTxInfo *zerocoinTxInfo,
+                                bool fCheckSpendProofs) {
 
     // Check height
     int txHeight;
@@ -180,7 +182,7 @@ bool CheckRemintGravityCoinTransaction(const CTransaction &tx,
 
     libzerocoin::SpendMetaData metadata(remint.getCoinGroupId(), tempTx.GetHash());
 
-    if (!remint.Verify(metadata)) {
+    if (fCheckSpendProofs && !remint.Verify(metadata)) {
         LogPrintf("CheckRemintGravityCoinTransaction: remint input verification failure\n");
         return false;
     }
@@ -224,7 +226,8 @@ bool CheckSpendGravityCoinTransaction(const CTransaction &tx,
                                 int nHeight,
                                 bool isCheckWallet,
                                 bool fStatefulZerocoinCheck,
-                                CZerocoinTxInfo *zerocoinTxInfo) {
+                                CZerocoinTxInfo *zerocoinTxInfo,
+                                bool fCheckSpendProofs) {
 
     int txHeight = chainActive.Height();
     bool hasZerocoinSpendInputs = false, hasNonZerocoinInputs = false;
@@ -367,6 +370,10 @@ bool CheckSpendGravityCoinTransaction(const CTransaction &tx,
         if (!zerocoinState.GetCoinGroupInfo(targetDenominations[vinIndex], pubcoinId, coinGroup))
             return state.DoS(100, false, NO_MINT_ZEROCOIN, "CheckSpendGravityCoinTransaction: Error: no coins were minted with such parameters");
 
+        // Proofs of spends in checkpointed blocks are assumed valid
+        if (!fCheckSpendProofs)
+            continue;
+
         bool passVerify = false;
         CBlockIndex *index = coinGroup.lastBlock;
 
@@ -634,7 +641,8 @@ bool CheckZerocoinTransaction(const CTransaction &tx,
                               int nHeight,
                               bool isCheckWallet,
                               bool fStatefulZerocoinCheck,
-                              CZerocoinTxInfo *zerocoinTxInfo)
+                              CZerocoinTxInfo *zerocoinTxInfo,
+                              bool fCheckSpendProofs)
 {
     if (tx.IsZerocoinSpend() || tx.IsZerocoinMint()) {
         if ((nHeight != INT_MAX && nHeight >= params.nDisableZerocoinStartBlock)    // transaction is a part of block: disable after specific block number
@@ -709,7 +717,7 @@ bool CheckZerocoinTransaction(const CTransaction &tx,
         {
             if(!isVerifyDB) {
                 if (txout.nValue == totalValue * COIN) {
-                    if(!CheckSpendGravityCoinTransaction(tx, params, denominations, state, hashTx, isVerifyDB, nHeight, isCheckWallet, fStatefulZerocoinCheck, zerocoinTxInfo)){
+                    if(!CheckSpendGravityCoinTransaction(tx, params, denominations, state, hashTx, isVerifyDB, nHeight, isCheckWallet, fStatefulZerocoinCheck, zerocoinTxInfo, fCheckSpendProofs)){
                         return false;
                     }
                 }
@@ -721,7 +729,7 @@ bool CheckZerocoinTransaction(const CTransaction &tx,
     }
 
     if (tx.IsZerocoinRemint())
-        return CheckRemintGravityCoinTransaction(tx, params, state, hashTx, isVerifyDB, nHeight, isCheckWallet, fStatefulZerocoinCheck, zerocoinTxInfo);
+        return CheckRemintGravityCoinTransaction(tx, params, state, hashTx, isVerifyDB, nHeight, isCheckWallet, fStatefulZerocoinCheck, zerocoinTxInfo, fCheckSpendProofs);
 
     return true;
 }
@@ -1185,42 +1193,88 @@ void CZerocoinState::CalculateAlternativeModulusAccumulatorValues(CChain *chain,
     }
 }
 
+namespace {
+
+// Accumulator value and number of minted coins (-1 if the mints are missing) after every block
+// of a coin group, which changes the accumulator
+typedef vector<pair<CBlockIndex *, pair<CBigNum, int>>> CoinGroupAccumulators;
+
+// Calculates the accumulator values of a coin group from scratch. Only reads the block index, so
+// different coin groups can be calculated in parallel. If fStopIfFirstMatches is set and the value
+// after the first block matches the stored one, the calculation stops and the result is left empty
+void CalculateCoinGroupAccumulators(CChain *chain, const pair<int,int> &denomAndId,
+                                    const CZerocoinState::CoinGroupInfo &coinGroup, libzerocoin::Params *zcParams,
+                                    bool fStopIfFirstMatches, CoinGroupAccumulators &result) {
+    libzerocoin::CoinDenomination d = (libzerocoin::CoinDenomination)denomAndId.first;
+    libzerocoin::Accumulator acc(&zcParams->accumulatorParams, d);
+
+    CBlockIndex *block = coinGroup.firstBlock;
+    for (;;) {
+        auto accChange = block->accumulatorChanges.find(denomAndId);
+        if (accChange != block->accumulatorChanges.end()) {
+            int nMints = -1;
+            auto mintedCoins = block->mintedPubCoins.find(denomAndId);
+            if (mintedCoins != block->mintedPubCoins.end()) {
+                BOOST_FOREACH(const CBigNum &pubCoin, mintedCoins->second) {
+                    acc += libzerocoin::PublicCoin(zcParams, pubCoin, d);
+                }
+                nMints = (int)mintedCoins->second.size();
+            }
+
+            if (fStopIfFirstMatches && block == coinGroup.firstBlock && acc.getValue() == accChange->second.first)
+                return;
+
+            result.push_back(make_pair(block, make_pair(acc.getValue(), nMints)));
+        }
+
+        if (block != coinGroup.lastBlock)
+            block = (*chain)[block->nHeight+1];
+        else
+            break;
+    }
+}
+
+}
+
 bool CZerocoinState::TestValidity(CChain *chain) {
-    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int), CoinGroupInfo) &coinGroup, coinGroups) {
-        fprintf(stderr, "TestValidity[denomination=%d, id=%d]\n", coinGroup.first.first, coinGroup.first.second);
+    vector<pair<int,int>> groups;
+    vector<CoinGroupAccumulators> accumulators(coinGroups.size());
+    libzerocoin::ParallelTasks tasks(coinGroups.size());
 
+    // coin groups are independent of each other, calculate them in parallel
+    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int), CoinGroupInfo) &coinGroup, coinGroups) {
         bool fModulusV2 = IsZerocoinTxV2((libzerocoin::CoinDenomination)coinGroup.first.first, Params().GetConsensus(), coinGroup.first.second);
         libzerocoin::Params *zcParams = fModulusV2 ? ZCParamsV2 : ZCParams;
+        CoinGroupAccumulators &result = accumulators[groups.size()];
 
-        libzerocoin::Accumulator acc(&zcParams->accumulatorParams, (libzerocoin::CoinDenomination)coinGroup.first.first);
+        tasks.Add([chain, &coinGroup, zcParams, &result]() {
+            CalculateCoinGroupAccumulators(chain, coinGroup.first, coinGroup.second, zcParams, false, result);
+        });
+        groups.push_back(coinGroup.first);
+    }
+    tasks.Wait();
 
-        CBlockIndex *block = coinGroup.second.firstBlock;
-        for (;;) {
-            if (block->accumulatorChanges.count(coinGroup.first) > 0) {
-                if (block->mintedPubCoins.count(coinGroup.first) == 0) {
-                    fprintf(stderr, "  no minted coins\n");
-                    return false;
-                }
+    for (size_t i = 0; i < groups.size(); i++) {
+        const pair<int,int> &denomAndId = groups[i];
+        fprintf(stderr, "TestValidity[denomination=%d, id=%d]\n", denomAndId.first, denomAndId.second);
 
-                BOOST_FOREACH(const CBigNum &pubCoin, block->mintedPubCoins[coinGroup.first]) {
-                    acc += libzerocoin::PublicCoin(zcParams, pubCoin, (libzerocoin::CoinDenomination)coinGroup.first.first);
-                }
+        BOOST_FOREACH(const CoinGroupAccumulators::value_type &accChange, accumulators[i]) {
+            CBlockIndex *block = accChange.first;
 
-                if (acc.getValue() != block->accumulatorChanges[coinGroup.first].first) {
-                    fprintf (stderr, "  accumulator value mismatch at height %d\n", block->nHeight);
-                    return false;
-                }
+            if (accChange.second.second < 0) {
+                fprintf(stderr, "  no minted coins\n");
+                return false;
+            }
 
-                if (block->accumulatorChanges[coinGroup.first].second != (int)block->mintedPubCoins[coinGroup.first].size()) {
-                    fprintf(stderr, "  number of minted coins mismatch at height %d\n", block->nHeight);
-                    return false;
-                }
+            if (accChange.second.first != block->accumulatorChanges[denomAndId].first) {
+                fprintf (stderr, "  accumulator value mismatch at height %d\n", block->nHeight);
+                return false;
             }
 
-            if (block != coinGroup.second.lastBlock)
-                block = (*chain)[block->nHeight+1];
-            else
-                break;
+            if (block->accumulatorChanges[denomAndId].second != accChange.second.second) {
+                fprintf(stderr, "  number of minted coins mismatch at height %d\n", block->nHeight);
+                return false;
+            }
         }
 
         fprintf(stderr, "  verified ok\n");
@@ -1232,39 +1286,37 @@ bool CZerocoinState::TestValidity(CChain *chain) {
 set<CBlockIndex *> CZerocoinState::RecalculateAccumulators(CChain *chain) {
     set<CBlockIndex *> changes;
 
+    vector<pair<int,int>> groups;
+    vector<CoinGroupAccumulators> accumulators(coinGroups.size());
+    libzerocoin::ParallelTasks tasks(coinGroups.size());
+
+    // coin groups are independent of each other, calculate them in parallel and apply the results afterwards
     BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int), CoinGroupInfo) &coinGroup, coinGroups) {
         // Skip non-modulusv2 groups
         if (!IsZerocoinTxV2((libzerocoin::CoinDenomination)coinGroup.first.first, Params().GetConsensus(), coinGroup.first.second))
             continue;
 
-        libzerocoin::Accumulator acc(&ZCParamsV2->accumulatorParams, (libzerocoin::CoinDenomination)coinGroup.first.first);
-
         // Try to calculate accumulator for the first batch of mints. If it doesn't match we need to recalculate the rest of it
-        CBlockIndex *block = coinGroup.second.firstBlock;
-        for (;;) {
-            if (block->accumulatorChanges.count(coinGroup.first) > 0) {
-                BOOST_FOREACH(const CBigNum &pubCoin, block->mintedPubCoins[coinGroup.first]) {
-                    acc += libzerocoin::PublicCoin(ZCParamsV2, pubCoin, (libzerocoin::CoinDenomination)coinGroup.first.first);
-                }
+        CoinGroupAccumulators &result = accumulators[groups.size()];
+        tasks.Add([chain, &coinGroup, &result]() {
+            CalculateCoinGroupAccumulators(chain, coinGroup.first, coinGroup.second, ZCParamsV2, true, result);
+        });
+        groups.push_back(coinGroup.first);
+    }
+    tasks.Wait();
 
-                // First block case is special: do the check
-                if (block == coinGroup.second.firstBlock) {
-                    if (acc.getValue() != block->accumulatorChanges[coinGroup.first].first)
-                        // recalculation is needed
-                        LogPrintf("ZerocoinState: accumulator recalculation for denomination=%d, id=%d\n", coinGroup.first.first, coinGroup.first.second);
-                    else
-                        // everything's ok
-                        break;
-                }
+    for (size_t i = 0; i < groups.size(); i++) {
+        const pair<int,int> &denomAndId = groups[i];
+        if (accumulators[i].empty())
+            // everything's ok
+            continue;
 
-                block->accumulatorChanges[coinGroup.first] = make_pair(acc.getValue(), (int)block->mintedPubCoins[coinGroup.first].size());
-                changes.insert(block);
-            }
+        LogPrintf("ZerocoinState: accumulator recalculation for denomination=%d, id=%d\n", denomAndId.first, denomAndId.second);
 
-            if (block != coinGroup.second.lastBlock)
-                block = (*chain)[block->nHeight+1];
-            else
-                break;
+        BOOST_FOREACH(const CoinGroupAccumulators::value_type &accChange, accumulators[i]) {
+            CBlockIndex *block = accChange.first;
+            block->accumulatorChanges[denomAndId] = make_pair(accChange.second.first, max(accChange.second.second, 0));
+            changes.insert(block);
         }
     }
 
@@ -57,7 +57,8 @@ bool CheckZerocoinTransaction(const CTransaction &tx,
 	int nHeight,
     bool isCheckWallet,
     bool fZerocoinStateCheck,
-    CZerocoinTxInfo *zerocoinTxInfo);
+    CZerocoinTxInfo *zerocoinTxInfo,
+    bool fCheckSpendProofs = true);
 
 void DisconnectTipZC(CBlock &block, CBlockIndex *pindexDelete);
 bool ConnectBlockZC(CValidationState &state, const CChainParams &chainparams, CBlockIndex *pindexNew, const CBlock *pblock, bool fJustCheck=false);
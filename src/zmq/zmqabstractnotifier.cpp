@@ -20,3 +20,18 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifySigmaTransaction(const CTransaction &/*transaction*/, const CBlockIndex * /*pindex*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyXnode(const COutPoint &/*outpoint*/, const CService &/*addr*/, int /*nState*/, XnodeChange /*change*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyExodusTransaction(const uint256 &/*txid*/, const CBlockIndex * /*pindex*/, unsigned int /*idx*/, unsigned int /*type*/, unsigned short /*version*/, int /*result*/)
+{
+    return true;
+}
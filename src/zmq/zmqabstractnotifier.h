@@ -6,8 +6,10 @@
 #define BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
 
 #include "zmqconfig.h"
+#include "validationinterface.h"
 
 class CBlockIndex;
+class CService;
 class CZMQAbstractNotifier;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
@@ -34,6 +36,10 @@ public:
 
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    //! Sigma transaction accepted to the mempool (pindex NULL) or connected in the block pindex
+    virtual bool NotifySigmaTransaction(const CTransaction &transaction, const CBlockIndex *pindex);
+    virtual bool NotifyXnode(const COutPoint &outpoint, const CService &addr, int nState, XnodeChange change);
+    virtual bool NotifyExodusTransaction(const uint256 &txid, const CBlockIndex *pindex, unsigned int idx, unsigned int type, unsigned short version, int result);
 
 protected:
     void *psocket;
@@ -10,6 +10,8 @@
 #include "streams.h"
 #include "util.h"
 
+#include <boost/bind.hpp>
+
 void zmqError(const char *str)
 {
     LogPrint("zmq", "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
@@ -39,6 +41,9 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubsigmatx"] = CZMQAbstractNotifier::Create<CZMQPublishSigmaTransactionNotifier>;
+    factories["pubxnode"] = CZMQAbstractNotifier::Create<CZMQPublishXnodeNotifier>;
+    factories["pubexodustx"] = CZMQAbstractNotifier::Create<CZMQPublishExodusTransactionNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -128,12 +133,12 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
+void CZMQNotificationInterface::NotifyAll(const boost::function<bool (CZMQAbstractNotifier*)> &notify)
 {
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindex))
+        if (notify(notifier))
         {
             i++;
         }
@@ -145,19 +150,27 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
     }
 }
 
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
+{
+    NotifyAll(boost::bind(&CZMQAbstractNotifier::NotifyBlock, _1, pindex));
+}
+
 void CZMQNotificationInterface::SyncTransaction(const CTransaction& tx, const CBlockIndex* pindex, const CBlock* pblock)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
-    }
+    NotifyAll(boost::bind(&CZMQAbstractNotifier::NotifyTransaction, _1, boost::cref(tx)));
+
+    // Sigma transactions are published when they enter the mempool and when
+    // their block is connected, not when they leave a block or conflict
+    if ((tx.IsSigmaMint() || tx.IsSigmaSpend()) && (pblock || !pindex))
+        NotifyAll(boost::bind(&CZMQAbstractNotifier::NotifySigmaTransaction, _1, boost::cref(tx), pindex));
+}
+
+void CZMQNotificationInterface::XnodeChanged(const COutPoint &outpoint, const CService &addr, int nState, XnodeChange change)
+{
+    NotifyAll(boost::bind(&CZMQAbstractNotifier::NotifyXnode, _1, boost::cref(outpoint), boost::cref(addr), nState, change));
+}
+
+void CZMQNotificationInterface::ExodusTransaction(const uint256 &txid, const CBlockIndex *pindex, unsigned int idx, unsigned int type, unsigned short version, int result)
+{
+    NotifyAll(boost::bind(&CZMQAbstractNotifier::NotifyExodusTransaction, _1, boost::cref(txid), pindex, idx, type, version, result));
 }
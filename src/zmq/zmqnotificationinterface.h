@@ -9,6 +9,8 @@
 #include <string>
 #include <map>
 
+#include <boost/function.hpp>
+
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
@@ -26,10 +28,15 @@ protected:
     // CValidationInterface
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, const CBlock* pblock);
     void UpdatedBlockTip(const CBlockIndex *pindex);
+    void XnodeChanged(const COutPoint &outpoint, const CService &addr, int nState, XnodeChange change);
+    void ExodusTransaction(const uint256 &txid, const CBlockIndex *pindex, unsigned int idx, unsigned int type, unsigned short version, int result);
 
 private:
     CZMQNotificationInterface();
 
+    //! Pass a notification to every notifier, and drop the notifiers that fail to publish it
+    void NotifyAll(const boost::function<bool (CZMQAbstractNotifier*)> &notify);
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
 };
@@ -5,6 +5,8 @@
 #include "chainparams.h"
 #include "zmqpublishnotifier.h"
 #include "main.h"
+#include "netbase.h"
+#include "sigma.h"
 #include "util.h"
 #include "rpc/server.h"
 
@@ -14,6 +16,9 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_SIGMATX   = "sigmatx";
+static const char *MSG_XNODE     = "xnode";
+static const char *MSG_EXODUSTX  = "exodustx";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -190,3 +195,67 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+/* sigmatx: txid, block hash (null in the mempool), int32 height (-1 in the
+   mempool), then the mints as (int64 value, pubcoin) and the spends as
+   (int64 denomination, serial, uint32 group id), each list prefixed by its
+   compact size */
+bool CZMQPublishSigmaTransactionNotifier::NotifySigmaTransaction(const CTransaction &transaction, const CBlockIndex *pindex)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint("zmq", "zmq: Publish sigmatx %s\n", hash.GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << hash << (pindex ? pindex->GetBlockHash() : uint256()) << (int32_t)(pindex ? pindex->nHeight : -1);
+
+    std::vector<std::pair<int64_t, secp_primitives::GroupElement> > vMints;
+    BOOST_FOREACH(const CTxOut &txout, transaction.vout) {
+        if (txout.scriptPubKey.IsSigmaMint())
+            vMints.push_back(std::make_pair((int64_t)txout.nValue, sigma::ParseSigmaMintScript(txout.scriptPubKey)));
+    }
+    WriteCompactSize(ss, vMints.size());
+    for (size_t i = 0; i < vMints.size(); i++)
+        ss << vMints[i].first << vMints[i].second;
+
+    CDataStream ssSpends(SER_NETWORK, PROTOCOL_VERSION);
+    unsigned int nSpends = 0;
+    if (transaction.IsSigmaSpend()) {
+        BOOST_FOREACH(const CTxIn &txin, transaction.vin) {
+            try {
+                std::unique_ptr<sigma::CoinSpend> spend;
+                uint32_t groupId;
+                std::tie(spend, groupId) = sigma::ParseSigmaSpend(txin);
+                int64_t denomination;
+                if (!sigma::DenominationToInteger(spend->getDenomination(), denomination))
+                    continue;
+                ssSpends << denomination << spend->getCoinSerialNumber() << groupId;
+                nSpends++;
+            } catch (const std::exception &) {
+                continue;
+            }
+        }
+    }
+    WriteCompactSize(ss, nSpends);
+    ss << ssSpends;
+
+    return SendMessage(MSG_SIGMATX, &(*ss.begin()), ss.size());
+}
+
+/* xnode: collateral outpoint, uint8 change (0 added, 1 state changed,
+   2 removed), int32 state, network address */
+bool CZMQPublishXnodeNotifier::NotifyXnode(const COutPoint &outpoint, const CService &addr, int nState, XnodeChange change)
+{
+    LogPrint("zmq", "zmq: Publish xnode %s\n", outpoint.ToStringShort());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << outpoint << (uint8_t)change << (int32_t)nState << addr;
+    return SendMessage(MSG_XNODE, &(*ss.begin()), ss.size());
+}
+
+/* exodustx: txid, block hash, int32 height, uint32 position in the block,
+   uint16 type, uint16 version, int32 result (0 if valid) */
+bool CZMQPublishExodusTransactionNotifier::NotifyExodusTransaction(const uint256 &txid, const CBlockIndex *pindex, unsigned int idx, unsigned int type, unsigned short version, int result)
+{
+    LogPrint("zmq", "zmq: Publish exodustx %s\n", txid.GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << txid << pindex->GetBlockHash() << (int32_t)pindex->nHeight << (uint32_t)idx << (uint16_t)type << (uint16_t)version << (int32_t)result;
+    return SendMessage(MSG_EXODUSTX, &(*ss.begin()), ss.size());
+}
@@ -15,6 +15,7 @@ private:
     uint32_t nSequence; //!< upcounting per message sequence number
 
 public:
+    CZMQAbstractPublishNotifier() : nSequence(0) { }
 
     /* send zmq multipart message
        parts:
@@ -52,4 +53,22 @@ public:
     bool NotifyTransaction(const CTransaction &transaction);
 };
 
+class CZMQPublishSigmaTransactionNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifySigmaTransaction(const CTransaction &transaction, const CBlockIndex *pindex);
+};
+
+class CZMQPublishXnodeNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyXnode(const COutPoint &outpoint, const CService &addr, int nState, XnodeChange change);
+};
+
+class CZMQPublishExodusTransactionNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyExodusTransaction(const uint256 &txid, const CBlockIndex *pindex, unsigned int idx, unsigned int type, unsigned short version, int result);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H